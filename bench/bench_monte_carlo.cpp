@@ -1,10 +1,13 @@
 #include "montecarlo/montecarlo.hpp"
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <filesystem>
 #include <iomanip>
 #include <iostream>
 #include <random>
+#include <span>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -81,6 +84,20 @@ struct UniformModel {
         std::uniform_real_distribution<double> dist(0.0, 1.0);
         return dist(rng);
     }
+
+    std::uint64_t config_hash() const { return montecarlo::ConfigHasher{}.add("UniformModel").value(); }
+};
+
+// Discounted call payoff under geometric Brownian motion
+struct CallModel {
+    double s0, k, r, sigma, t;
+
+    template <typename RNG>
+    double operator()(RNG& rng) const {
+        std::normal_distribution<double> dist(0.0, 1.0);
+        const double st = s0 * std::exp((r - 0.5 * sigma * sigma) * t + sigma * std::sqrt(t) * dist(rng));
+        return std::exp(-r * t) * std::max(st - k, 0.0);
+    }
 };
 
 // One CSV row worth of benchmark data
@@ -157,6 +174,460 @@ BenchRow bench_welford_loop(const Options& opts) {
     return {"aggregator_welford", 0, 0, opts.samples, elapsed_ms, throughput, agg.result(), agg.variance()};
 }
 
+// Welford through the blocked add_batch() path
+BenchRow bench_welford_batch_loop(const Options& opts) {
+    WelfordAggregator<> agg;
+    std::vector<double> block(1024);
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < opts.samples; i += block.size()) {
+        std::size_t n = static_cast<std::size_t>(
+            std::min<std::uint64_t>(block.size(), opts.samples - i));
+        for (std::size_t j = 0; j < n; ++j) {
+            block[j] = synthetic_value(i + j);
+        }
+        agg.add_batch(std::span<const double>(block.data(), n));
+    }
+    auto end = std::chrono::steady_clock::now();
+    double elapsed_ms = to_ms(end - start);
+    double throughput = opts.samples / (elapsed_ms / 1000.0);
+    return {"aggregator_welford_batch", 0, 0, opts.samples, elapsed_ms, throughput, agg.result(), agg.variance()};
+}
+
+// Four moments plus extrema through the blocked path, for comparison
+// with aggregator_welford_batch
+BenchRow bench_moments_batch_loop(const Options& opts) {
+    montecarlo::MomentsAggregator agg;
+    std::vector<double> block(1024);
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < opts.samples; i += block.size()) {
+        std::size_t n = static_cast<std::size_t>(
+            std::min<std::uint64_t>(block.size(), opts.samples - i));
+        for (std::size_t j = 0; j < n; ++j) {
+            block[j] = synthetic_value(i + j);
+        }
+        agg.add_batch(std::span<const double>(block.data(), n));
+    }
+    auto end = std::chrono::steady_clock::now();
+    double elapsed_ms = to_ms(end - start);
+    double throughput = opts.samples / (elapsed_ms / 1000.0);
+    return {"aggregator_moments_batch", 0, 0, opts.samples, elapsed_ms, throughput, agg.result(), agg.variance()};
+}
+
+// Order-independent mean/variance; compare with aggregator_welford_batch
+BenchRow bench_reproducible_batch_loop(const Options& opts) {
+    montecarlo::ReproducibleAggregator agg;
+    std::vector<double> block(1024);
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < opts.samples; i += block.size()) {
+        std::size_t n = static_cast<std::size_t>(
+            std::min<std::uint64_t>(block.size(), opts.samples - i));
+        for (std::size_t j = 0; j < n; ++j) {
+            block[j] = synthetic_value(i + j);
+        }
+        agg.add_batch(std::span<const double>(block.data(), n));
+    }
+    auto end = std::chrono::steady_clock::now();
+    double elapsed_ms = to_ms(end - start);
+    double throughput = opts.samples / (elapsed_ms / 1000.0);
+    return {"aggregator_reproducible", 0, 0, opts.samples, elapsed_ms, throughput, agg.result(), agg.variance()};
+}
+
+// 64 groups through the direct array versus the hash table
+BenchRow bench_grouped(const Options& opts, bool dense) {
+    montecarlo::GroupedAggregator<montecarlo::WelfordAggregator<>, std::uint64_t> agg(dense ? 64 : 0);
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < opts.samples; ++i) {
+        agg.add((i * 2654435761ULL >> 7) & 63, synthetic_value(i));
+    }
+    auto end = std::chrono::steady_clock::now();
+    double elapsed_ms = to_ms(end - start);
+    double throughput = opts.samples / (elapsed_ms / 1000.0);
+    const auto& first = *agg.find(0);
+    return {dense ? "aggregator_grouped_dense" : "aggregator_grouped_hashed", 0, 0, opts.samples,
+        elapsed_ms, throughput, first.result(), first.variance()};
+}
+
+// Integer outcomes with a bulk near 1000 and a sparse tail to ~1e6, fed as
+// int64 blocks the way integer models are
+BenchRow bench_sparse_histogram(const Options& opts) {
+    montecarlo::SparseHistogramAggregator agg;
+    std::vector<std::int64_t> block(1024);
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < opts.samples; i += block.size()) {
+        std::size_t n = static_cast<std::size_t>(
+            std::min<std::uint64_t>(block.size(), opts.samples - i));
+        for (std::size_t j = 0; j < n; ++j) {
+            const std::uint64_t h = (i + j) * 0x9E3779B97F4A7C15ULL;
+            block[j] = (h >> 60) == 0 ? static_cast<std::int64_t>(h >> 40)
+                                      : 1'000 + static_cast<std::int64_t>((h >> 32) & 255);
+        }
+        agg.add_batch(std::span<const std::int64_t>(block.data(), n));
+    }
+    auto end = std::chrono::steady_clock::now();
+    double elapsed_ms = to_ms(end - start);
+    double throughput = opts.samples / (elapsed_ms / 1000.0);
+    return {"aggregator_sparse_histogram", 0, 0, opts.samples, elapsed_ms, throughput, agg.result(), agg.variance()};
+}
+
+// Covariance of a 128-dimensional output; throughput is in vectors/s
+BenchRow bench_covariance(const Options& opts) {
+    constexpr std::size_t dim = 128;
+    const std::uint64_t rows = std::max<std::uint64_t>(opts.samples / dim, 1);
+    montecarlo::CovarianceAggregator agg(dim);
+    std::vector<double> row(dim);
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint64_t k = 0; k < rows; ++k) {
+        for (std::size_t i = 0; i < dim; ++i) {
+            row[i] = synthetic_value(k * 7 + i * 13);
+        }
+        agg.add(row);
+    }
+    double trace = 0.0;
+    for (std::size_t i = 0; i < dim; ++i) trace += agg.covariance(i, i);
+    auto end = std::chrono::steady_clock::now();
+    double elapsed_ms = to_ms(end - start);
+    return {"aggregator_covariance_d128", 0, 0, rows, elapsed_ms,
+        rows / (elapsed_ms / 1000.0), agg.mean(0), trace};
+}
+
+// Heavy-tailed synthetic payoffs for the distribution benchmarks
+std::vector<double> lognormal_samples(const Options& opts) {
+    auto rng = montecarlo::make_rng(opts.seed);
+    std::lognormal_distribution<double> dist(0.0, 1.0);
+    std::vector<double> values(opts.samples);
+    for (double& v : values) {
+        v = dist(rng);
+    }
+    return values;
+}
+
+// Exact quantiles by full sort versus t-digest insertion; the error row
+// reports the worst rank error over p50, p99 and p99.9
+std::vector<BenchRow> bench_quantiles(const Options& opts) {
+    const std::vector<double> values = lognormal_samples(opts);
+    const double qs[] = {0.5, 0.99, 0.999};
+    std::vector<BenchRow> rows;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<double> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    auto end = std::chrono::steady_clock::now();
+    double elapsed_ms = to_ms(end - start);
+    double exact_p99 = sorted[static_cast<std::size_t>(0.99 * static_cast<double>(sorted.size()))];
+    rows.push_back({"quantile_exact_sort", 1, 0, opts.samples, elapsed_ms,
+        opts.samples / (elapsed_ms / 1000.0), exact_p99, 0.0});
+
+    // Buffering plus multi-selection of the same three quantiles
+    for (std::size_t threads : opts.threads) {
+        montecarlo::ExactQuantileAggregator exact(threads);
+        start = std::chrono::steady_clock::now();
+        exact.add_batch(values);
+        std::vector<double> picked = exact.quantiles(qs);
+        end = std::chrono::steady_clock::now();
+        elapsed_ms = to_ms(end - start);
+        rows.push_back({"quantile_exact_select", threads, 0, opts.samples, elapsed_ms,
+            opts.samples / (elapsed_ms / 1000.0), picked[1], 0.0});
+    }
+
+    montecarlo::TDigestAggregator digest(200.0);
+    start = std::chrono::steady_clock::now();
+    digest.add_batch(values);
+    end = std::chrono::steady_clock::now();
+    elapsed_ms = to_ms(end - start);
+    rows.push_back({"quantile_tdigest", 1, 0, opts.samples, elapsed_ms,
+        opts.samples / (elapsed_ms / 1000.0), digest.quantile(0.99), 0.0});
+
+    double worst = 0.0;
+    for (double q : qs) {
+        auto pos = std::lower_bound(sorted.begin(), sorted.end(), digest.quantile(q));
+        double rank = static_cast<double>(pos - sorted.begin()) / static_cast<double>(sorted.size());
+        worst = std::max(worst, std::abs(rank - q));
+    }
+    rows.push_back({"quantile_tdigest_rank_error", 1, 0, opts.samples, 0.0, 0.0, worst, 0.0});
+
+    // 99.5% VaR (estimate) and ES (variance column) from an O(k) heap
+    montecarlo::TailAggregator tail(0.995, montecarlo::TailAggregator::Tail::upper, opts.samples);
+    start = std::chrono::steady_clock::now();
+    tail.add_batch(values);
+    end = std::chrono::steady_clock::now();
+    elapsed_ms = to_ms(end - start);
+    rows.push_back({"tail_var_es_heap", 1, 0, opts.samples, elapsed_ms,
+        opts.samples / (elapsed_ms / 1000.0), tail.value_at_risk(), tail.expected_shortfall()});
+
+    // Linear binning on a 4096-point grid, then the FFT KDE and ECDF; the
+    // second row's cost depends on the grid only (samples = grid points)
+    montecarlo::DensityAggregator density(4096, 0.0, 20.0);
+    start = std::chrono::steady_clock::now();
+    density.add_batch(values);
+    end = std::chrono::steady_clock::now();
+    elapsed_ms = to_ms(end - start);
+    rows.push_back({"density_binning", 1, 0, opts.samples, elapsed_ms,
+        opts.samples / (elapsed_ms / 1000.0), density.result(), density.variance()});
+    start = std::chrono::steady_clock::now();
+    const std::vector<double> pdf = density.density();
+    const std::vector<double> cdf = density.ecdf();
+    end = std::chrono::steady_clock::now();
+    elapsed_ms = to_ms(end - start);
+    rows.push_back({"density_kde_fft", 1, 0, pdf.size(), elapsed_ms,
+        pdf.size() / (elapsed_ms / 1000.0), pdf[200], cdf[2047]});
+    return rows;
+}
+
+// Log-bucketed histogram: scalar add() versus the blocked add_batch()
+std::vector<BenchRow> bench_log_histogram(const Options& opts) {
+    const std::vector<double> values = lognormal_samples(opts);
+    std::vector<BenchRow> rows;
+
+    montecarlo::LogHistogramAggregator scalar;
+    auto start = std::chrono::steady_clock::now();
+    for (double v : values) {
+        scalar.add(v);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double elapsed_ms = to_ms(end - start);
+    rows.push_back({"histogram_log", 1, 0, opts.samples, elapsed_ms,
+        opts.samples / (elapsed_ms / 1000.0), scalar.quantile(0.99), 0.0});
+
+    montecarlo::LogHistogramAggregator batched;
+    start = std::chrono::steady_clock::now();
+    batched.add_batch(values);
+    end = std::chrono::steady_clock::now();
+    elapsed_ms = to_ms(end - start);
+    rows.push_back({"histogram_log_batch", 1, 0, opts.samples, elapsed_ms,
+        opts.samples / (elapsed_ms / 1000.0), batched.quantile(0.99), 0.0});
+    return rows;
+}
+
+// Raw sample dump: writing blocks through the sink, then summing the
+// mapped file column by column
+std::vector<BenchRow> bench_sample_sink(const Options& opts) {
+    const std::vector<double> values = lognormal_samples(opts);
+    const std::string path = (std::filesystem::temp_directory_path() / "mclib-bench-samples.bin").string();
+    std::vector<BenchRow> rows;
+
+    // Writes on the calling thread versus the background writer with four
+    // recycled buffers, raw and XOR-compressed on the writer thread
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+    double elapsed_ms = 0.0;
+    struct Variant {
+        const char* name;
+        std::size_t async_buffers;
+        montecarlo::io::SampleCodec codec;
+    };
+    const Variant variants[] = {
+        {"sample_sink_write", 0, montecarlo::io::SampleCodec::None},
+        {"sample_sink_write_async_xor", 4, montecarlo::io::SampleCodec::Xor},
+        {"sample_sink_write_async", 4, montecarlo::io::SampleCodec::None},  // scanned below
+    };
+    for (const Variant& variant : variants) {
+        start = std::chrono::steady_clock::now();
+        montecarlo::SampleSinkAggregator sink(path, false, std::size_t{1} << 16, variant.async_buffers,
+                                              {variant.codec});
+        for (std::size_t i = 0; i < values.size(); i += 1024) {
+            sink.add_batch(std::span<const double>(values).subspan(i, std::min<std::size_t>(1024, values.size() - i)));
+        }
+        sink.close();
+        end = std::chrono::steady_clock::now();
+        elapsed_ms = to_ms(end - start);
+        rows.push_back({variant.name, 1, 0, opts.samples, elapsed_ms, opts.samples / (elapsed_ms / 1000.0),
+            sink.result(), sink.variance()});
+    }
+
+    start = std::chrono::steady_clock::now();
+    auto file = montecarlo::io::SampleFile::open(path);
+    double sum = 0.0;
+    file.for_each_block([&](const montecarlo::io::SampleBlock& block) {
+        for (double v : block.values) sum += v;
+    });
+    end = std::chrono::steady_clock::now();
+    elapsed_ms = to_ms(end - start);
+    rows.push_back({"sample_file_mmap_scan", 1, 0, file.count(), elapsed_ms,
+        file.count() / (elapsed_ms / 1000.0), sum / static_cast<double>(file.count()), 0.0});
+    std::filesystem::remove(path);
+    return rows;
+}
+
+// XOR block codec on out-of-the-money call payoffs (mostly zeros), in
+// 64k-sample blocks as the sink writes them: lossless and with 20
+// mantissa bits. Encode rows hold the compression ratio in the estimate
+// column, decode rows the mean of the decoded samples; GB/s of raw
+// samples is throughput * 8e-9.
+std::vector<BenchRow> bench_sample_codec(const Options& opts) {
+    const CallModel call{100.0, 120.0, 0.03, 0.2, 1.0};
+    std::mt19937_64 rng(opts.seed);
+    std::vector<double> values(opts.samples);
+    for (double& v : values) v = call(rng);
+    constexpr std::size_t kBlock = std::size_t{1} << 16;
+    std::vector<BenchRow> rows;
+    std::vector<std::byte> bytes;
+    std::vector<std::size_t> ends;
+    std::vector<double> decoded(kBlock);
+    for (int bits : {52, 20}) {
+        const std::string name = bits == 52 ? "sample_codec_xor" : "sample_codec_xor_lossy20";
+        for (int run_idx = 0; run_idx < opts.repeats; ++run_idx) {
+            bytes.clear();
+            ends.clear();
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < values.size(); i += kBlock) {
+                const std::size_t n = std::min(kBlock, values.size() - i);
+                montecarlo::io::xor_encode(std::span<const double>(values).subspan(i, n), bytes, bits);
+                ends.push_back(bytes.size());
+            }
+            double elapsed_ms = to_ms(std::chrono::steady_clock::now() - start);
+            const double ratio = static_cast<double>(values.size() * sizeof(double)) / static_cast<double>(bytes.size());
+            rows.push_back({name + "_encode", 1, run_idx, opts.samples, elapsed_ms,
+                opts.samples / (elapsed_ms / 1000.0), ratio, 0.0});
+
+            double sum = 0.0;
+            start = std::chrono::steady_clock::now();
+            for (std::size_t b = 0, i = 0; b < ends.size(); ++b, i += kBlock) {
+                const std::size_t begin = b == 0 ? 0 : ends[b - 1];
+                const std::span<double> out = std::span<double>(decoded).first(std::min(kBlock, values.size() - i));
+                montecarlo::io::xor_decode(std::span<const std::byte>(bytes).subspan(begin, ends[b] - begin), out);
+                for (double v : out) sum += v;
+            }
+            elapsed_ms = to_ms(std::chrono::steady_clock::now() - start);
+            rows.push_back({name + "_decode", 1, run_idx, opts.samples, elapsed_ms,
+                opts.samples / (elapsed_ms / 1000.0), sum / static_cast<double>(opts.samples), 0.0});
+        }
+    }
+    return rows;
+}
+
+// Bootstrap throughput in index draws per second: BCa over stored
+// uniform samples, 200 resamples
+std::vector<BenchRow> bench_bootstrap(const Options& opts) {
+    const std::size_t n = static_cast<std::size_t>(std::max<std::uint64_t>(opts.samples / 200, 2));
+    std::vector<double> x(n);
+    auto rng = montecarlo::make_rng(opts.seed);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    for (double& v : x) v = dist(rng);
+    std::vector<BenchRow> rows;
+    for (std::size_t threads : opts.threads) {
+        montecarlo::bootstrap::Options boot;
+        boot.resamples = 200;
+        boot.threads = threads;
+        boot.seed = opts.seed;
+        for (int run_idx = 0; run_idx < opts.repeats; ++run_idx) {
+            const auto start = std::chrono::steady_clock::now();
+            const auto ci = montecarlo::bootstrap::mean_interval(x, boot);
+            const double elapsed_ms = to_ms(std::chrono::steady_clock::now() - start);
+            const std::uint64_t draws = static_cast<std::uint64_t>(n) * boot.resamples;
+            rows.push_back({"bootstrap_mean_bca", threads, run_idx, draws, elapsed_ms,
+                draws / (elapsed_ms / 1000.0), 0.5 * (ci.lower + ci.upper), 0.0});
+        }
+    }
+    return rows;
+}
+
+// Checkpointing overhead: the same run plain and with a snapshot every
+// 64Ki trials per worker
+std::vector<BenchRow> bench_checkpoint(const Options& opts) {
+    const std::string path = (std::filesystem::temp_directory_path() / "mclib-bench-checkpoint.bin").string();
+    const montecarlo::execution::CheckpointOptions checkpoint{path, std::uint64_t{1} << 16};
+    auto engine = make_engine(UniformModel{}, montecarlo::execution::Sequential{}, opts.seed);
+    std::vector<BenchRow> rows;
+    for (bool checkpointed : {false, true}) {
+        for (int run_idx = 0; run_idx < opts.repeats; ++run_idx) {
+            const auto r = checkpointed ? engine.run(opts.samples, checkpoint) : engine.run(opts.samples);
+            rows.push_back({checkpointed ? "checkpoint_every_64k" : "checkpoint_none", 1, run_idx, opts.samples,
+                r.elapsed_ms, opts.samples / (r.elapsed_ms / 1000.0), r.estimate, r.variance});
+        }
+    }
+    std::filesystem::remove(path);
+    return rows;
+}
+
+// First run of a configuration (simulate and store) versus a repeat that
+// is answered from the on-disk result cache; throughput counts the trials
+// the repeat did not have to run
+std::vector<BenchRow> bench_result_cache(const Options& opts) {
+    const auto dir = std::filesystem::temp_directory_path() / "mclib-bench-result-cache";
+    std::filesystem::remove_all(dir);
+    montecarlo::io::ResultCache cache(dir.string());
+    auto engine = make_engine(UniformModel{}, montecarlo::execution::Sequential{}, opts.seed);
+    std::vector<BenchRow> rows;
+    for (bool hit : {false, true}) {
+        for (int run_idx = 0; run_idx < opts.repeats; ++run_idx) {
+            const std::uint64_t n = hit ? opts.samples : opts.samples + static_cast<std::uint64_t>(run_idx);
+            const auto start = std::chrono::steady_clock::now();
+            const auto r = engine.run(n, cache);
+            const double elapsed_ms = to_ms(std::chrono::steady_clock::now() - start);
+            rows.push_back({hit ? "result_cache_hit" : "result_cache_miss", 1, run_idx, n, elapsed_ms,
+                n / (elapsed_ms / 1000.0), r.estimate, r.variance});
+        }
+    }
+    std::filesystem::remove_all(dir);
+    return rows;
+}
+
+// Many small contracts (1000 trials each): one engine per contract versus
+// the batch driver over a mapped parameter file; samples = total trials
+std::vector<BenchRow> bench_batch(const Options& opts) {
+    constexpr std::uint64_t trials = 1'000;
+    const std::size_t contracts = static_cast<std::size_t>(std::max<std::uint64_t>(opts.samples / trials, 1));
+    std::vector<double> s0(contracts), k(contracts, 100.0), r(contracts, 0.03), sigma(contracts), t(contracts);
+    for (std::size_t i = 0; i < contracts; ++i) {
+        s0[i] = 80.0 + static_cast<double>(i % 41);
+        sigma[i] = 0.1 + 0.05 * static_cast<double>(i % 7);
+        t[i] = 0.25 + 0.25 * static_cast<double>(i % 8);
+    }
+    const std::string path = (std::filesystem::temp_directory_path() / "mclib-bench-params.bin").string();
+    montecarlo::io::write_param_file(path, {"S0", "K", "r", "sigma", "T"}, {s0, k, r, sigma, t});
+    std::vector<double> prices(contracts);
+    std::vector<BenchRow> rows;
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < contracts; ++i) {
+        auto engine = make_engine(CallModel{s0[i], k[i], r[i], sigma[i], t[i]},
+            montecarlo::execution::Sequential{}, opts.seed + i);
+        prices[i] = engine.run(trials).estimate;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double elapsed_ms = to_ms(end - start);
+    rows.push_back({"batch_engine_per_contract", 1, 0, contracts * trials, elapsed_ms,
+        contracts * trials / (elapsed_ms / 1000.0), prices[0], 0.0});
+
+    for (std::size_t threads : opts.threads) {
+        montecarlo::execution::Batch batch(threads);
+        start = std::chrono::steady_clock::now();
+        const auto params = montecarlo::io::ParamFile::open(path);
+        batch.run(params, [](const montecarlo::io::ParamRow& p) { return CallModel{p[0], p[1], p[2], p[3], p[4]}; },
+            trials, {prices, {}}, opts.seed);
+        end = std::chrono::steady_clock::now();
+        elapsed_ms = to_ms(end - start);
+        rows.push_back({"batch_param_file", threads, 0, contracts * trials, elapsed_ms,
+            contracts * trials / (elapsed_ms / 1000.0), prices[0], 0.0});
+    }
+    std::filesystem::remove(path);
+    return rows;
+}
+
+// Histogram throughput through the engine: private per-worker bins merged
+// at the end versus one set of shared atomic bins
+template <typename Histogram>
+BenchRow run_histogram(const char* section, std::size_t threads, const Options& opts) {
+    UniformModel model;
+    Histogram hist(16, 0.0, 1.0);
+    montecarlo::Result r;
+#ifdef MCLIB_PARALLEL_ENABLED
+    if (threads > 1) {
+        auto engine = make_engine<UniformModel, montecarlo::execution::Parallel, Histogram>(
+            model, montecarlo::execution::Parallel{threads}, opts.seed);
+        r = engine.run(opts.samples, hist);
+    } else
+#endif
+    {
+        threads = 1;
+        auto engine = make_engine<UniformModel, montecarlo::execution::Sequential, Histogram>(
+            model, montecarlo::execution::Sequential{}, opts.seed);
+        r = engine.run(opts.samples, hist);
+    }
+    double throughput = opts.samples / (r.elapsed_ms / 1000.0);
+    return {section, threads, 0, opts.samples, r.elapsed_ms, throughput, r.estimate, 0.0};
+}
+
 // RNG loop without engine abstractions to gauge overhead
 BenchRow bench_manual_rng(const Options& opts) {
     auto rng = montecarlo::make_rng(opts.seed);
@@ -213,6 +684,43 @@ int main(int argc, char** argv) {
 
         print_row(bench_raw_loop(opts));
         print_row(bench_welford_loop(opts));
+        print_row(bench_welford_batch_loop(opts));
+        print_row(bench_moments_batch_loop(opts));
+        print_row(bench_reproducible_batch_loop(opts));
+        print_row(bench_grouped(opts, true));
+        print_row(bench_grouped(opts, false));
+        print_row(bench_sparse_histogram(opts));
+        print_row(bench_covariance(opts));
+
+        // Streaming quantiles versus exact sorting
+        for (const BenchRow& row : bench_quantiles(opts)) {
+            print_row(row);
+        }
+        for (const BenchRow& row : bench_log_histogram(opts)) {
+            print_row(row);
+        }
+        for (const BenchRow& row : bench_sample_sink(opts)) {
+            print_row(row);
+        }
+        for (const BenchRow& row : bench_sample_codec(opts)) {
+            print_row(row);
+        }
+        for (const BenchRow& row : bench_batch(opts)) {
+            print_row(row);
+        }
+        for (const BenchRow& row : bench_checkpoint(opts)) {
+            print_row(row);
+        }
+        for (const BenchRow& row : bench_bootstrap(opts)) {
+            print_row(row);
+        }
+        for (const BenchRow& row : bench_result_cache(opts)) {
+            print_row(row);
+        }
+        for (std::size_t threads : opts.threads) {
+            print_row(run_histogram<montecarlo::HistogramAggregator<>>("histogram_private", threads, opts));
+            print_row(run_histogram<montecarlo::SharedHistogramAggregator<>>("histogram_shared", threads, opts));
+        }
 
         // Abstraction overhead (manual RNG loop vs engine)
         print_row(bench_manual_rng(opts));
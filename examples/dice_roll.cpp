@@ -16,30 +16,42 @@ void run_dice_roll() {
     std::vector<size_t> sample_sizes {1'000, 10'000, 100'000, 1'000'000, 10'000'000};
     std::cout << "\n=== Dice Roll Expectation Estimation ===" << std::endl;
     std::cout<< "Expectation value of a fair six-sided die is 3.5" << std::endl << std::endl;
-    // Header for sequential runs
-    std::cout << "Sequential Execution:" << std::endl;
-    std::cout << std::string(70, '-') << std::endl;
+    // One sequential run traces the whole convergence curve
+    std::cout << "Sequential Execution (single traced run):" << std::endl;
+    std::cout << std::string(57, '-') << std::endl;
     std::cout << std::setw(12) << "Samples"
               << std::setw(15) << "Estimate"
               << std::setw(15) << "Error"
-              << std::setw(15) << "Std Error"
-              << std::setw(13) << "Time (ms)" << std::endl;
-    std::cout << std::string(70, '-') << std::endl;
+              << std::setw(15) << "Std Error" << std::endl;
+    std::cout << std::string(57, '-') << std::endl;
 
-    for (size_t n : sample_sizes) {
-        // Sequential engine using default RNG and identity transform
-        auto engine = montecarlo::make_engine(dice_roll, montecarlo::execution::Sequential{}, 42ULL, montecarlo::DefaultRngFactory{}, montecarlo::transform::Identity{});
-        auto result = engine.run(n);
-
-        double error = std::abs(result.estimate - 3.5);
+    auto traced = montecarlo::make_engine<decltype(dice_roll), montecarlo::execution::Sequential,
+        montecarlo::ConvergenceTraceAggregator>(dice_roll, montecarlo::execution::Sequential{}, 42ULL);
+    auto run = traced.run_aggregate(sample_sizes.back(), montecarlo::ConvergenceTraceAggregator(1'000, 10.0));
+    for (const montecarlo::TracePoint& point : run.aggregator.trace()) {
+        double error = std::abs(point.mean - 3.5);
 
-        std::cout << std::setw(12) << result.iterations
-        << std::setw(15) << std::fixed << std::setprecision(6) << result.estimate
+        std::cout << std::setw(12) << point.n
+        << std::setw(15) << std::fixed << std::setprecision(6) << point.mean
         << std::setw(15) << std::scientific << std::setprecision(2) << error
         << std::setw(15) << std::fixed << std::setprecision(6)
-        << result.standard_error << std::setw(13) << std::fixed
-        << std::setprecision(4) << result.elapsed_ms << std::endl;
+        << point.std_error << std::endl;
     }
+    std::cout << "Total time (ms): " << std::fixed << std::setprecision(4) << run.elapsed_ms << std::endl;
+
+    // Integer-valued die: outcomes go to the sparse histogram as int64 blocks
+    auto int_die = [](auto& rng) {
+        std::uniform_int_distribution<int> dist(1, 6);
+        return dist(rng);
+    };
+    auto counter = montecarlo::make_engine<decltype(int_die), montecarlo::execution::Sequential,
+        montecarlo::SparseHistogramAggregator>(int_die, montecarlo::execution::Sequential{}, 42ULL);
+    auto faces = counter.run_aggregate(sample_sizes.back(), montecarlo::SparseHistogramAggregator(8));
+    std::cout << "\nFace frequencies over " << faces.aggregator.count() << " rolls:" << std::endl;
+    faces.aggregator.for_each([&](std::int64_t face, std::uint64_t n) {
+        std::cout << std::setw(12) << face << std::setw(15) << std::fixed << std::setprecision(6)
+        << static_cast<double>(n) / static_cast<double>(faces.aggregator.count()) << std::endl;
+    });
 
 #ifdef MCLIB_PARALLEL_ENABLED
     std::cout << "\nParallel Execution:" << std::endl;
@@ -77,6 +77,10 @@ void run_pi_estimation() {
         << std::setw(15) << std::fixed << std::setprecision(6)
         << result.standard_error << std::setw(13) << std::fixed
         << std::setprecision(4) << result.elapsed_ms << std::endl;
+        if (n == sample_sizes.back()) {
+            // Machine-readable record with the per-worker breakdown
+            std::cout << std::endl << montecarlo::to_json(result) << std::endl;
+        }
     }
 #else
     // Friendly note when parallel support is not compiled in
@@ -0,0 +1,326 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "result.hpp"
+
+namespace montecarlo {
+
+// Honest standard errors for autocorrelated trial sequences (MCMC chains,
+// sequential-state models).
+//
+// Non-overlapping batch means are kept at dyadic batch sizes
+// base * 2^l, one level per doubling, so memory is O(log N) and a sample
+// costs amortised O(1). std_error() uses the largest batch size that still
+// has at least `min_batches` complete batches.
+//
+// Lag-k autocovariances up to `max_lag` are accumulated online and feed
+// Geyer's initial monotone sequence estimate of the integrated
+// autocorrelation time.
+//
+// merge() treats the other side as an independent chain: complete batches
+// and lag pairs are pooled, nothing straddles the two chains.
+class BatchMeansAggregator {
+ public:
+    explicit BatchMeansAggregator(std::size_t max_lag = 32, std::size_t min_batches = 32,
+                                  std::size_t base_batch = 16) :
+        max_lag_(max_lag), min_batches_(std::max<std::size_t>(min_batches, 2)),
+        base_batch_(std::max<std::size_t>(base_batch, 1)), lags_(max_lag) {}
+
+    void add(double value) {
+        if (pending_ == 0 && history_.empty() && overall_.count() == 0) shift_ = value;
+        window_.push_back(value - shift_);
+        if (++pending_ == kBlock) flush();
+    }
+
+    void add_batch(std::span<const double> values) {
+        for (double v : values) add(v);
+    }
+
+    void merge(const BatchMeansAggregator& other) {
+        other.flush();
+        flush();
+        if (other.overall_.count() == 0) return;
+        if (overall_.count() == 0) {
+            // Adopt the other chain's shift so its partial state stays valid
+            *this = other;
+            history_.clear();
+            for (Level& level : levels_) {
+                level.partial = 0.0;
+                level.filled = 0;
+            }
+            return;
+        }
+        overall_.merge(other.overall_);
+        if (levels_.size() < other.levels_.size()) levels_.resize(other.levels_.size());
+        for (std::size_t l = 0; l < other.levels_.size(); ++l) {
+            levels_[l].means.merge(other.levels_[l].means);
+        }
+        // Re-express the other chain's lag sums relative to our shift
+        const double delta = other.shift_ - shift_;
+        for (std::size_t k = 0; k < lags_.size() && k < other.lags_.size(); ++k) {
+            const LagSums& o = other.lags_[k];
+            const double n = static_cast<double>(o.pairs);
+            lags_[k].pairs += o.pairs;
+            lags_[k].product += o.product + delta * (o.head + o.tail) + n * delta * delta;
+            lags_[k].head += o.head + n * delta;
+            lags_[k].tail += o.tail + n * delta;
+        }
+    }
+
+    double result() const {
+        flush();
+        return overall_.result();
+    }
+
+    // Marginal sample variance of the outputs
+    double variance() const {
+        flush();
+        return overall_.variance();
+    }
+
+    // Batch-means standard error of the mean
+    double std_error() const {
+        const Level* level = chosen_level();
+        if (level == nullptr) return naive_std_error();
+        return std::sqrt(level->means.variance() / static_cast<double>(level->means.count()));
+    }
+
+    // What WelfordAggregator would report, assuming independence
+    double naive_std_error() const {
+        flush();
+        return overall_.std_error();
+    }
+
+    // Batch size behind std_error(), 0 if there are too few batches yet
+    std::uint64_t batch_size() const {
+        const Level* level = chosen_level();
+        if (level == nullptr) return 0;
+        return static_cast<std::uint64_t>(base_batch_) << (level - levels_.data());
+    }
+
+    double effective_sample_size() const {
+        double se = std_error();
+        if (se <= 0.0) return static_cast<double>(count());
+        return variance() / (se * se);
+    }
+
+    // Lag-k autocorrelation, 1 <= k <= max_lag
+    double autocorrelation(std::size_t lag) const {
+        flush();
+        if (lag == 0) return 1.0;
+        if (lag > lags_.size()) return 0.0;
+        const LagSums& s = lags_[lag - 1];
+        if (s.pairs == 0 || overall_.count() < 2) return 0.0;
+        const double n = static_cast<double>(s.pairs);
+        const double gamma = s.product / n - (s.head / n) * (s.tail / n);
+        const double n_all = static_cast<double>(overall_.count());
+        const double gamma0 = overall_.variance() * (n_all - 1.0) / n_all;
+        return gamma0 > 0.0 ? gamma / gamma0 : 0.0;
+    }
+
+    // Geyer's initial monotone sequence estimator; a lower bound if the
+    // sequence is still positive at max_lag
+    double integrated_autocorrelation_time() const {
+        double sum = 0.0;
+        double prev = std::numeric_limits<double>::infinity();
+        for (std::size_t m = 0; 2 * m + 1 <= max_lag_; ++m) {
+            double pair = autocorrelation(2 * m) + autocorrelation(2 * m + 1);
+            if (pair <= 0.0) break;
+            pair = std::min(pair, prev);
+            sum += pair;
+            prev = pair;
+        }
+        return std::max(1.0, 2.0 * sum - 1.0);
+    }
+
+    // The pending block is folded in first; the lag history is kept so a
+    // restored chain continues seamlessly
+    void serialize(ByteWriter& w) const {
+        flush();
+        w.tag(kTag);
+        w.write(max_lag_);
+        w.write(min_batches_);
+        w.write(base_batch_);
+        w.write(shift_);
+        overall_.serialize(w);
+        w.write(levels_.size());
+        for (const Level& level : levels_) {
+            w.write(level.partial);
+            w.write(level.filled);
+            level.means.serialize(w);
+        }
+        for (const LagSums& lag : lags_) {
+            w.write(lag.pairs);
+            w.write(lag.head);
+            w.write(lag.tail);
+            w.write(lag.product);
+        }
+        w.write(history_);
+    }
+
+    static BatchMeansAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "BatchMeansAggregator");
+        const auto max_lag = r.read<std::size_t>();
+        const auto min_batches = r.read<std::size_t>();
+        const auto base_batch = r.read<std::size_t>();
+        if (max_lag > r.remaining() / 32) throw std::runtime_error("ByteReader: truncated input");
+        BatchMeansAggregator agg(max_lag, min_batches, base_batch);
+        r.read(agg.shift_);
+        agg.overall_ = WelfordAggregator<>::deserialize(r);
+        const auto levels = r.read<std::size_t>();
+        if (levels > r.remaining() / 16) throw std::runtime_error("ByteReader: truncated input");
+        agg.levels_.resize(levels);
+        for (Level& level : agg.levels_) {
+            r.read(level.partial);
+            r.read(level.filled);
+            level.means = WelfordAggregator<>::deserialize(r);
+        }
+        for (LagSums& lag : agg.lags_) {
+            r.read(lag.pairs);
+            r.read(lag.head);
+            r.read(lag.tail);
+            r.read(lag.product);
+        }
+        r.read(agg.history_);
+        return agg;
+    }
+
+    void reset() {
+        overall_.reset();
+        levels_.clear();
+        std::fill(lags_.begin(), lags_.end(), LagSums{});
+        history_.clear();
+        window_.clear();
+        pending_ = 0;
+        shift_ = 0.0;
+    }
+
+    std::uint64_t count() const { return overall_.count() + pending_; }
+
+ private:
+    static constexpr std::size_t kBlock = 1024;
+    static constexpr std::uint32_t kTag = fourcc("BMNS");
+
+    struct Level {
+        double partial = 0.0;      // shifted sum of the open batch
+        std::uint64_t filled = 0;  // samples (level 0) or half-batches in it
+        WelfordAggregator<> means;
+    };
+
+    struct LagSums {
+        std::uint64_t pairs = 0;
+        double head = 0.0;     // sum of x_t
+        double tail = 0.0;     // sum of x_{t+k}
+        double product = 0.0;  // sum of x_t * x_{t+k}
+    };
+
+    const Level* chosen_level() const {
+        flush();
+        const Level* best = nullptr;
+        for (const Level& level : levels_) {
+            if (level.means.count() >= min_batches_) best = &level;
+        }
+        return best;
+    }
+
+    // Push a completed batch sum into level l, carrying upwards
+    void close_batch(std::size_t l, double sum) const {
+        for (;;) {
+            if (levels_.size() <= l) levels_.resize(l + 1);
+            Level& level = levels_[l];
+            const double size = static_cast<double>(base_batch_ << l);
+            level.means.add(sum / size + shift_);
+            if (l + 1 >= levels_.size()) levels_.resize(l + 2);
+            Level& up = levels_[l + 1];
+            up.partial += sum;
+            if (++up.filled < 2) return;
+            sum = up.partial;
+            up.partial = 0.0;
+            up.filled = 0;
+            ++l;
+        }
+    }
+
+    // Fold the pending block into the overall moments, the dyadic batch
+    // levels and the lag sums (vectorisable per lag over the block)
+    void flush() const {
+        if (pending_ == 0) return;
+        const std::size_t h = history_.size();
+        window_.insert(window_.begin(), history_.begin(), history_.end());
+        const double* w = window_.data();
+        const double* block = w + h;
+        const std::size_t n = pending_;
+
+        std::vector<double> raw(block, block + n);
+        for (double& v : raw) v += shift_;
+        overall_.add_batch(raw);
+
+        if (levels_.empty()) levels_.resize(1);
+        for (std::size_t j = 0; j < n; ++j) {
+            Level& base = levels_[0];
+            base.partial += block[j];
+            if (++base.filled == base_batch_) {
+                double sum = base.partial;
+                base.partial = 0.0;
+                base.filled = 0;
+                close_batch(0, sum);
+            }
+        }
+
+        for (std::size_t k = 1; k <= max_lag_; ++k) {
+            // Pairs (t - k, t) for t in the block with t - k in this chain;
+            // t indexes the window, whose first h values are history
+            const std::size_t first = std::max(h, k);
+            const std::size_t last = h + n;
+            if (first >= last) continue;
+            constexpr std::size_t kLanes = 4;
+            double head[kLanes] = {}, tail[kLanes] = {}, prod[kLanes] = {};
+            std::size_t t = first;
+            for (; t + kLanes <= last; t += kLanes) {
+                for (std::size_t l = 0; l < kLanes; ++l) {
+                    const double a = w[t + l - k];
+                    const double b = w[t + l];
+                    head[l] += a;
+                    tail[l] += b;
+                    prod[l] += a * b;
+                }
+            }
+            for (; t < last; ++t) {
+                head[0] += w[t - k];
+                tail[0] += w[t];
+                prod[0] += w[t - k] * w[t];
+            }
+            LagSums& s = lags_[k - 1];
+            s.pairs += last - first;
+            s.head += (head[0] + head[1]) + (head[2] + head[3]);
+            s.tail += (tail[0] + tail[1]) + (tail[2] + tail[3]);
+            s.product += (prod[0] + prod[1]) + (prod[2] + prod[3]);
+        }
+
+        // Keep the last max_lag values as history for the next block
+        const std::size_t keep = std::min(max_lag_, window_.size());
+        history_.assign(window_.end() - static_cast<std::ptrdiff_t>(keep), window_.end());
+        window_.clear();
+        pending_ = 0;
+    }
+
+    std::size_t max_lag_;
+    std::size_t min_batches_;
+    std::size_t base_batch_;
+    double shift_ = 0.0;
+    // Queries fold any pending block first, hence mutable
+    mutable WelfordAggregator<> overall_;
+    mutable std::vector<Level> levels_;
+    mutable std::vector<LagSums> lags_;
+    mutable std::vector<double> history_;
+    mutable std::vector<double> window_;
+    mutable std::size_t pending_ = 0;
+};
+
+} // namespace montecarlo
@@ -0,0 +1,311 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "result.hpp"
+#include "rng.hpp"
+#include "../execution/worker_pool.hpp"
+
+namespace montecarlo::bootstrap {
+
+// A statistic the bootstrap can evaluate without building resamples: it is
+// reset, fed the indices drawn for one resample (with repeats), and read.
+// remove(i), the inverse of add(i), makes the jackknife behind BCa O(n).
+template<typename S>
+concept Statistic = std::copy_constructible<S> && requires(S s, const S& cs, std::size_t i) {
+    s.reset();
+    s.add(i);
+    { cs.value() } -> std::convertible_to<double>;
+};
+
+template<typename S>
+concept RemovableStatistic = Statistic<S> && requires(S s, std::size_t i) { s.remove(i); };
+
+// Mean of x
+class Mean {
+ public:
+    explicit Mean(std::span<const double> x) : x_(x) {}
+
+    void reset() {
+        sum_ = 0.0;
+        n_ = 0;
+    }
+    void add(std::size_t i) {
+        sum_ += x_[i];
+        ++n_;
+    }
+    void remove(std::size_t i) {
+        sum_ -= x_[i];
+        --n_;
+    }
+    double value() const { return n_ > 0 ? sum_ / static_cast<double>(n_) : 0.0; }
+
+ private:
+    std::span<const double> x_;
+    double sum_ = 0.0;
+    std::size_t n_ = 0;
+};
+
+// Ratio estimator sum(num) / sum(den) over paired samples, e.g. a
+// conditional expectation or a self-normalised importance-sampling mean
+class Ratio {
+ public:
+    Ratio(std::span<const double> num, std::span<const double> den) : num_(num), den_(den) {
+        if (num.size() != den.size()) throw std::invalid_argument("bootstrap::Ratio: samples differ in length");
+    }
+
+    void reset() {
+        num_sum_ = 0.0;
+        den_sum_ = 0.0;
+    }
+    void add(std::size_t i) {
+        num_sum_ += num_[i];
+        den_sum_ += den_[i];
+    }
+    void remove(std::size_t i) {
+        num_sum_ -= num_[i];
+        den_sum_ -= den_[i];
+    }
+    double value() const { return num_sum_ / den_sum_; }
+
+ private:
+    std::span<const double> num_;
+    std::span<const double> den_;
+    double num_sum_ = 0.0;
+    double den_sum_ = 0.0;
+};
+
+enum class Method {
+    Percentile,  // quantiles of the bootstrap distribution
+    BCa,         // bias-corrected and accelerated; needs a RemovableStatistic
+};
+
+struct Options {
+    std::size_t resamples = 2'000;
+    double level = 0.95;
+    Method method = Method::BCa;
+    // Above 1: circular block bootstrap with blocks of this many consecutive
+    // samples, for autocorrelated data; BCa then jackknifes whole blocks
+    std::size_t block = 1;
+    std::size_t threads = 0;  // 0 = one per hardware thread
+    std::uint64_t seed = 42;
+};
+
+namespace detail {
+
+// Resamples drawn from one generator; chunk c is seeded from (seed, c), so
+// the replicates do not depend on the thread count
+inline constexpr std::size_t kChunk = 64;
+
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 uint128;
+#endif
+
+// Uniform index in [0, n): Lemire's multiply-and-shift with rejection on
+// full-width 64-bit generators, std::uniform_int_distribution otherwise
+template<typename Rng>
+std::size_t draw_index(Rng& rng, std::uint64_t n) {
+#ifdef __SIZEOF_INT128__
+    if constexpr (Rng::min() == 0 && Rng::max() == std::numeric_limits<std::uint64_t>::max()) {
+        uint128 m = static_cast<uint128>(rng()) * n;
+        auto low = static_cast<std::uint64_t>(m);
+        if (low < n) {
+            const std::uint64_t threshold = (0 - n) % n;
+            while (low < threshold) {
+                m = static_cast<uint128>(rng()) * n;
+                low = static_cast<std::uint64_t>(m);
+            }
+        }
+        return static_cast<std::size_t>(m >> 64);
+    }
+#endif
+    return static_cast<std::size_t>(std::uniform_int_distribution<std::uint64_t>(0, n - 1)(rng));
+}
+
+// Feed one resample's indices: n single draws, or blocks of `block`
+// consecutive indices (wrapping at n) from random starts
+template<typename S, typename Rng>
+void resample(S& s, Rng& rng, std::size_t n, std::size_t block) {
+    if (block <= 1) {
+        for (std::size_t i = 0; i < n; ++i) s.add(draw_index(rng, n));
+        return;
+    }
+    for (std::size_t filled = 0; filled < n;) {
+        const std::size_t start = draw_index(rng, n);
+        const std::size_t len = std::min(block, n - filled);
+        const std::size_t head = std::min(len, n - start);
+        for (std::size_t j = 0; j < head; ++j) s.add(start + j);
+        for (std::size_t j = 0; j < len - head; ++j) s.add(j);
+        filled += len;
+    }
+}
+
+inline double normal_cdf(double x) {
+    return 0.5 * std::erfc(-x / std::sqrt(2.0));
+}
+
+// Acklam's rational approximation, polished by one Halley step
+inline double normal_quantile(double p) {
+    if (p <= 0.0) return -std::numeric_limits<double>::infinity();
+    if (p >= 1.0) return std::numeric_limits<double>::infinity();
+    constexpr double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                            1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+    constexpr double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                            6.680131188771972e+01, -1.328068155288572e+01};
+    constexpr double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                            -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+    constexpr double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                            3.754408661907416e+00};
+    constexpr double low = 0.02425;
+    double x;
+    if (p < low) {
+        const double q = std::sqrt(-2.0 * std::log(p));
+        x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+    } else if (p <= 1.0 - low) {
+        const double q = p - 0.5;
+        const double r = q * q;
+        x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+            (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+    } else {
+        const double q = std::sqrt(-2.0 * std::log(1.0 - p));
+        x = -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+    }
+    const double e = normal_cdf(x) - p;
+    const double u = e * std::sqrt(2.0 * std::numbers::pi) * std::exp(x * x / 2.0);
+    return x - u / (1.0 + x * u / 2.0);
+}
+
+// Linear interpolation between order statistics of sorted values
+inline double sorted_quantile(const std::vector<double>& sorted, double p) {
+    const double h = std::clamp(p, 0.0, 1.0) * static_cast<double>(sorted.size() - 1);
+    const auto lo = static_cast<std::size_t>(h);
+    const std::size_t hi = std::min(lo + 1, sorted.size() - 1);
+    const double a = sorted[lo];
+    const double b = sorted[hi];
+    return a == b ? a : a + (h - static_cast<double>(lo)) * (b - a);
+}
+
+} // namespace detail
+
+// Bootstrap confidence interval for a statistic of n stored samples.
+// Replicates are computed in parallel on a WorkerPool: each worker keeps
+// one copy of `stat` and feeds it drawn indices, so no resample is ever
+// built. Generators come from rng_factory, one per chunk of resamples.
+template<Statistic S, typename RngFactory = DefaultRngFactory>
+ConfidenceInterval interval(std::size_t n, const S& stat, const Options& opts = {},
+                            RngFactory rng_factory = RngFactory{}) {
+    if (n == 0 || opts.resamples < 2) throw std::invalid_argument("bootstrap::interval: need samples and resamples");
+    if (!(opts.level > 0.0 && opts.level < 1.0)) throw std::invalid_argument("bootstrap::interval: level out of (0, 1)");
+    if constexpr (!RemovableStatistic<S>) {
+        if (opts.method == Method::BCa) throw std::invalid_argument("bootstrap::interval: BCa needs a statistic with remove()");
+    }
+    const std::size_t block = std::clamp<std::size_t>(opts.block, 1, n);
+
+    std::vector<double> replicates(opts.resamples);
+    std::atomic<std::size_t> next{0};
+    auto work = [&](std::size_t) {
+        S s = stat;
+        for (std::size_t first = next.fetch_add(detail::kChunk, std::memory_order_relaxed); first < replicates.size();
+             first = next.fetch_add(detail::kChunk, std::memory_order_relaxed)) {
+            auto rng = rng_factory(::montecarlo::detail::derive_seed(opts.seed, first / detail::kChunk));
+            const std::size_t last = std::min(replicates.size(), first + detail::kChunk);
+            for (std::size_t b = first; b < last; ++b) {
+                s.reset();
+                detail::resample(s, rng, n, block);
+                replicates[b] = s.value();
+            }
+        }
+    };
+    execution::WorkerPool pool(opts.threads);
+    pool.run(work);
+    std::sort(replicates.begin(), replicates.end());
+
+    const double alpha = (1.0 - opts.level) / 2.0;
+    auto percentile = [&]() -> ConfidenceInterval {
+        return {detail::sorted_quantile(replicates, alpha), detail::sorted_quantile(replicates, 1.0 - alpha),
+                opts.level};
+    };
+    if constexpr (!RemovableStatistic<S>) {
+        return percentile();  // BCa was rejected before resampling
+    } else {
+        if (opts.method == Method::Percentile) return percentile();
+
+        S full = stat;
+        full.reset();
+        for (std::size_t i = 0; i < n; ++i) full.add(i);
+        const double estimate = full.value();
+
+        // Bias correction: where the estimate falls in the replicates
+        const auto below = std::lower_bound(replicates.begin(), replicates.end(), estimate) - replicates.begin();
+        const auto equal = std::upper_bound(replicates.begin(), replicates.end(), estimate) - replicates.begin() - below;
+        const double b = static_cast<double>(replicates.size());
+        const double share = std::clamp((static_cast<double>(below) + 0.5 * static_cast<double>(equal)) / b,
+                                        0.5 / b, 1.0 - 0.5 / b);
+        const double z0 = detail::normal_quantile(share);
+
+        // Acceleration from the (block) jackknife: drop each group in turn
+        const std::size_t groups = n / block;
+        std::vector<double> jack(groups);
+        for (std::size_t g = 0; g < groups; ++g) {
+            const std::size_t lo = g * block;
+            const std::size_t hi = g + 1 == groups ? n : lo + block;
+            for (std::size_t i = lo; i < hi; ++i) full.remove(i);
+            jack[g] = full.value();
+            for (std::size_t i = lo; i < hi; ++i) full.add(i);
+        }
+        double mean = 0.0;
+        for (double v : jack) mean += v;
+        mean /= static_cast<double>(groups);
+        double num = 0.0;
+        double den = 0.0;
+        for (double v : jack) {
+            const double d = mean - v;
+            num += d * d * d;
+            den += d * d;
+        }
+        const double a = den > 0.0 ? num / (6.0 * std::pow(den, 1.5)) : 0.0;
+
+        auto adjusted = [&](double p) {
+            const double z = z0 + detail::normal_quantile(p);
+            return detail::normal_cdf(z0 + z / (1.0 - a * z));
+        };
+        return {detail::sorted_quantile(replicates, adjusted(alpha)),
+                detail::sorted_quantile(replicates, adjusted(1.0 - alpha)), opts.level};
+    }
+}
+
+inline ConfidenceInterval mean_interval(std::span<const double> x, const Options& opts = {}) {
+    return interval(x.size(), Mean(x), opts);
+}
+
+inline ConfidenceInterval ratio_interval(std::span<const double> num, std::span<const double> den,
+                                         const Options& opts = {}) {
+    return interval(num.size(), Ratio(num, den), opts);
+}
+
+// Means of consecutive non-overlapping batches (a trailing partial batch is
+// dropped): for long correlated chains, bootstrapping batch means is a
+// cheaper alternative to the block bootstrap on the raw samples
+inline std::vector<double> batch_means(std::span<const double> x, std::size_t batch) {
+    batch = std::max<std::size_t>(batch, 1);
+    std::vector<double> means(x.size() / batch);
+    for (std::size_t m = 0; m < means.size(); ++m) {
+        double sum = 0.0;
+        for (std::size_t i = 0; i < batch; ++i) sum += x[m * batch + i];
+        means[m] = sum / static_cast<double>(batch);
+    }
+    return means;
+}
+
+} // namespace montecarlo::bootstrap
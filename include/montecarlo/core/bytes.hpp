@@ -0,0 +1,202 @@
+#pragma once
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace montecarlo {
+
+// Four-character tag that opens every serialised aggregator
+constexpr std::uint32_t fourcc(const char (&tag)[5]) {
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(tag[0])) |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(tag[1])) << 8 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(tag[2])) << 16 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(tag[3])) << 24;
+}
+
+// Largest size-like configuration field (a capacity or dimension, in
+// elements) accepted from serialised state; a larger value is taken as
+// corrupt rather than passed to a constructor that allocates from it
+inline constexpr std::uint64_t kMaxConfigSize = std::uint64_t{1} << 28;
+
+// Little-endian wire format for aggregator state. Integers of any width are
+// stored as 64 bits (so size_t state is portable) and floating point as
+// IEEE binary64; vectors and strings carry a 64-bit length prefix.
+class ByteWriter {
+ public:
+    template<typename T>
+        requires std::is_arithmetic_v<T>
+    void write(T value) {
+        if constexpr (std::is_floating_point_v<T>) {
+            put(std::bit_cast<std::uint64_t>(static_cast<double>(value)));
+        } else if constexpr (std::is_signed_v<T>) {
+            put(static_cast<std::uint64_t>(static_cast<std::int64_t>(value)));
+        } else {
+            put(static_cast<std::uint64_t>(value));
+        }
+    }
+
+    void write(const std::string& value) {
+        write(value.size());
+        const auto* p = reinterpret_cast<const std::byte*>(value.data());
+        bytes_.insert(bytes_.end(), p, p + value.size());
+    }
+
+    template<typename T>
+    void write(const std::vector<T>& values) {
+        write(values.size());
+        for (const T& v : values) write(v);
+    }
+
+    // Length-prefixed raw bytes, e.g. another object's serialised state
+    void write_bytes(std::span<const std::byte> bytes) {
+        write(bytes.size());
+        bytes_.insert(bytes_.end(), bytes.begin(), bytes.end());
+    }
+
+    void tag(std::uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            bytes_.push_back(static_cast<std::byte>(value >> (8 * i)));
+        }
+    }
+
+    const std::vector<std::byte>& bytes() const { return bytes_; }
+    std::vector<std::byte> take() { return std::move(bytes_); }
+
+ private:
+    void put(std::uint64_t v) {
+        for (int i = 0; i < 8; ++i) {
+            bytes_.push_back(static_cast<std::byte>(v >> (8 * i)));
+        }
+    }
+
+    std::vector<std::byte> bytes_;
+};
+
+// Reads what ByteWriter wrote; throws std::runtime_error on truncated,
+// mismatched or out-of-range input
+class ByteReader {
+ public:
+    explicit ByteReader(std::span<const std::byte> bytes) : bytes_(bytes) {}
+
+    template<typename T>
+        requires std::is_arithmetic_v<T>
+    T read() {
+        const std::uint64_t v = get();
+        if constexpr (std::is_same_v<T, bool>) {
+            return v != 0;
+        } else if constexpr (std::is_floating_point_v<T>) {
+            return static_cast<T>(std::bit_cast<double>(v));
+        } else if constexpr (std::is_signed_v<T>) {
+            return static_cast<T>(static_cast<std::int64_t>(v));
+        } else {
+            return static_cast<T>(v);
+        }
+    }
+
+    template<typename T>
+    void read(T& out) {
+        if constexpr (std::is_same_v<T, std::string>) {
+            const std::size_t n = length(1);
+            out.assign(reinterpret_cast<const char*>(bytes_.data() + pos_), n);
+            pos_ += n;
+        } else if constexpr (requires { typename T::value_type; out.resize(0); }) {
+            const std::size_t n = length(8);
+            out.resize(n);
+            for (auto& v : out) read(v);
+        } else {
+            out = read<T>();
+        }
+    }
+
+    // Configuration field checked against [lo, hi] before a constructor
+    // sizes allocations or loops from it; NaN is never in range
+    template<typename T>
+        requires std::is_arithmetic_v<T>
+    T read_in(T lo, T hi, const char* what) {
+        const T v = read<T>();
+        if (!(v >= lo && v <= hi)) throw std::runtime_error(std::string(what) + ": configuration out of range");
+        return v;
+    }
+
+    double read_finite(const char* what) {
+        return read_in(-std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), what);
+    }
+
+    // What write_bytes() wrote, as a view into the input
+    std::span<const std::byte> read_bytes() {
+        const std::size_t n = length(1);
+        const std::span<const std::byte> out = bytes_.subspan(pos_, n);
+        pos_ += n;
+        return out;
+    }
+
+    void expect_tag(std::uint32_t value, const char* what) {
+        need(4);
+        std::uint32_t got = 0;
+        for (int i = 0; i < 4; ++i) {
+            got |= static_cast<std::uint32_t>(bytes_[pos_ + i]) << (8 * i);
+        }
+        pos_ += 4;
+        if (got != value) {
+            throw std::runtime_error(std::string("ByteReader: expected ") + what + " state");
+        }
+    }
+
+    bool done() const { return pos_ == bytes_.size(); }
+    std::size_t remaining() const { return bytes_.size() - pos_; }
+
+ private:
+    void need(std::size_t n) const {
+        if (bytes_.size() - pos_ < n) throw std::runtime_error("ByteReader: truncated input");
+    }
+
+    // Length prefix, checked against what is left so corrupt input cannot
+    // trigger a huge allocation
+    std::size_t length(std::size_t min_element_size) {
+        const std::uint64_t n = get();
+        if (n > remaining() / min_element_size) throw std::runtime_error("ByteReader: truncated input");
+        return static_cast<std::size_t>(n);
+    }
+
+    std::uint64_t get() {
+        need(8);
+        std::uint64_t v = 0;
+        for (int i = 0; i < 8; ++i) {
+            v |= static_cast<std::uint64_t>(bytes_[pos_ + i]) << (8 * i);
+        }
+        pos_ += 8;
+        return v;
+    }
+
+    std::span<const std::byte> bytes_;
+    std::size_t pos_ = 0;
+};
+
+// Serialise an aggregator's complete state
+template<typename Aggregator>
+    requires requires(const Aggregator& agg, ByteWriter& w) { agg.serialize(w); }
+std::vector<std::byte> to_bytes(const Aggregator& agg) {
+    ByteWriter w;
+    agg.serialize(w);
+    return w.take();
+}
+
+// Rebuild an aggregator from to_bytes() output
+template<typename Aggregator>
+    requires requires(ByteReader& r) { { Aggregator::deserialize(r) } -> std::same_as<Aggregator>; }
+Aggregator from_bytes(std::span<const std::byte> bytes) {
+    ByteReader r(bytes);
+    Aggregator agg = Aggregator::deserialize(r);
+    if (!r.done()) throw std::runtime_error("from_bytes: trailing bytes");
+    return agg;
+}
+
+} // namespace montecarlo
@@ -1,8 +1,10 @@
 #pragma once
 #include <concepts>
 #include <random>
+#include <span>
 #include <type_traits>
 #include <cstdint>
+#include "bytes.hpp"
 
 namespace montecarlo {
 
@@ -33,6 +35,45 @@ concept ResultAggregator = requires(Aggregator agg, T value) {
     { agg.reset() } -> std::same_as<void>;
 };
 
+// Aggregators that can take a whole block of trial results at once
+template<typename Aggregator>
+concept BatchAggregator = requires(Aggregator agg, std::span<const double> values) {
+    { agg.add_batch(values) } -> std::same_as<void>;
+};
+
+// Aggregators that take blocks of integer trial results as integers,
+// skipping the round trip through double
+template<typename Aggregator>
+concept IntegerBatchAggregator = requires(Aggregator agg, std::span<const std::int64_t> values) {
+    { agg.add_batch(values) } -> std::same_as<void>;
+};
+
+// Partial results combine exactly: in-process through merge(), across
+// processes and checkpoints through the serialised state
+template<typename Aggregator>
+concept MergeableAggregator = requires(Aggregator agg, const Aggregator& other, ByteWriter& w, ByteReader& r) {
+    agg.merge(other);
+    other.serialize(w);
+    { Aggregator::deserialize(r) } -> std::same_as<Aggregator>;
+};
+
+// Where one worker's share of a run sits: the run seed, the worker's
+// stream id, the global index range of the trials it executes and the
+// size of the whole run
+struct StreamContext {
+    std::uint64_t seed;
+    std::uint64_t stream_id;
+    std::uint64_t first_trial;
+    std::uint64_t trials;
+    std::uint64_t run_trials;
+};
+
+// Aggregators that want to know which trials they are about to receive
+template<typename Aggregator>
+concept StreamAwareAggregator = requires(Aggregator agg, const StreamContext& ctx) {
+    { agg.begin_stream(ctx) } -> std::same_as<void>;
+};
+
 // Factory returns a seeded random generator
 template<typename F>
 concept RngFactory = requires(F f, std::uint64_t s) {
@@ -0,0 +1,113 @@
+#pragma once
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include "rng.hpp"
+
+namespace montecarlo {
+
+// 128-bit key identifying a run configuration
+struct CacheKey {
+    std::uint64_t hi = 0;
+    std::uint64_t lo = 0;
+
+    friend bool operator==(const CacheKey&, const CacheKey&) = default;
+};
+
+// Stable hash of configuration values: the same values in the same order
+// give the same hash in every process and build. Two independently mixed
+// 64-bit lanes make up a CacheKey; value() folds them for components that
+// report a single 64-bit hash.
+//
+// Models opt into result caching with
+//     std::uint64_t config_hash() const {
+//         return ConfigHasher{}.add("MyModel").add(s0_).add(sigma_).value();
+//     }
+// Naming the model keeps two models with equal parameters apart.
+class ConfigHasher {
+ public:
+    template<typename T>
+        requires std::is_arithmetic_v<T>
+    ConfigHasher& add(T value) {
+        if constexpr (std::is_floating_point_v<T>) {
+            return word(std::bit_cast<std::uint64_t>(static_cast<double>(value)));
+        } else if constexpr (std::is_signed_v<T>) {
+            return word(static_cast<std::uint64_t>(static_cast<std::int64_t>(value)));
+        } else {
+            return word(static_cast<std::uint64_t>(value));
+        }
+    }
+
+    ConfigHasher& add(std::string_view text) {
+        return add(std::as_bytes(std::span<const char>(text.data(), text.size())));
+    }
+
+    ConfigHasher& add(const char* text) { return add(std::string_view(text)); }
+
+    // Length, then the bytes packed eight to a word
+    ConfigHasher& add(std::span<const std::byte> bytes) {
+        word(bytes.size());
+        std::uint64_t w = 0;
+        for (std::size_t i = 0; i < bytes.size(); ++i) {
+            w |= static_cast<std::uint64_t>(bytes[i]) << (8 * (i % 8));
+            if (i % 8 == 7) {
+                word(w);
+                w = 0;
+            }
+        }
+        if (bytes.size() % 8 != 0) word(w);
+        return *this;
+    }
+
+    std::uint64_t value() const { return detail::splitmix64(a_ ^ detail::splitmix64(b_ + n_)); }
+
+    CacheKey key() const {
+        CacheKey k{detail::splitmix64(a_ ^ n_), detail::splitmix64(b_ + n_)};
+        if (k.hi == 0 && k.lo == 0) k.lo = 1;  // all zeros marks an empty index slot
+        return k;
+    }
+
+ private:
+    ConfigHasher& word(std::uint64_t v) {
+        a_ = detail::splitmix64(a_ ^ v);
+        b_ = detail::splitmix64(b_ + v + 0x9e3779b97f4a7c15ULL);
+        ++n_;
+        return *this;
+    }
+
+    std::uint64_t a_ = 0x6a09e667f3bcc908ULL;
+    std::uint64_t b_ = 0xbb67ae8584caa73bULL;
+    std::uint64_t n_ = 0;
+};
+
+template<typename T>
+concept ConfigHashable = requires(const T& t) {
+    { t.config_hash() } -> std::convertible_to<std::uint64_t>;
+};
+
+// Components a cache key can cover: those with config_hash(), and the
+// stateless DefaultRngFactory, which rng.hpp defines without one. Other
+// stateless types are not keyed by their type name: the name stays the
+// same when a model's or lambda's code changes, and the cache would
+// return results of the old code.
+template<typename T>
+concept CacheKeyable = ConfigHashable<T> || std::same_as<T, DefaultRngFactory>;
+
+namespace detail {
+
+template<CacheKeyable T>
+std::uint64_t config_hash(const T& value) {
+    if constexpr (ConfigHashable<T>) {
+        return value.config_hash();
+    } else {
+        return ConfigHasher{}.add("DefaultRngFactory").value();
+    }
+}
+
+} // namespace detail
+
+} // namespace montecarlo
@@ -0,0 +1,158 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "concepts.hpp"
+#include "result.hpp"
+
+namespace montecarlo {
+
+// One point of a convergence curve: the estimate after the first n trials
+struct TracePoint {
+    std::uint64_t n;
+    double mean;
+    double std_error;
+};
+
+// Records (n, mean, std_error) at geometric checkpoints n = first,
+// first * growth, ... during a single run, replacing repeated runs at
+// 1k, 10k, ... iterations.
+//
+// Checkpoints refer to global trial indices. Each worker snapshots the
+// running moments of its own range at the checkpoints that fall inside
+// it; merging contiguous ranges in trial order prefixes the later
+// worker's snapshots with everything before it, so the merged trace is
+// the trace of the concatenated trials.
+class ConvergenceTraceAggregator {
+ public:
+    explicit ConvergenceTraceAggregator(std::uint64_t first = 1000, double growth = 2.0) :
+        first_(std::max<std::uint64_t>(first, 1)), growth_(std::max(growth, 1.0)), next_(first_) {}
+
+    void begin_stream(const StreamContext& ctx) {
+        begin_ = ctx.first_trial;
+        next_ = first_;
+        while (next_ <= begin_) next_ = advance(next_);
+    }
+
+    void add(double value) {
+        total_.add(value);
+        if (begin_ + total_.count() == next_) checkpoint();
+    }
+
+    // Blocks are split at checkpoints so the batch path stays in use
+    void add_batch(std::span<const double> values) {
+        while (!values.empty()) {
+            const std::uint64_t to_next = next_ - (begin_ + total_.count());
+            const std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(to_next, values.size()));
+            total_.add_batch(values.first(n));
+            values = values.subspan(n);
+            if (n == to_next) checkpoint();
+        }
+    }
+
+    // Expects `other` to continue where this range ends (worker order);
+    // an empty side adopts the other
+    void merge(const ConvergenceTraceAggregator& other) {
+        if (other.total_.count() == 0) return;
+        if (total_.count() == 0) {
+            *this = other;
+            return;
+        }
+        for (const Snapshot& s : other.snapshots_) {
+            WelfordAggregator<> prefix = total_;
+            prefix.merge(s.moments);
+            snapshots_.push_back({s.n, prefix});
+        }
+        total_.merge(other.total_);
+        next_ = other.next_;
+    }
+
+    // Checkpoints reached so far, plus the final state if it is not one
+    std::vector<TracePoint> trace() const {
+        std::vector<TracePoint> out;
+        out.reserve(snapshots_.size() + 1);
+        for (const Snapshot& s : snapshots_) {
+            out.push_back({s.n, s.moments.result(), s.moments.std_error()});
+        }
+        const std::uint64_t end = begin_ + total_.count();
+        if (total_.count() > 0 && (out.empty() || out.back().n != end)) {
+            out.push_back({end, total_.result(), total_.std_error()});
+        }
+        return out;
+    }
+
+    double result() const { return total_.result(); }
+    double variance() const { return total_.variance(); }
+    double std_error() const { return total_.std_error(); }
+
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(first_);
+        w.write(growth_);
+        w.write(begin_);
+        w.write(next_);
+        total_.serialize(w);
+        w.write(snapshots_.size());
+        for (const Snapshot& s : snapshots_) {
+            w.write(s.n);
+            s.moments.serialize(w);
+        }
+    }
+
+    static ConvergenceTraceAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "ConvergenceTraceAggregator");
+        const auto first = r.read<std::uint64_t>();
+        ConvergenceTraceAggregator agg(first, r.read_finite("ConvergenceTraceAggregator"));
+        r.read(agg.begin_);
+        r.read(agg.next_);
+        agg.total_ = WelfordAggregator<>::deserialize(r);
+        const auto n = r.read<std::size_t>();
+        if (n > r.remaining() / 36) throw std::runtime_error("ByteReader: truncated input");
+        agg.snapshots_.resize(n);
+        for (Snapshot& s : agg.snapshots_) {
+            r.read(s.n);
+            s.moments = WelfordAggregator<>::deserialize(r);
+        }
+        return agg;
+    }
+
+    void reset() {
+        total_.reset();
+        snapshots_.clear();
+        begin_ = 0;
+        next_ = first_;
+    }
+
+    std::uint64_t count() const { return total_.count(); }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("CONV");
+
+    struct Snapshot {
+        std::uint64_t n;
+        WelfordAggregator<> moments;  // over trials [begin_, n)
+    };
+
+    std::uint64_t advance(std::uint64_t n) const {
+        const double grown = std::ceil(static_cast<double>(n) * growth_);
+        return std::max<std::uint64_t>(n + 1, static_cast<std::uint64_t>(grown));
+    }
+
+    void checkpoint() {
+        snapshots_.push_back({next_, total_});
+        next_ = advance(next_);
+    }
+
+    std::uint64_t first_;
+    double growth_;
+    std::uint64_t begin_ = 0;
+    std::uint64_t next_;
+    WelfordAggregator<> total_;
+    std::vector<Snapshot> snapshots_;
+};
+
+} // namespace montecarlo
@@ -0,0 +1,221 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "bytes.hpp"
+
+namespace montecarlo {
+
+// Online covariance matrix of a vector-valued trial output. Samples are
+// buffered B at a time; each full block is centred on its own mean and
+// folded in with one rank-B update of the packed upper-triangular
+// co-moment matrix (Chan's merge in matrix form). The block is kept
+// transposed so every co-moment entry is a contiguous dot product over B
+// values, which keeps the d x B working set in cache for d up to a few
+// hundred. Memory: d(d+1)/2 + d*(B+1) doubles.
+class CovarianceAggregator {
+ public:
+    explicit CovarianceAggregator(std::size_t dim = 1, std::size_t block = 64) :
+        dim_(dim), block_(std::max<std::size_t>(block, 1)),
+        mean_(dim, 0.0), comoment_(dim * (dim + 1) / 2, 0.0),
+        block_mean_(dim, 0.0) {
+        buffer_.reserve(dim_ * block_);
+    }
+
+    void add(std::span<const double> x) {
+        if (x.size() != dim_) {
+            throw std::invalid_argument("CovarianceAggregator::add: dimension mismatch");
+        }
+        // Transposed layout: component i of the k-th buffered sample sits at
+        // buffer_[i * block_ + k]
+        if (buffer_.empty()) buffer_.resize(dim_ * block_);
+        for (std::size_t i = 0; i < dim_; ++i) {
+            buffer_[i * block_ + pending_] = x[i];
+        }
+        if (++pending_ == block_) flush();
+    }
+
+    void merge(const CovarianceAggregator& other) {
+        if (other.dim_ != dim_) {
+            throw std::invalid_argument("CovarianceAggregator::merge: dimension mismatch");
+        }
+        fold(other.count_, other.mean_.data(), other.comoment_.data());
+        // Replay anything the other side still had buffered
+        std::vector<double> row(dim_);
+        for (std::size_t k = 0; k < other.pending_; ++k) {
+            for (std::size_t i = 0; i < dim_; ++i) {
+                row[i] = other.buffer_[i * other.block_ + k];
+            }
+            add(row);
+        }
+    }
+
+    std::span<const double> mean() const {
+        flush();
+        return mean_;
+    }
+
+    double mean(std::size_t i) const {
+        flush();
+        return mean_[i];
+    }
+
+    // Sample covariance (n - 1 denominator)
+    double covariance(std::size_t i, std::size_t j) const {
+        flush();
+        if (count_ < 2) return 0.0;
+        return comoment_[packed(i, j)] / static_cast<double>(count_ - 1);
+    }
+
+    double correlation(std::size_t i, std::size_t j) const {
+        double denom = std::sqrt(covariance(i, i) * covariance(j, j));
+        return denom > 0.0 ? covariance(i, j) / denom : 0.0;
+    }
+
+    // Full row-major d x d sample covariance matrix
+    std::vector<double> covariance_matrix() const {
+        std::vector<double> out(dim_ * dim_, 0.0);
+        for (std::size_t i = 0; i < dim_; ++i) {
+            for (std::size_t j = i; j < dim_; ++j) {
+                out[i * dim_ + j] = out[j * dim_ + i] = covariance(i, j);
+            }
+        }
+        return out;
+    }
+
+    std::size_t dim() const { return dim_; }
+
+    // The pending block is folded in first, so only the reduced state is
+    // written
+    void serialize(ByteWriter& w) const {
+        flush();
+        w.tag(kTag);
+        w.write(dim_);
+        w.write(block_);
+        w.write(count_);
+        w.write(mean_);
+        w.write(comoment_);
+    }
+
+    static CovarianceAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "CovarianceAggregator");
+        const auto dim = r.read_in<std::size_t>(0, kMaxConfigSize, "CovarianceAggregator");
+        // The block buffer holds dim * block values
+        const auto block = r.read_in<std::size_t>(0, kMaxConfigSize / std::max<std::size_t>(dim, 1), "CovarianceAggregator");
+        const auto count = r.read<std::uint64_t>();
+        std::vector<double> mean;
+        std::vector<double> comoment;
+        r.read(mean);
+        r.read(comoment);
+        if (mean.size() != dim || comoment.size() != dim * (dim + 1) / 2) {
+            throw std::runtime_error("CovarianceAggregator::deserialize: inconsistent dimension");
+        }
+        CovarianceAggregator agg(dim, block);
+        agg.count_ = count;
+        agg.mean_ = std::move(mean);
+        agg.comoment_ = std::move(comoment);
+        return agg;
+    }
+
+    void reset() {
+        std::fill(mean_.begin(), mean_.end(), 0.0);
+        std::fill(comoment_.begin(), comoment_.end(), 0.0);
+        pending_ = 0;
+        count_ = 0;
+    }
+
+    std::uint64_t count() const { return count_ + pending_; }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("COVM");
+
+    // Row i of the packed upper triangle starts after rows 0..i-1
+    std::size_t packed(std::size_t i, std::size_t j) const {
+        if (i > j) std::swap(i, j);
+        return i * dim_ - i * (i - 1) / 2 + (j - i);
+    }
+
+    static double dot(const double* a, const double* b, std::size_t n) {
+        constexpr std::size_t kLanes = 4;
+        double acc[kLanes] = {};
+        std::size_t k = 0;
+        for (; k + kLanes <= n; k += kLanes) {
+            for (std::size_t l = 0; l < kLanes; ++l) {
+                acc[l] += a[k + l] * b[k + l];
+            }
+        }
+        for (; k < n; ++k) {
+            acc[0] += a[k] * b[k];
+        }
+        return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    }
+
+    // Centre the buffered block on its mean, form its co-moment matrix and
+    // fold it into the running state
+    void flush() const {
+        if (pending_ == 0) return;
+        const std::size_t b = pending_;
+        for (std::size_t i = 0; i < dim_; ++i) {
+            double* col = buffer_.data() + i * block_;
+            double sum = 0.0;
+            for (std::size_t k = 0; k < b; ++k) sum += col[k];
+            block_mean_[i] = sum / static_cast<double>(b);
+            for (std::size_t k = 0; k < b; ++k) col[k] -= block_mean_[i];
+        }
+
+        const double n = static_cast<double>(count_);
+        const double nb = static_cast<double>(b);
+        const double total = n + nb;
+        std::size_t p = 0;
+        for (std::size_t i = 0; i < dim_; ++i) {
+            const double* yi = buffer_.data() + i * block_;
+            const double di = block_mean_[i] - mean_[i];
+            for (std::size_t j = i; j < dim_; ++j, ++p) {
+                const double dj = block_mean_[j] - mean_[j];
+                comoment_[p] += dot(yi, buffer_.data() + j * block_, b) + di * dj * n * nb / total;
+            }
+        }
+        for (std::size_t i = 0; i < dim_; ++i) {
+            mean_[i] += (block_mean_[i] - mean_[i]) * nb / total;
+        }
+        count_ += b;
+        pending_ = 0;
+    }
+
+    // Chan's merge of an already-reduced (count, mean, co-moment) triple
+    void fold(std::uint64_t other_count, const double* other_mean, const double* other_comoment) {
+        if (other_count == 0) return;
+        flush();
+        const double n = static_cast<double>(count_);
+        const double nb = static_cast<double>(other_count);
+        const double total = n + nb;
+        std::size_t p = 0;
+        for (std::size_t i = 0; i < dim_; ++i) {
+            const double di = other_mean[i] - mean_[i];
+            for (std::size_t j = i; j < dim_; ++j, ++p) {
+                const double dj = other_mean[j] - mean_[j];
+                comoment_[p] += other_comoment[p] + di * dj * n * nb / total;
+            }
+        }
+        for (std::size_t i = 0; i < dim_; ++i) {
+            mean_[i] += (other_mean[i] - mean_[i]) * nb / total;
+        }
+        count_ += other_count;
+    }
+
+    std::size_t dim_;
+    std::size_t block_;
+    // Queries fold any pending block first, hence mutable
+    mutable std::vector<double> mean_;
+    mutable std::vector<double> comoment_;
+    mutable std::vector<double> buffer_;
+    mutable std::vector<double> block_mean_;
+    mutable std::size_t pending_ = 0;
+    mutable std::uint64_t count_ = 0;
+};
+
+} // namespace montecarlo
@@ -0,0 +1,267 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "bytes.hpp"
+#include "result.hpp"
+
+namespace montecarlo {
+
+namespace detail {
+
+// In-place iterative radix-2 FFT; a.size() must be a power of two. The
+// inverse is unscaled.
+inline void fft(std::vector<std::complex<double>>& a, bool inverse) {
+    const std::size_t n = a.size();
+    for (std::size_t i = 1, j = 0; i < n; ++i) {
+        std::size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(a[i], a[j]);
+    }
+    for (std::size_t len = 2; len <= n; len <<= 1) {
+        const double angle = (inverse ? 2.0 : -2.0) * std::numbers::pi / static_cast<double>(len);
+        const std::complex<double> step(std::cos(angle), std::sin(angle));
+        for (std::size_t i = 0; i < n; i += len) {
+            std::complex<double> w(1.0, 0.0);
+            for (std::size_t k = 0; k < len / 2; ++k) {
+                const std::complex<double> u = a[i + k];
+                const std::complex<double> v = a[i + k + len / 2] * w;
+                a[i + k] = u + v;
+                a[i + k + len / 2] = u - v;
+                w *= step;
+            }
+        }
+    }
+}
+
+} // namespace detail
+
+// Density and distribution on a fixed grid of `points` equally spaced
+// values g_0 = min ... g_{points-1} = max, kept as two arrays updated in
+// O(1) per value:
+//
+//   - linear binning: a value between g_j and g_{j+1} splits its unit
+//     weight between the two in proportion to proximity, which keeps the
+//     binned KDE accurate to O(h^2) in the grid spacing h;
+//   - counts of values in (g_{j-1}, g_j], whose prefix sums give the ECDF
+//     exactly at the grid points.
+//
+// Both arrays merge by addition. density() convolves the weights with a
+// sampled Gaussian kernel through a zero-padded FFT, so the cost is
+// O(points log points) whatever the number of samples. Values outside
+// [min, max] count towards n but not towards the grid, so the density
+// integrates to the fraction of mass inside the range.
+class DensityAggregator {
+ public:
+    explicit DensityAggregator(std::size_t points = 4096, double min = 0.0, double max = 1.0) :
+        weights_(std::max<std::size_t>(points, 2), 0.0), counts_(weights_.size(), 0), min_(min), max_(max),
+        spacing_((max - min) / static_cast<double>(weights_.size() - 1)), inv_spacing_(1.0 / spacing_) {
+        if (!(max > min)) throw std::invalid_argument("DensityAggregator: max must exceed min");
+    }
+
+    void add(double value) {
+        if (std::isnan(value)) return;
+        moments_.add(value);
+        bin(value);
+    }
+
+    void add_batch(std::span<const double> values) {
+        for (double v : values) {
+            if (!std::isnan(v)) bin(v);
+        }
+        // NaNs are rare enough that a second pass only runs when present
+        if (below_ + above_ + inside_ == moments_.count() + values.size()) {
+            moments_.add_batch(values);
+        } else {
+            for (double v : values) {
+                if (!std::isnan(v)) moments_.add(v);
+            }
+        }
+    }
+
+    void merge(const DensityAggregator& other) {
+        if (other.weights_.size() != weights_.size() || other.min_ != min_ || other.max_ != max_) {
+            throw std::invalid_argument("DensityAggregator::merge: grids differ");
+        }
+        for (std::size_t i = 0; i < weights_.size(); ++i) {
+            weights_[i] += other.weights_[i];
+            counts_[i] += other.counts_[i];
+        }
+        below_ += other.below_;
+        above_ += other.above_;
+        inside_ += other.inside_;
+        moments_.merge(other.moments_);
+    }
+
+    // Grid point g_j
+    double point(std::size_t j) const { return min_ + static_cast<double>(j) * spacing_; }
+
+    std::vector<double> grid() const {
+        std::vector<double> out(weights_.size());
+        for (std::size_t j = 0; j < out.size(); ++j) out[j] = point(j);
+        return out;
+    }
+
+    // Silverman's rule of thumb, 0.9 min(sd, IQR / 1.34) n^(-1/5), with the
+    // IQR read off the grid ECDF; never below half a grid spacing
+    double bandwidth() const {
+        const std::uint64_t n = count();
+        if (n < 2) return spacing_;
+        const std::vector<double> cdf = ecdf();
+        auto grid_quantile = [&](double q) {
+            const auto it = std::lower_bound(cdf.begin(), cdf.end(), q);
+            return point(static_cast<std::size_t>(std::min<std::ptrdiff_t>(it - cdf.begin(),
+                static_cast<std::ptrdiff_t>(cdf.size() - 1))));
+        };
+        const double sd = std::sqrt(moments_.variance());
+        const double iqr = grid_quantile(0.75) - grid_quantile(0.25);
+        double spread = iqr > 0.0 ? std::min(sd, iqr / 1.34) : sd;
+        if (!(spread > 0.0)) spread = spacing_;
+        return std::max(0.9 * spread * std::pow(static_cast<double>(n), -0.2), 0.5 * spacing_);
+    }
+
+    // Gaussian KDE at the grid points; bandwidth <= 0 picks bandwidth()
+    std::vector<double> density(double bandwidth = 0.0) const {
+        const std::size_t m = weights_.size();
+        std::vector<double> out(m, 0.0);
+        if (count() == 0) return out;
+        if (!(bandwidth > 0.0)) bandwidth = this->bandwidth();
+
+        // Kernel support of 4 bandwidths, clipped to the grid
+        const double reach = std::ceil(4.0 * bandwidth * inv_spacing_);
+        const std::size_t support = reach < static_cast<double>(m) ? static_cast<std::size_t>(reach) : m - 1;
+        // Padding to m + support keeps the circular convolution from
+        // wrapping around
+        std::size_t size = 1;
+        while (size < m + support) size <<= 1;
+
+        std::vector<std::complex<double>> data(size);
+        std::vector<std::complex<double>> kernel(size);
+        for (std::size_t j = 0; j < m; ++j) data[j] = weights_[j];
+        const double scale = 1.0 / (static_cast<double>(count()) * bandwidth * std::sqrt(2.0 * std::numbers::pi));
+        for (std::size_t l = 0; l <= support; ++l) {
+            const double z = static_cast<double>(l) * spacing_ / bandwidth;
+            const double k = scale * std::exp(-0.5 * z * z);
+            kernel[l] = k;
+            if (l > 0) kernel[size - l] = k;
+        }
+        detail::fft(data, false);
+        detail::fft(kernel, false);
+        for (std::size_t i = 0; i < size; ++i) data[i] *= kernel[i];
+        detail::fft(data, true);
+        const double inv_size = 1.0 / static_cast<double>(size);
+        for (std::size_t j = 0; j < m; ++j) {
+            out[j] = std::max(0.0, data[j].real() * inv_size);  // clip FFT round-off below zero
+        }
+        return out;
+    }
+
+    // Fraction of values <= g_j, exact up to the rounding of the grid
+    std::vector<double> ecdf() const {
+        std::vector<double> out(counts_.size(), 0.0);
+        const std::uint64_t n = count();
+        if (n == 0) return out;
+        std::uint64_t running = below_;
+        for (std::size_t j = 0; j < counts_.size(); ++j) {
+            running += counts_[j];
+            out[j] = static_cast<double>(running) / static_cast<double>(n);
+        }
+        return out;
+    }
+
+    const std::vector<double>& weights() const { return weights_; }
+
+    double result() const { return moments_.result(); }
+    double variance() const { return moments_.variance(); }
+    double std_error() const { return moments_.std_error(); }
+
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(min_);
+        w.write(max_);
+        w.write(weights_);
+        w.write(counts_);
+        w.write(below_);
+        w.write(above_);
+        w.write(inside_);
+        moments_.serialize(w);
+    }
+
+    static DensityAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "DensityAggregator");
+        const double min = r.read<double>();
+        const double max = r.read<double>();
+        std::vector<double> weights;
+        r.read(weights);
+        // Checked here: the constructor would widen a short grid to two
+        // points and the moved-in weights would not match it
+        if (weights.size() < 2 || !std::isfinite(min) || !std::isfinite(max) || !(max > min)) {
+            throw std::runtime_error("DensityAggregator: invalid grid");
+        }
+        DensityAggregator agg(weights.size(), min, max);
+        agg.weights_ = std::move(weights);
+        r.read(agg.counts_);
+        if (agg.counts_.size() != agg.weights_.size()) {
+            throw std::runtime_error("DensityAggregator: inconsistent grid");
+        }
+        r.read(agg.below_);
+        r.read(agg.above_);
+        r.read(agg.inside_);
+        agg.moments_ = WelfordAggregator<>::deserialize(r);
+        return agg;
+    }
+
+    void reset() {
+        std::fill(weights_.begin(), weights_.end(), 0.0);
+        std::fill(counts_.begin(), counts_.end(), 0);
+        below_ = above_ = inside_ = 0;
+        moments_.reset();
+    }
+
+    // NaNs excluded; values off the grid included
+    std::uint64_t count() const { return moments_.count(); }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("KDEN");
+
+    void bin(double value) {
+        if (value < min_) {
+            ++below_;
+            return;
+        }
+        if (value > max_) {
+            ++above_;
+            return;
+        }
+        ++inside_;
+        const double t = (value - min_) * inv_spacing_;
+        const std::size_t last = weights_.size() - 1;
+        const std::size_t j = std::min(static_cast<std::size_t>(t), last);
+        const double frac = t - static_cast<double>(j);
+        // A value on g_j counts towards F(g_j); one just above it towards
+        // F(g_{j+1})
+        if (j < last) {
+            weights_[j] += 1.0 - frac;
+            weights_[j + 1] += frac;
+            ++counts_[frac > 0.0 ? j + 1 : j];
+        } else {
+            weights_[last] += 1.0;
+            ++counts_[last];
+        }
+    }
+
+    std::vector<double> weights_;
+    std::vector<std::uint64_t> counts_;
+    double min_, max_, spacing_, inv_spacing_;
+    std::uint64_t below_ = 0, above_ = 0, inside_ = 0;
+    WelfordAggregator<> moments_;
+};
+
+} // namespace montecarlo
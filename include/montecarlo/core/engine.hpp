@@ -1,9 +1,29 @@
 #pragma once
 #include "concepts.hpp"
 #include "result.hpp"
+#include "quantile.hpp"
+#include "log_histogram.hpp"
+#include "moments.hpp"
+#include "covariance.hpp"
+#include "tail.hpp"
+#include "tuple.hpp"
+#include "batch_means.hpp"
+#include "reproducible.hpp"
+#include "reservoir.hpp"
+#include "grouped.hpp"
+#include "convergence.hpp"
+#include "exact_quantile.hpp"
+#include "density.hpp"
+#include "sparse_histogram.hpp"
+#include "sample_sink.hpp"
+#include "report.hpp"
+#include "bootstrap.hpp"
 #include "rng.hpp"
 #include "transform.hpp"
 #include "../execution/sequential.hpp"
+#include "../execution/checkpoint.hpp"
+#include "../io/result_cache.hpp"
+#include "config_hash.hpp"
 #ifdef MCLIB_PARALLEL_ENABLED
 #include "../execution/parallel.hpp"
 #endif
@@ -12,6 +32,7 @@
 #endif
 #include <memory>
 #include <chrono>
+#include <typeinfo>
 
 namespace montecarlo {
 
@@ -65,21 +86,186 @@ class SimulationEngine {
      * @return Result containing estimate, variance, std error, and timing
      */
     Result run(std::uint64_t iterations) const {
+        Aggregator agg;
+        return run(iterations, agg);
+    }
+
+    /**
+     * @brief Run the simulation into a caller-supplied aggregator
+     *
+     * The aggregator is reset first but keeps its configuration (bins,
+     * compression, ...), and can be queried afterwards for statistics
+     * beyond what Result carries.
+     *
+     * @param iterations Number of trials to execute
+     * @param agg Aggregator that receives every trial result
+     * @return Result containing estimate, variance, std error, and timing
+     */
+    Result run(std::uint64_t iterations, Aggregator& agg) const {
         auto start = std::chrono::steady_clock::now();
 
-        Aggregator agg;
+        agg.reset();
 
-        // Create wrapped model that applies transform
-        auto wrapped_model = [this](auto& rng) {
-            double raw_result = invoke_model(rng);
-            return transform_(raw_result);
-        };
+        // Policies that time their workers report where the run went
+        RunStats stats;
+        if constexpr (requires { policy_.run(wrapped_model(), agg, iterations, base_seed_, rng_factory_, &stats); }) {
+            policy_.run(wrapped_model(), agg, iterations, base_seed_, rng_factory_, &stats);
+        } else {
+            policy_.run(wrapped_model(), agg, iterations, base_seed_, rng_factory_);
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        return construct_result(agg, iterations, start, end, std::move(stats));
+    }
+
+    /**
+     * @brief Run the simulation with periodic checkpoints
+     *
+     * Every checkpoint.interval trials (more once the aggregator state is
+     * large, see below) each worker snapshots its aggregator and generator
+     * state; a background thread keeps the latest snapshots
+     * in checkpoint.path. If the process dies, resume() continues from the
+     * file to the same Result as this run would have produced. Streams are
+     * laid out as by the Sequential or Parallel policy, so the Result also
+     * matches run(). The file is left holding the finished state.
+     *
+     * Aggregators whose copies share state (SharedHistogramAggregator,
+     * SampleSinkAggregator) cannot be restored per worker and should only
+     * be checkpointed with one worker.
+     *
+     * Each snapshot serialises the aggregator on its worker thread; only
+     * the file write is asynchronous. Slices stretch with the snapshot
+     * size (see CheckpointOptions::interval), so aggregators that keep
+     * every sample still cost O(N) in total rather than O(N^2 / interval).
+     *
+     * @param iterations Number of trials to execute
+     * @param agg Aggregator that receives every trial result
+     * @param checkpoint Checkpoint file and snapshot interval
+     * @return Result containing estimate, variance, std error, and timing
+     */
+    Result run(std::uint64_t iterations, Aggregator& agg, const execution::CheckpointOptions& checkpoint) const {
+        auto start = std::chrono::steady_clock::now();
+        RunStats stats;
+        execution::detail::run_checkpointed(wrapped_model(), agg, iterations, base_seed_, workers(),
+            rng_factory_, checkpoint, nullptr, &stats);
+        auto end = std::chrono::steady_clock::now();
+        return construct_result(agg, iterations, start, end, std::move(stats));
+    }
 
-        policy_.run(wrapped_model, agg, iterations, base_seed_, rng_factory_);
+    Result run(std::uint64_t iterations, const execution::CheckpointOptions& checkpoint) const {
+        Aggregator agg;
+        return run(iterations, agg, checkpoint);
+    }
 
+    /**
+     * @brief Continue a checkpointed run from checkpoint.path
+     *
+     * The engine must be built like the one that wrote the checkpoint (same
+     * model, policy thread count and aggregator type); seed, trial count
+     * and aggregator configuration come from the file. Checkpoints keep
+     * being written to the same path. Timings and per-worker stats cover
+     * this call only.
+     *
+     * @param checkpoint Checkpoint file and snapshot interval
+     * @param agg Receives the restored and completed aggregator
+     * @return The Result of the whole run
+     */
+    Result resume(const execution::CheckpointOptions& checkpoint, Aggregator& agg) const {
+        auto start = std::chrono::steady_clock::now();
+        const io::Checkpoint saved = io::Checkpoint::load(checkpoint.path);
+        RunStats stats;
+        execution::detail::run_checkpointed(wrapped_model(), agg, saved.iterations, saved.seed, workers(),
+            rng_factory_, checkpoint, &saved, &stats);
         auto end = std::chrono::steady_clock::now();
+        return construct_result(agg, saved.iterations, start, end, std::move(stats));
+    }
+
+    Result resume(const execution::CheckpointOptions& checkpoint) const {
+        Aggregator agg;
+        return resume(checkpoint, agg);
+    }
+
+    /**
+     * @brief Run through a persistent result cache
+     *
+     * The run is looked up by cache_key(); on a hit the stored Result is
+     * returned as it was recorded (including its timings) and nothing is
+     * simulated. The model, transform and RNG factory must provide
+     * config_hash() (see ConfigHasher); the library's transforms and
+     * DefaultRngFactory do. A model without one does not compile here:
+     * nothing else would change its key when its code changes.
+     *
+     * @param iterations Number of trials to execute
+     * @param cache Cache directory shared by runs and processes
+     * @return Result of this configuration, computed or cached
+     */
+    Result run(std::uint64_t iterations, io::ResultCache& cache) const
+        requires CacheKeyable<Model> && CacheKeyable<Transform> && CacheKeyable<RngFactory> {
+        Aggregator agg;
+        const CacheKey key = cache_key(iterations, agg);
+        if (auto hit = cache.find(key)) return hit->result;
+        Result r = run(iterations, agg);
+        cache.store(key, r);
+        return r;
+    }
 
-        return construct_result(agg, iterations, start, end);
+    /**
+     * @brief Run through a persistent result cache, restoring the aggregator
+     *
+     * Like run(iterations, cache), but the cache entry also holds the final
+     * aggregator state, and a hit deserialises it into agg.
+     */
+    Result run(std::uint64_t iterations, Aggregator& agg, io::ResultCache& cache) const
+        requires CacheKeyable<Model> && CacheKeyable<Transform> && CacheKeyable<RngFactory> {
+        agg.reset();
+        const CacheKey key = cache_key(iterations, agg);
+        if (auto hit = cache.find(key); hit && !hit->state.empty()) {
+            agg = from_bytes<Aggregator>(hit->state);
+            return hit->result;
+        }
+        Result r = run(iterations, agg);
+        cache.store(key, r, to_bytes(agg));
+        return r;
+    }
+
+    /**
+     * @brief Stable key of a run: model, transform, RNG factory, policy
+     *        (and thread count), aggregator type and configuration, seed
+     *        and iteration count
+     *
+     * @param iterations Number of trials
+     * @param agg Aggregator in its reset state; its serialised state stands
+     *        for its configuration
+     */
+    CacheKey cache_key(std::uint64_t iterations, const Aggregator& agg) const
+        requires CacheKeyable<Model> && CacheKeyable<Transform> && CacheKeyable<RngFactory> {
+        ConfigHasher h;
+        h.add("montecarlo::SimulationEngine/1");
+        h.add(detail::config_hash(model_));
+        h.add(detail::config_hash(transform_));
+        h.add(detail::config_hash(rng_factory_));
+        h.add(policy_hash());
+        h.add(typeid(Aggregator).name());
+        const std::vector<std::byte> state = to_bytes(agg);
+        h.add(std::span<const std::byte>(state));
+        h.add(base_seed_);
+        h.add(iterations);
+        return h.key();
+    }
+
+    /**
+     * @brief Run the simulation and return the aggregator with the result
+     *
+     * @param iterations Number of trials to execute
+     * @param agg Configured aggregator to run into (copied)
+     * @return Result fields plus the filled aggregator; for a
+     *         TupleAggregator, get<I>() returns the typed member
+     */
+    AggregateResult<Aggregator> run_aggregate(std::uint64_t iterations, Aggregator agg = Aggregator{}) const {
+        AggregateResult<Aggregator> out{Result{}, std::move(agg)};
+        static_cast<Result&>(out) = run(iterations, out.aggregator);
+        return out;
     }
 
     /**
@@ -120,10 +306,54 @@ class SimulationEngine {
     }
 
  private:
+    /**
+     * @brief Model wrapper that applies the transform
+     *
+     * Scalar outputs go through the transform; structured outputs
+     * (vectors, keyed values) reach the aggregator unchanged
+     */
+    auto wrapped_model() const {
+        return [this](auto& rng) {
+            auto raw_result = invoke_model(rng);
+            if constexpr (std::convertible_to<decltype(raw_result), double>) {
+                return transform_(static_cast<double>(raw_result));
+            } else {
+                return raw_result;
+            }
+        };
+    }
+
+    /**
+     * @brief Streams the policy splits a run into
+     */
+    std::size_t workers() const {
+        static_assert(std::same_as<ExecutionPolicy, execution::Sequential> ||
+                      requires(const ExecutionPolicy& p) { { p.threads() } -> std::convertible_to<std::size_t>; },
+                      "Checkpointing supports the Sequential and Parallel policies");
+        if constexpr (requires { policy_.threads(); }) {
+            return policy_.threads();
+        } else {
+            return 1;
+        }
+    }
+
+    /**
+     * @brief Policy part of cache_key(): results depend on the thread count
+     */
+    std::uint64_t policy_hash() const {
+        if constexpr (std::same_as<ExecutionPolicy, execution::Sequential>) {
+            return ConfigHasher{}.add("execution::Sequential").value();
+        } else if constexpr (requires { policy_.threads(); }) {
+            return ConfigHasher{}.add("execution::Parallel").add(policy_.threads()).value();
+        } else {
+            return detail::config_hash(policy_);
+        }
+    }
+
     /**
      * @brief Invoke model (handles both .trial() and operator() styles)
      */
-    double invoke_model(auto& rng) const {
+    auto invoke_model(auto& rng) const {
         // Works with both trial and call styles
         if constexpr (requires { model_.trial(rng); }) {
             return model_.trial(rng);
@@ -138,14 +368,26 @@ class SimulationEngine {
     Result construct_result(
         const Aggregator& agg, std::uint64_t iterations,
         const std::chrono::steady_clock::time_point& start,
-        const std::chrono::steady_clock::time_point& end) const {
+        const std::chrono::steady_clock::time_point& end,
+        RunStats stats = {}) const {
         // Collect stats into the result struct
         Result r;
         r.iterations = iterations;
-        r.estimate = agg.result();
-        r.variance = agg.variance();
-        r.standard_error = agg.std_error();
+        // Not every aggregator has a scalar estimate (e.g. covariance) or
+        // tracks dispersion (e.g. histograms, sketches)
+        if constexpr (requires { { agg.result() } -> std::convertible_to<double>; }) {
+            r.estimate = agg.result();
+        }
+        if constexpr (requires { agg.variance(); }) {
+            r.variance = agg.variance();
+        }
+        if constexpr (requires { agg.std_error(); }) {
+            r.standard_error = agg.std_error();
+        }
         r.elapsed_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        r.setup_ms = stats.setup_ms;
+        r.merge_ms = stats.merge_ms;
+        r.workers = std::move(stats.workers);
         return r;
     }
 
@@ -0,0 +1,369 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../io/mapped_file.hpp"
+#include "bytes.hpp"
+
+namespace montecarlo {
+
+namespace detail {
+
+// Run fn(0..workers-1), on threads when parallel execution is enabled
+template<typename F>
+void for_each_worker(std::size_t workers, F&& fn) {
+#ifdef MCLIB_PARALLEL_ENABLED
+    if (workers > 1) {
+        std::vector<std::thread> threads;
+        threads.reserve(workers - 1);
+        for (std::size_t t = 1; t < workers; ++t) {
+            threads.emplace_back([&fn, t] { fn(t); });
+        }
+        fn(0);
+        for (auto& thread : threads) thread.join();
+        return;
+    }
+#endif
+    for (std::size_t t = 0; t < workers; ++t) fn(t);
+}
+
+} // namespace detail
+
+// Exact order statistics for reports that do not accept sketches.
+//
+// Samples are appended to chunked buffers; a full chunk can be spilled to
+// an unlinked memory-mapped temporary file so that resident memory stays
+// bounded. merge() shares the other side's chunks instead of copying them,
+// and a chunk is never appended to once it is shared.
+//
+// quantiles() avoids a full sort with a parallel multi-selection. Splitters
+// from a regular sample cut the data into buckets (sample-sort
+// partitioning), one counting pass locates the bucket holding each
+// requested rank, only those buckets are gathered, and nth_element runs
+// within each of them. Values equal to a splitter are only counted, so an
+// atom heavy enough to become one (e.g. the zero payoffs of an OTM option)
+// is never copied into memory. Quantiles use linear interpolation between
+// order statistics (type 7, as R and NumPy default to).
+class ExactQuantileAggregator {
+ public:
+    // threads = 0 uses every hardware thread for the selection; an empty
+    // spill_directory keeps all chunks in memory
+    explicit ExactQuantileAggregator(std::size_t threads = 0, std::string spill_directory = {},
+                                     std::size_t chunk_values = std::size_t{1} << 20) :
+        threads_(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency())),
+        spill_directory_(std::move(spill_directory)),
+        chunk_values_(std::max<std::size_t>(chunk_values, 1)) {}
+
+    void add(double value) {
+        add_batch(std::span<const double>(&value, 1));
+    }
+
+    // NaNs have no rank and are dropped
+    void add_batch(std::span<const double> values) {
+        while (!values.empty()) {
+            std::vector<double>& buffer = writable();
+            const std::size_t n = std::min(values.size(), chunk_values_ - buffer.size());
+            const std::size_t before = buffer.size();
+            for (double v : values.first(n)) {
+                if (!std::isnan(v)) buffer.push_back(v);
+            }
+            count_ += buffer.size() - before;
+            values = values.subspan(n);
+            if (buffer.size() == chunk_values_) seal();
+        }
+    }
+
+    void merge(const ExactQuantileAggregator& other) {
+        for (const auto& chunk : other.chunks_) {
+            if (!chunk->data().empty()) chunks_.push_back(chunk);
+        }
+        count_ += other.count_;
+    }
+
+    double quantile(double q) const {
+        return quantiles(std::span<const double>(&q, 1)).front();
+    }
+
+    std::vector<double> quantiles(std::span<const double> qs) const {
+        std::vector<double> out(qs.size(), 0.0);
+        if (count_ == 0) return out;
+        // Ranks either side of each interpolation point
+        std::vector<std::uint64_t> ranks;
+        std::vector<double> positions(qs.size());
+        for (std::size_t i = 0; i < qs.size(); ++i) {
+            positions[i] = std::clamp(qs[i], 0.0, 1.0) * static_cast<double>(count_ - 1);
+            const auto lo = static_cast<std::uint64_t>(positions[i]);
+            ranks.push_back(lo);
+            ranks.push_back(std::min(lo + 1, count_ - 1));
+        }
+        std::sort(ranks.begin(), ranks.end());
+        ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+        const std::vector<double> values = select(ranks);
+        auto value_at = [&](std::uint64_t rank) {
+            return values[static_cast<std::size_t>(std::lower_bound(ranks.begin(), ranks.end(), rank) - ranks.begin())];
+        };
+        for (std::size_t i = 0; i < qs.size(); ++i) {
+            const auto lo = static_cast<std::uint64_t>(positions[i]);
+            const double a = value_at(lo);
+            const double b = value_at(std::min(lo + 1, count_ - 1));
+            // Equal ends short-circuit so infinities do not turn into NaN
+            out[i] = a == b ? a : a + (positions[i] - static_cast<double>(lo)) * (b - a);
+        }
+        return out;
+    }
+
+    // Median
+    double result() const { return quantile(0.5); }
+
+    std::size_t spilled_chunks() const {
+        std::size_t n = 0;
+        for (const auto& chunk : chunks_) n += chunk->spilled.size() > 0 ? 1 : 0;
+        return n;
+    }
+
+    // All samples are written; a restored aggregator keeps them in memory
+    // until its own chunks fill
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(threads_);
+        w.write(spill_directory_);
+        w.write(chunk_values_);
+        w.write(count_);
+        for (const auto& chunk : chunks_) {
+            for (double v : chunk->data()) w.write(v);
+        }
+    }
+
+    static ExactQuantileAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "ExactQuantileAggregator");
+        const auto threads = r.read<std::size_t>();
+        std::string directory;
+        r.read(directory);
+        ExactQuantileAggregator agg(threads, std::move(directory), r.read<std::size_t>());
+        const auto n = r.read<std::uint64_t>();
+        if (n > r.remaining() / 8) throw std::runtime_error("ByteReader: truncated input");
+        std::vector<double> block;
+        for (std::uint64_t done = 0; done < n;) {
+            block.resize(static_cast<std::size_t>(std::min<std::uint64_t>(n - done, agg.chunk_values_)));
+            for (double& v : block) r.read(v);
+            agg.add_batch(block);
+            done += block.size();
+        }
+        return agg;
+    }
+
+    void reset() {
+        chunks_.clear();
+        count_ = 0;
+    }
+
+    std::uint64_t count() const { return count_; }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("EXQT");
+    static constexpr std::size_t kBuckets = 256;
+    static constexpr std::size_t kOversample = 32;
+
+    struct Chunk {
+        std::vector<double> values;
+        io::MappedFile spilled;
+
+        std::span<const double> data() const {
+            return spilled.size() > 0 ? spilled.as<double>() : std::span<const double>(values);
+        }
+    };
+
+    // The open chunk, replaced if it is full, spilled or shared with a
+    // merged aggregator
+    std::vector<double>& writable() {
+        if (chunks_.empty() || chunks_.back().use_count() > 1 || chunks_.back()->spilled.size() > 0 ||
+            chunks_.back()->values.size() >= chunk_values_) {
+            chunks_.push_back(std::make_shared<Chunk>());
+            chunks_.back()->values.reserve(std::min<std::size_t>(chunk_values_, 4096));
+        }
+        return chunks_.back()->values;
+    }
+
+    void seal() {
+        Chunk& chunk = *chunks_.back();
+        if (spill_directory_.empty()) return;
+        chunk.spilled = io::MappedFile::spill(spill_directory_, std::as_bytes(std::span<const double>(chunk.values)));
+        std::vector<double>().swap(chunk.values);
+    }
+
+    // Cut the concatenated chunks into `parts` contiguous runs of spans
+    std::vector<std::vector<std::span<const double>>> split(std::size_t parts) const {
+        std::vector<std::vector<std::span<const double>>> out(parts);
+        const std::uint64_t per = (count_ + parts - 1) / parts;
+        std::size_t part = 0;
+        std::uint64_t filled = 0;
+        for (const auto& chunk : chunks_) {
+            std::span<const double> rest = chunk->data();
+            while (!rest.empty()) {
+                const std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(rest.size(), per - filled));
+                out[part].push_back(rest.first(n));
+                rest = rest.subspan(n);
+                filled += n;
+                if (filled == per && part + 1 < parts) {
+                    ++part;
+                    filled = 0;
+                }
+            }
+        }
+        return out;
+    }
+
+    // Regularly spaced sample of the data, sorted, thinned to bucket
+    // boundaries
+    std::vector<double> splitters() const {
+        const std::uint64_t samples = std::min<std::uint64_t>(count_, kBuckets * kOversample);
+        const std::uint64_t stride = count_ / samples;
+        std::vector<double> sample;
+        sample.reserve(static_cast<std::size_t>(samples));
+        std::uint64_t next = stride / 2;
+        std::uint64_t base = 0;
+        for (const auto& chunk : chunks_) {
+            std::span<const double> data = chunk->data();
+            while (next < base + data.size() && sample.size() < samples) {
+                sample.push_back(data[static_cast<std::size_t>(next - base)]);
+                next += stride;
+            }
+            base += data.size();
+        }
+        std::sort(sample.begin(), sample.end());
+        std::vector<double> cuts;
+        for (std::size_t b = 1; b < kBuckets; ++b) {
+            cuts.push_back(sample[b * sample.size() / kBuckets]);
+        }
+        cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+        return cuts;
+    }
+
+    // Values at the given ascending ranks
+    std::vector<double> select(const std::vector<std::uint64_t>& ranks) const {
+        const std::size_t workers = static_cast<std::size_t>(
+            std::min<std::uint64_t>(threads_, std::max<std::uint64_t>(1, count_ / 65536)));
+        const auto parts = split(workers);
+        const std::vector<double> cuts = splitters();
+        const std::size_t buckets = cuts.size() + 1;
+        // Branch-free upper_bound over the cuts padded with +inf to
+        // kBuckets - 1 entries; +inf itself is clamped into the last bucket
+        std::vector<double> padded(kBuckets - 1, std::numeric_limits<double>::infinity());
+        std::copy(cuts.begin(), cuts.end(), padded.begin());
+        auto bucket_of = [&padded, last = cuts.size()](double v) {
+            std::size_t idx = 0;
+            for (std::size_t step = kBuckets / 2; step > 0; step /= 2) {
+                idx += padded[idx + step - 1] <= v ? step : 0;
+            }
+            return std::min(idx, last);
+        };
+
+        // Pass 1: per-worker counts. Values equal to a cut are counted on
+        // their own, so a rank inside a run of ties (a cut, by construction
+        // of the splitters) is answered without gathering the run. Category
+        // 2b holds bucket b without its lower cut, category 2b - 1 the
+        // values equal to cuts[b - 1].
+        const std::size_t categories = 2 * buckets - 1;
+        auto category_of = [&](double v) {
+            const std::size_t b = bucket_of(v);
+            return 2 * b - (b > 0 && v == cuts[b - 1] ? 1 : 0);
+        };
+        std::vector<std::vector<std::uint64_t>> counts(workers, std::vector<std::uint64_t>(categories, 0));
+        detail::for_each_worker(workers, [&](std::size_t t) {
+            for (std::span<const double> run : parts[t]) {
+                for (double v : run) ++counts[t][category_of(v)];
+            }
+        });
+        std::vector<std::uint64_t> start(categories + 1, 0);
+        for (std::size_t c = 0; c < categories; ++c) {
+            start[c + 1] = start[c];
+            for (std::size_t t = 0; t < workers; ++t) start[c + 1] += counts[t][c];
+        }
+
+        // Ranks that fall on a cut are known now; the buckets holding the
+        // others are gathered, each worker writing at its own offset
+        std::vector<double> out(ranks.size());
+        std::vector<std::size_t> slot(categories, kNone);
+        std::vector<std::size_t> wanted;
+        for (std::size_t i = 0; i < ranks.size(); ++i) {
+            const std::size_t c = static_cast<std::size_t>(
+                std::upper_bound(start.begin(), start.end(), ranks[i]) - start.begin()) - 1;
+            if (c % 2 == 1) {
+                out[i] = cuts[c / 2];
+            } else if (slot[c] == kNone) {
+                slot[c] = wanted.size();
+                wanted.push_back(c);
+            }
+        }
+        std::vector<std::vector<double>> gathered(wanted.size());
+        std::vector<std::vector<std::uint64_t>> offset(workers, std::vector<std::uint64_t>(wanted.size(), 0));
+        for (std::size_t w = 0; w < wanted.size(); ++w) {
+            gathered[w].resize(static_cast<std::size_t>(start[wanted[w] + 1] - start[wanted[w]]));
+            std::uint64_t at = 0;
+            for (std::size_t t = 0; t < workers; ++t) {
+                offset[t][w] = at;
+                at += counts[t][wanted[w]];
+            }
+        }
+
+        // Pass 2: gather the wanted buckets into disjoint regions. Only a
+        // few buckets are wanted, so test their open value ranges directly;
+        // the first and last buckets are unbounded below and above
+        std::vector<double> lower(wanted.size());
+        std::vector<double> upper(wanted.size());
+        for (std::size_t w = 0; w < wanted.size(); ++w) {
+            const std::size_t bucket = wanted[w] / 2;
+            lower[w] = bucket == 0 ? std::numeric_limits<double>::quiet_NaN() : cuts[bucket - 1];
+            upper[w] = bucket == cuts.size() ? std::numeric_limits<double>::quiet_NaN() : cuts[bucket];
+        }
+        detail::for_each_worker(workers, [&](std::size_t t) {
+            std::vector<std::uint64_t> at = offset[t];
+            for (std::span<const double> run : parts[t]) {
+                for (double v : run) {
+                    for (std::size_t w = 0; w < wanted.size(); ++w) {
+                        if ((v > lower[w] || std::isnan(lower[w])) && (v < upper[w] || std::isnan(upper[w]))) {
+                            gathered[w][static_cast<std::size_t>(at[w]++)] = v;
+                            break;
+                        }
+                    }
+                }
+            }
+        });
+
+        // Pass 3: successive nth_element within each wanted bucket
+        detail::for_each_worker(std::min(workers, wanted.size()), [&](std::size_t t) {
+            for (std::size_t w = t; w < wanted.size(); w += std::min(workers, wanted.size())) {
+                const std::uint64_t base = start[wanted[w]];
+                std::vector<double>& values = gathered[w];
+                auto first = values.begin();
+                for (std::size_t i = 0; i < ranks.size(); ++i) {
+                    if (ranks[i] < base || ranks[i] >= base + values.size()) continue;
+                    auto nth = values.begin() + static_cast<std::ptrdiff_t>(ranks[i] - base);
+                    std::nth_element(first, nth, values.end());
+                    out[i] = *nth;
+                    first = nth;
+                }
+            }
+        });
+        return out;
+    }
+
+    static constexpr std::size_t kNone = static_cast<std::size_t>(-1);
+
+    std::size_t threads_;
+    std::string spill_directory_;
+    std::size_t chunk_values_;
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    std::uint64_t count_ = 0;
+};
+
+} // namespace montecarlo
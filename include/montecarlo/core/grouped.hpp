@@ -0,0 +1,225 @@
+#pragma once
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "concepts.hpp"
+#include "result.hpp"
+#include "rng.hpp"
+
+namespace montecarlo {
+
+// Per-group statistics from one run. The model returns (key, value) as a
+// std::pair and every key gets its own copy of the inner aggregator,
+// cloned from the prototype, so e.g. per-sector means or per-counterparty
+// histograms come out of a single simulation. merge() merges group-wise.
+//
+// Integer keys below `dense_keys` index a direct array; all other keys go
+// through an open-addressing (linear probing) table of 32-bit entry
+// indices over a contiguous entry vector. Once every key has been seen the
+// hot path is a probe plus the inner add(), with no allocation.
+template<typename Inner = WelfordAggregator<>, typename Key = std::uint64_t>
+class GroupedAggregator {
+ public:
+    explicit GroupedAggregator(std::size_t dense_keys = 0, Inner prototype = Inner{}) :
+        prototype_(std::move(prototype)) {
+        if constexpr (std::integral<Key>) {
+            dense_.assign(dense_keys, prototype_);
+            dense_seen_.assign(dense_keys, 0);
+        }
+    }
+
+    template<typename V>
+    void add(const Key& key, const V& value) {
+        group(key).add(value);
+        ++count_;
+    }
+
+    template<typename K, typename V>
+        requires std::convertible_to<const K&, Key>
+    void add(const std::pair<K, V>& key_value) {
+        add(key_value.first, key_value.second);
+    }
+
+    void merge(const GroupedAggregator& other) {
+        if constexpr (std::integral<Key>) {
+            for (std::size_t k = 0; k < other.dense_.size(); ++k) {
+                if (other.dense_seen_[k]) group(static_cast<Key>(k)).merge(other.dense_[k]);
+            }
+        }
+        for (const auto& [key, inner] : other.entries_) {
+            group(key).merge(inner);
+        }
+        count_ += other.count_;
+    }
+
+    // Forwarded to every group and to the prototype that later groups are
+    // cloned from. Positions a stream-aware inner derives from the context
+    // (e.g. MomentsAggregator::argmax()) then start at the worker's first
+    // trial and count the trials of that group only.
+    void begin_stream(const StreamContext& ctx)
+        requires StreamAwareAggregator<Inner> {
+        prototype_.begin_stream(ctx);
+        for (Inner& inner : dense_) inner.begin_stream(ctx);
+        for (auto& [key, inner] : entries_) inner.begin_stream(ctx);
+    }
+
+    // Inner aggregator for `key`, or nullptr if the key never occurred
+    const Inner* find(const Key& key) const {
+        if (const std::size_t d = dense_index(key); d != kNotDense) {
+            return dense_seen_[d] ? &dense_[d] : nullptr;
+        }
+        if (table_.empty()) return nullptr;
+        for (std::size_t i = hash(key) & mask_;; i = (i + 1) & mask_) {
+            const std::uint32_t e = table_[i];
+            if (e == 0) return nullptr;
+            if (entries_[e - 1].first == key) return &entries_[e - 1].second;
+        }
+    }
+
+    const Inner& at(const Key& key) const {
+        const Inner* inner = find(key);
+        if (inner == nullptr) throw std::out_of_range("GroupedAggregator::at: unknown key");
+        return *inner;
+    }
+
+    // Visit (key, inner) for every group: dense keys in ascending order,
+    // then the others in first-seen order
+    template<typename F>
+    void for_each(F&& f) const {
+        if constexpr (std::integral<Key>) {
+            for (std::size_t k = 0; k < dense_.size(); ++k) {
+                if (dense_seen_[k]) f(static_cast<Key>(k), dense_[k]);
+            }
+        }
+        for (const auto& [key, inner] : entries_) {
+            f(key, inner);
+        }
+    }
+
+    // Number of distinct keys seen
+    std::size_t groups() const {
+        std::size_t n = entries_.size();
+        for (std::uint8_t seen : dense_seen_) n += seen;
+        return n;
+    }
+
+    // Keys are written as integers or strings; only seen groups are stored
+    void serialize(ByteWriter& w) const
+        requires MergeableAggregator<Inner> {
+        w.tag(kTag);
+        prototype_.serialize(w);
+        w.write(dense_.size());
+        w.write(groups());
+        for_each([&](const Key& key, const Inner& inner) {
+            w.write(key);
+            inner.serialize(w);
+        });
+        w.write(count_);
+    }
+
+    static GroupedAggregator deserialize(ByteReader& r)
+        requires MergeableAggregator<Inner> {
+        r.expect_tag(kTag, "GroupedAggregator");
+        const std::size_t before = r.remaining();
+        Inner prototype = Inner::deserialize(r);
+        // Every dense key holds a copy of the prototype; its serialised size
+        // in 8-byte words stands in for its footprint
+        const std::size_t words = std::max<std::size_t>((before - r.remaining()) / 8, 1);
+        const auto dense_keys = r.read_in<std::size_t>(0, kMaxConfigSize / words, "GroupedAggregator");
+        GroupedAggregator agg(dense_keys, std::move(prototype));
+        const auto groups = r.read<std::size_t>();
+        for (std::size_t g = 0; g < groups; ++g) {
+            Key key{};
+            r.read(key);
+            agg.group(key) = Inner::deserialize(r);
+        }
+        r.read(agg.count_);
+        return agg;
+    }
+
+    void reset() {
+        for (std::size_t k = 0; k < dense_.size(); ++k) {
+            if (dense_seen_[k]) dense_[k] = prototype_;
+            dense_seen_[k] = 0;
+        }
+        entries_.clear();
+        std::fill(table_.begin(), table_.end(), 0u);
+        count_ = 0;
+    }
+
+    std::uint64_t count() const { return count_; }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("GRPD");
+    static constexpr std::size_t kNotDense = static_cast<std::size_t>(-1);
+
+    std::size_t dense_index(const Key& key) const {
+        if constexpr (std::integral<Key>) {
+            if constexpr (std::is_signed_v<Key>) {
+                if (key < 0) return kNotDense;
+            }
+            if (static_cast<std::uint64_t>(key) < dense_.size()) return static_cast<std::size_t>(key);
+        }
+        return kNotDense;
+    }
+
+    // splitmix64 finaliser, so sequential integer keys spread over the table
+    static std::size_t hash(const Key& key) {
+        std::uint64_t h;
+        if constexpr (std::integral<Key>) {
+            h = static_cast<std::uint64_t>(key);
+        } else {
+            h = static_cast<std::uint64_t>(std::hash<Key>{}(key));
+        }
+        return static_cast<std::size_t>(detail::splitmix64(h));
+    }
+
+    Inner& group(const Key& key) {
+        if (const std::size_t d = dense_index(key); d != kNotDense) {
+            dense_seen_[d] = 1;
+            return dense_[d];
+        }
+        if (table_.empty()) rehash(16);
+        std::size_t i = hash(key) & mask_;
+        for (;; i = (i + 1) & mask_) {
+            const std::uint32_t e = table_[i];
+            if (e == 0) break;
+            if (entries_[e - 1].first == key) return entries_[e - 1].second;
+        }
+        // New key; keep the load factor at or below one half
+        if (2 * (entries_.size() + 1) > table_.size()) {
+            rehash(2 * table_.size());
+            i = hash(key) & mask_;
+            while (table_[i] != 0) i = (i + 1) & mask_;
+        }
+        entries_.emplace_back(key, prototype_);
+        table_[i] = static_cast<std::uint32_t>(entries_.size());
+        return entries_.back().second;
+    }
+
+    void rehash(std::size_t capacity) {
+        table_.assign(capacity, 0u);
+        mask_ = capacity - 1;
+        for (std::size_t e = 0; e < entries_.size(); ++e) {
+            std::size_t i = hash(entries_[e].first) & mask_;
+            while (table_[i] != 0) i = (i + 1) & mask_;
+            table_[i] = static_cast<std::uint32_t>(e + 1);
+        }
+    }
+
+    Inner prototype_;
+    std::vector<Inner> dense_;
+    std::vector<std::uint8_t> dense_seen_;
+    std::vector<std::pair<Key, Inner>> entries_;
+    std::vector<std::uint32_t> table_;  // 1-based entry index, 0 = empty
+    std::size_t mask_ = 0;
+    std::uint64_t count_ = 0;
+};
+
+} // namespace montecarlo
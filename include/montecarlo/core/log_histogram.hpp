@@ -0,0 +1,298 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "bytes.hpp"
+
+namespace montecarlo {
+
+// HDR-style histogram with logarithmic sub-bucketing. A bucket index is
+// simply the top (exponent + sub_bucket_bits) bits of |x|'s IEEE-754
+// pattern, so add() is a shift with no log() and no range to configure.
+// Every bucket spans at most a 2^-sub_bucket_bits relative width; the
+// positive and negative halves grow their dense count arrays on demand and
+// zeros are counted separately.
+class LogHistogramAggregator {
+ public:
+    // 7 bits gives <0.4% relative error on reported values
+    explicit LogHistogramAggregator(int sub_bucket_bits = 7) :
+        sub_bucket_bits_(std::clamp(sub_bucket_bits, 1, 20)),
+        shift_(52 - sub_bucket_bits_) {}
+
+    void add(double value) {
+        if (std::isnan(value)) return;
+        observe(value);
+        if (value == 0.0) {
+            ++zero_count_;
+            return;
+        }
+        std::uint64_t idx = bucket_index(value);
+        (value > 0.0 ? positive_ : negative_).increment(idx, 1);
+    }
+
+    // Bucket indices, sum and extrema are computed in a vectorisable pass
+    // with independent lanes; the scatter pass then only bumps counts
+    void add_batch(std::span<const double> values) {
+        constexpr std::size_t kBlock = 256;
+        constexpr std::size_t kLanes = 4;
+        std::array<std::uint64_t, kBlock> idx;
+        std::size_t i = 0;
+        while (i < values.size()) {
+            const std::size_t n = std::min(kBlock, values.size() - i);
+            const double* x = values.data() + i;
+
+            double sum[kLanes] = {};
+            double lo[kLanes];
+            double hi[kLanes];
+            std::fill(lo, lo + kLanes, min_);
+            std::fill(hi, hi + kLanes, max_);
+            std::size_t j = 0;
+            for (; j + kLanes <= n; j += kLanes) {
+                for (std::size_t l = 0; l < kLanes; ++l) {
+                    const double v = x[j + l];
+                    idx[j + l] = (std::bit_cast<std::uint64_t>(v) & kAbsMask) >> shift_;
+                    sum[l] += v == v ? v : 0.0;
+                    lo[l] = v < lo[l] ? v : lo[l];
+                    hi[l] = v > hi[l] ? v : hi[l];
+                }
+            }
+            for (; j < n; ++j) {
+                const double v = x[j];
+                idx[j] = (std::bit_cast<std::uint64_t>(v) & kAbsMask) >> shift_;
+                sum[0] += v == v ? v : 0.0;
+                lo[0] = v < lo[0] ? v : lo[0];
+                hi[0] = v > hi[0] ? v : hi[0];
+            }
+            sum_ += (sum[0] + sum[1]) + (sum[2] + sum[3]);
+            min_ = std::min({lo[0], lo[1], lo[2], lo[3]});
+            max_ = std::max({hi[0], hi[1], hi[2], hi[3]});
+
+            for (j = 0; j < n; ++j) {
+                const double v = x[j];
+                if (v > 0.0) {
+                    positive_.increment(idx[j], 1);
+                } else if (v < 0.0) {
+                    negative_.increment(idx[j], 1);
+                } else if (v == 0.0) {
+                    ++zero_count_;
+                } else {
+                    continue;  // NaN
+                }
+                ++count_;
+            }
+            i += n;
+        }
+    }
+
+    void merge(const LogHistogramAggregator& other) {
+        if (other.count_ == 0) return;
+        positive_.merge(other.positive_);
+        negative_.merge(other.negative_);
+        zero_count_ += other.zero_count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        count_ += other.count_;
+    }
+
+    // Exact mean from the running sum
+    double result() const {
+        return count_ > 0 ? sum_ / static_cast<double>(count_) : 0.0;
+    }
+
+    // Value at quantile q, accurate to the bucket's relative precision
+    double quantile(double q) const {
+        if (count_ == 0) return 0.0;
+        q = std::clamp(q, 0.0, 1.0);
+        std::uint64_t target = std::max<std::uint64_t>(1,
+            static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(count_))));
+
+        // Most negative first: walk the negative side from its top bucket down
+        std::uint64_t seen = 0;
+        for (std::size_t k = negative_.counts.size(); k-- > 0;) {
+            seen += negative_.counts[k];
+            if (seen >= target) {
+                return clamp_observed(-representative(negative_.offset + k));
+            }
+        }
+        seen += zero_count_;
+        if (seen >= target) return 0.0;
+        for (std::size_t k = 0; k < positive_.counts.size(); ++k) {
+            seen += positive_.counts[k];
+            if (seen >= target) {
+                return clamp_observed(representative(positive_.offset + k));
+            }
+        }
+        return max_;
+    }
+
+    double percentile(double p) const {
+        return quantile(p / 100.0);
+    }
+
+    // Upper bound on the relative error of reported values
+    double relative_precision() const {
+        return std::ldexp(1.0, -(sub_bucket_bits_ + 1));
+    }
+
+    int sub_bucket_bits() const { return sub_bucket_bits_; }
+    std::uint64_t zero_count() const { return zero_count_; }
+    double min() const { return count_ > 0 ? min_ : 0.0; }
+    double max() const { return count_ > 0 ? max_ : 0.0; }
+
+    // Number of allocated buckets across both signs
+    std::size_t bucket_count() const {
+        return positive_.counts.size() + negative_.counts.size();
+    }
+
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(sub_bucket_bits_);
+        positive_.serialize(w);
+        negative_.serialize(w);
+        w.write(zero_count_);
+        w.write(sum_);
+        w.write(min_);
+        w.write(max_);
+        w.write(count_);
+    }
+
+    static LogHistogramAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "LogHistogramAggregator");
+        LogHistogramAggregator agg(r.read<int>());
+        // One past the largest bucket index at this resolution
+        const std::uint64_t buckets = (kAbsMask >> agg.shift_) + 1;
+        agg.positive_ = Side::deserialize(r, buckets);
+        agg.negative_ = Side::deserialize(r, buckets);
+        r.read(agg.zero_count_);
+        r.read(agg.sum_);
+        r.read(agg.min_);
+        r.read(agg.max_);
+        r.read(agg.count_);
+        return agg;
+    }
+
+    void reset() {
+        positive_ = Side{};
+        negative_ = Side{};
+        zero_count_ = 0;
+        sum_ = 0.0;
+        min_ = std::numeric_limits<double>::infinity();
+        max_ = -std::numeric_limits<double>::infinity();
+        count_ = 0;
+    }
+
+    std::uint64_t count() const { return count_; }
+
+ private:
+    static constexpr std::uint64_t kAbsMask = ~(std::uint64_t{1} << 63);
+    static constexpr std::uint32_t kTag = fourcc("LHST");
+
+    // Dense counts for bucket indices [offset, offset + counts.size())
+    struct Side {
+        std::vector<std::uint64_t> counts;
+        std::uint64_t offset = 0;
+
+        void increment(std::uint64_t idx, std::uint64_t n) {
+            if (idx - offset >= counts.size()) grow(idx, idx + 1);
+            counts[idx - offset] += n;
+        }
+
+        // Widen to cover [lo, hi), with slack so growth is amortised
+        void grow(std::uint64_t lo, std::uint64_t hi) {
+            if (counts.empty()) {
+                counts.assign(hi - lo, 0);
+                offset = lo;
+                return;
+            }
+            std::uint64_t cur_hi = offset + counts.size();
+            std::uint64_t slack = counts.size() / 2;
+            std::uint64_t new_lo = lo < offset ? (lo > slack ? lo - slack : 0) : offset;
+            std::uint64_t new_hi = hi > cur_hi ? hi + slack : cur_hi;
+            new_lo = std::min(new_lo, lo);
+            std::vector<std::uint64_t> wider(new_hi - new_lo, 0);
+            std::copy(counts.begin(), counts.end(), wider.begin() + (offset - new_lo));
+            counts.swap(wider);
+            offset = new_lo;
+        }
+
+        // Growth slack is trimmed: only the occupied range is written
+        void serialize(ByteWriter& w) const {
+            std::size_t lo = 0;
+            std::size_t hi = counts.size();
+            while (lo < hi && counts[lo] == 0) ++lo;
+            while (hi > lo && counts[hi - 1] == 0) --hi;
+            w.write(offset + lo);
+            w.write(hi - lo);
+            for (std::size_t k = lo; k < hi; ++k) w.write(counts[k]);
+        }
+
+        static Side deserialize(ByteReader& r, std::uint64_t buckets) {
+            Side side;
+            side.offset = r.read_in<std::uint64_t>(0, buckets, "LogHistogramAggregator");
+            const auto n = r.read<std::size_t>();
+            if (n > r.remaining() / 8) throw std::runtime_error("ByteReader: truncated input");
+            if (n > buckets - side.offset) throw std::runtime_error("LogHistogramAggregator: configuration out of range");
+            side.counts.resize(n);
+            for (std::uint64_t& c : side.counts) r.read(c);
+            if (n == 0) side.offset = 0;
+            return side;
+        }
+
+        void merge(const Side& other) {
+            if (other.counts.empty()) return;
+            std::uint64_t lo = other.offset;
+            std::uint64_t hi = other.offset + other.counts.size();
+            if (counts.empty() || lo < offset || hi > offset + counts.size()) {
+                grow(lo, hi);
+            }
+            std::uint64_t* dst = counts.data() + (lo - offset);
+            const std::uint64_t* src = other.counts.data();
+            for (std::size_t k = 0; k < other.counts.size(); ++k) {
+                dst[k] += src[k];
+            }
+        }
+    };
+
+    std::uint64_t bucket_index(double value) const {
+        return (std::bit_cast<std::uint64_t>(value) & kAbsMask) >> shift_;
+    }
+
+    // Midpoint of a bucket's magnitude range
+    double representative(std::uint64_t idx) const {
+        double lower = std::bit_cast<double>(idx << shift_);
+        if (std::isinf(lower)) return lower;
+        double upper = std::bit_cast<double>((idx + 1) << shift_);
+        return lower + (upper - lower) / 2.0;
+    }
+
+    double clamp_observed(double value) const {
+        return std::min(std::max(value, min_), max_);
+    }
+
+    void observe(double value) {
+        sum_ += value;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+        ++count_;
+    }
+
+    int sub_bucket_bits_;
+    int shift_;
+    Side positive_;
+    Side negative_;
+    std::uint64_t zero_count_ = 0;
+    double sum_ = 0.0;
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+    std::uint64_t count_ = 0;
+};
+
+} // namespace montecarlo
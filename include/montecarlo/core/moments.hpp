@@ -0,0 +1,232 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include "concepts.hpp"
+
+namespace montecarlo {
+
+// Single-pass mean, variance, skewness and kurtosis (Pebay's update and
+// merge formulas) plus the extrema and the trial indices where they
+// occurred. Ties keep the earliest trial.
+class MomentsAggregator {
+ public:
+    // Trial indices are global when run by an execution policy
+    void begin_stream(const StreamContext& ctx) {
+        next_index_ = ctx.first_trial;
+    }
+
+    void add(double value) {
+        observe_extremum(value, next_index_);
+        ++next_index_;
+
+        const double n1 = static_cast<double>(count_);
+        ++count_;
+        const double n = static_cast<double>(count_);
+        const double delta = value - mean_;
+        const double delta_n = delta / n;
+        const double delta_n2 = delta_n * delta_n;
+        const double term1 = delta * delta_n * n1;
+        mean_ += delta_n;
+        m4_ += term1 * delta_n2 * (n * n - 3.0 * n + 3.0) + 6.0 * delta_n2 * m2_ - 4.0 * delta_n * m3_;
+        m3_ += term1 * delta_n * (n - 2.0) - 3.0 * delta_n * m2_;
+        m2_ += term1;
+    }
+
+    // Shifted power sums over each block in independent lanes, converted
+    // to central moments and folded in with merge()
+    void add_batch(std::span<const double> values) {
+        constexpr std::size_t kBlock = 1024;
+        constexpr std::size_t kLanes = 4;
+        std::size_t i = 0;
+        while (i < values.size()) {
+            const std::size_t n = std::min(kBlock, values.size() - i);
+            const double* x = values.data() + i;
+            const double shift = count_ > 0 ? mean_ : x[0];
+
+            double s1[kLanes] = {}, s2[kLanes] = {}, s3[kLanes] = {}, s4[kLanes] = {};
+            double lo[kLanes], hi[kLanes];
+            std::size_t lo_at[kLanes] = {}, hi_at[kLanes] = {};
+            std::fill(lo, lo + kLanes, std::numeric_limits<double>::infinity());
+            std::fill(hi, hi + kLanes, -std::numeric_limits<double>::infinity());
+
+            std::size_t j = 0;
+            for (; j + kLanes <= n; j += kLanes) {
+                for (std::size_t l = 0; l < kLanes; ++l) {
+                    const double v = x[j + l];
+                    const double d = v - shift;
+                    const double d2 = d * d;
+                    s1[l] += d;
+                    s2[l] += d2;
+                    s3[l] += d2 * d;
+                    s4[l] += d2 * d2;
+                    lo_at[l] = v < lo[l] ? j + l : lo_at[l];
+                    lo[l] = v < lo[l] ? v : lo[l];
+                    hi_at[l] = v > hi[l] ? j + l : hi_at[l];
+                    hi[l] = v > hi[l] ? v : hi[l];
+                }
+            }
+            for (; j < n; ++j) {
+                const double v = x[j];
+                const double d = v - shift;
+                const double d2 = d * d;
+                s1[0] += d;
+                s2[0] += d2;
+                s3[0] += d2 * d;
+                s4[0] += d2 * d2;
+                if (v < lo[0] || (v == lo[0] && j < lo_at[0])) { lo[0] = v; lo_at[0] = j; }
+                if (v > hi[0] || (v == hi[0] && j < hi_at[0])) { hi[0] = v; hi_at[0] = j; }
+            }
+
+            MomentsAggregator block;
+            for (std::size_t l = 0; l < kLanes; ++l) {
+                if (lo[l] <= hi[l]) {
+                    block.observe_extremum(lo[l], next_index_ + lo_at[l]);
+                    block.observe_extremum(hi[l], next_index_ + hi_at[l]);
+                }
+            }
+            const double S1 = (s1[0] + s1[1]) + (s1[2] + s1[3]);
+            const double S2 = (s2[0] + s2[1]) + (s2[2] + s2[3]);
+            const double S3 = (s3[0] + s3[1]) + (s3[2] + s3[3]);
+            const double S4 = (s4[0] + s4[1]) + (s4[2] + s4[3]);
+            const double bn = static_cast<double>(n);
+            const double m = S1 / bn;
+            block.count_ = n;
+            block.mean_ = shift + m;
+            block.m2_ = std::max(0.0, S2 - S1 * m);
+            block.m3_ = S3 - 3.0 * m * S2 + 2.0 * bn * m * m * m;
+            block.m4_ = std::max(0.0, S4 - 4.0 * m * S3 + 6.0 * m * m * S2 - 3.0 * bn * m * m * m * m);
+
+            std::uint64_t next = next_index_ + n;
+            merge(block);
+            next_index_ = next;
+            i += n;
+        }
+    }
+
+    void merge(const MomentsAggregator& other) {
+        if (other.count_ == 0) return;
+        observe_extremum(other.min_, other.argmin_);
+        observe_extremum(other.max_, other.argmax_);
+        if (count_ == 0) {
+            count_ = other.count_;
+            mean_ = other.mean_;
+            m2_ = other.m2_;
+            m3_ = other.m3_;
+            m4_ = other.m4_;
+            return;
+        }
+        const double na = static_cast<double>(count_);
+        const double nb = static_cast<double>(other.count_);
+        const double n = na + nb;
+        const double delta = other.mean_ - mean_;
+        const double delta2 = delta * delta;
+        const double delta3 = delta2 * delta;
+        const double delta4 = delta2 * delta2;
+
+        const double m2 = m2_ + other.m2_ + delta2 * na * nb / n;
+        const double m3 = m3_ + other.m3_ + delta3 * na * nb * (na - nb) / (n * n) +
+            3.0 * delta * (na * other.m2_ - nb * m2_) / n;
+        const double m4 = m4_ + other.m4_ +
+            delta4 * na * nb * (na * na - na * nb + nb * nb) / (n * n * n) +
+            6.0 * delta2 * (na * na * other.m2_ + nb * nb * m2_) / (n * n) +
+            4.0 * delta * (na * other.m3_ - nb * m3_) / n;
+
+        mean_ += delta * nb / n;
+        m2_ = m2;
+        m3_ = m3;
+        m4_ = m4;
+        count_ += other.count_;
+    }
+
+    double result() const {
+        return mean_;
+    }
+
+    double variance() const {
+        return count_ > 1 ? m2_ / static_cast<double>(count_ - 1) : 0.0;
+    }
+
+    double std_error() const {
+        return count_ > 0 ? std::sqrt(variance() / static_cast<double>(count_)) : 0.0;
+    }
+
+    // Population skewness g1
+    double skewness() const {
+        if (count_ < 2 || m2_ <= 0.0) return 0.0;
+        return std::sqrt(static_cast<double>(count_)) * m3_ / std::pow(m2_, 1.5);
+    }
+
+    // Population kurtosis (3 for a normal distribution)
+    double kurtosis() const {
+        if (count_ < 2 || m2_ <= 0.0) return 0.0;
+        return static_cast<double>(count_) * m4_ / (m2_ * m2_);
+    }
+
+    double excess_kurtosis() const {
+        return count_ < 2 || m2_ <= 0.0 ? 0.0 : kurtosis() - 3.0;
+    }
+
+    double min() const { return count_ > 0 ? min_ : 0.0; }
+    double max() const { return count_ > 0 ? max_ : 0.0; }
+
+    // Trial index of the first occurrence of min()/max()
+    std::uint64_t argmin() const { return argmin_; }
+    std::uint64_t argmax() const { return argmax_; }
+
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(count_);
+        for (double v : {mean_, m2_, m3_, m4_, min_, max_}) w.write(v);
+        w.write(argmin_);
+        w.write(argmax_);
+        w.write(next_index_);
+    }
+
+    static MomentsAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "MomentsAggregator");
+        MomentsAggregator agg;
+        r.read(agg.count_);
+        for (double* v : {&agg.mean_, &agg.m2_, &agg.m3_, &agg.m4_, &agg.min_, &agg.max_}) r.read(*v);
+        r.read(agg.argmin_);
+        r.read(agg.argmax_);
+        r.read(agg.next_index_);
+        return agg;
+    }
+
+    void reset() {
+        *this = MomentsAggregator{};
+    }
+
+    std::uint64_t count() const { return count_; }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("MOMS");
+
+    void observe_extremum(double value, std::uint64_t index) {
+        if (value < min_ || (value == min_ && index < argmin_)) {
+            min_ = value;
+            argmin_ = index;
+        }
+        if (value > max_ || (value == max_ && index < argmax_)) {
+            max_ = value;
+            argmax_ = index;
+        }
+    }
+
+    std::uint64_t count_ = 0;
+    double mean_ = 0.0;
+    double m2_ = 0.0;
+    double m3_ = 0.0;
+    double m4_ = 0.0;
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+    std::uint64_t argmin_ = 0;
+    std::uint64_t argmax_ = 0;
+    std::uint64_t next_index_ = 0;
+};
+
+} // namespace montecarlo
@@ -0,0 +1,330 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <numbers>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "bytes.hpp"
+
+namespace montecarlo {
+
+namespace detail {
+
+// LSD radix sort on the order-preserving bit pattern of doubles. Buffers of
+// a few thousand samples sort several times faster than with std::sort,
+// whose comparisons mispredict on random data. Digits shared by every key
+// (typically sign and high exponent bits) are skipped.
+inline void radix_sort(std::vector<double>& values, std::vector<std::uint64_t>& keys,
+                       std::vector<std::uint64_t>& tmp) {
+    const std::size_t n = values.size();
+    if (n < 64) {
+        std::sort(values.begin(), values.end());
+        return;
+    }
+    keys.resize(n);
+    tmp.resize(n);
+    std::size_t counts[8][256] = {};
+    for (std::size_t i = 0; i < n; ++i) {
+        std::uint64_t bits = std::bit_cast<std::uint64_t>(values[i]);
+        bits ^= (bits >> 63) != 0 ? ~std::uint64_t{0} : (std::uint64_t{1} << 63);
+        keys[i] = bits;
+        for (int d = 0; d < 8; ++d) {
+            ++counts[d][(bits >> (8 * d)) & 0xFF];
+        }
+    }
+    for (int d = 0; d < 8; ++d) {
+        std::size_t* count = counts[d];
+        if (count[(keys[0] >> (8 * d)) & 0xFF] == n) continue;
+        std::size_t offset = 0;
+        for (int b = 0; b < 256; ++b) {
+            std::size_t c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            std::uint64_t k = keys[i];
+            tmp[count[(k >> (8 * d)) & 0xFF]++] = k;
+        }
+        keys.swap(tmp);
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+        std::uint64_t bits = keys[i];
+        bits ^= (bits >> 63) != 0 ? (std::uint64_t{1} << 63) : ~std::uint64_t{0};
+        values[i] = std::bit_cast<double>(bits);
+    }
+}
+
+} // namespace detail
+
+// Merging t-digest (Dunning) for streaming quantiles in bounded memory.
+// Centroids are sized by the arcsine scale function, so the tails (p99,
+// p99.9) stay sharp while the bulk is compressed. Memory is O(compression).
+//
+// Values are buffered and folded in lazily, and const queries do the
+// folding, so they write to the digest while values are pending. Call
+// flush() before querying one digest from several threads.
+class TDigestAggregator {
+ public:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    // Larger compression means more centroids and better accuracy;
+    // 100-300 is typical
+    explicit TDigestAggregator(double compression = 200.0) :
+        compression_(std::max(compression, 20.0)),
+        buffer_limit_(static_cast<std::size_t>(10.0 * compression_)) {
+        centroids_.reserve(static_cast<std::size_t>(2.0 * compression_));
+        buffer_.reserve(buffer_limit_);
+    }
+
+    void add(double value) {
+        if (std::isnan(value)) return;
+        buffer_.push_back(value);
+        observe(value);
+        if (buffer_.size() >= buffer_limit_) compress();
+    }
+
+    void add_batch(std::span<const double> values) {
+        std::size_t i = 0;
+        while (i < values.size()) {
+            std::size_t n = std::min(values.size() - i, buffer_limit_ - buffer_.size());
+            for (std::size_t j = 0; j < n; ++j) {
+                double v = values[i + j];
+                if (std::isnan(v)) continue;
+                buffer_.push_back(v);
+                observe(v);
+            }
+            i += n;
+            if (buffer_.size() >= buffer_limit_) compress();
+        }
+    }
+
+    // Merge another digest by folding its centroids in as weighted points
+    void merge(const TDigestAggregator& other) {
+        if (other.count_ == 0) return;
+        other.flush();
+        flush();
+        std::vector<Centroid> combined;
+        combined.reserve(centroids_.size() + other.centroids_.size());
+        std::merge(centroids_.begin(), centroids_.end(),
+            other.centroids_.begin(), other.centroids_.end(),
+            std::back_inserter(combined), by_mean);
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        count_ += other.count_;
+        centroids_.clear();
+        merge_sorted(combined.begin(), combined.end(), static_cast<double>(count_));
+    }
+
+    // Median estimate
+    double result() const {
+        return quantile(0.5);
+    }
+
+    double quantile(double q) const {
+        flush();
+        if (centroids_.empty()) return 0.0;
+        q = std::clamp(q, 0.0, 1.0);
+        if (centroids_.size() == 1) return centroids_.front().mean;
+
+        const double total = static_cast<double>(count_);
+        const double index = q * total;
+        if (index < 1.0) return min_;
+        if (index > total - 1.0) return max_;
+
+        // Between min and the first centroid's centre
+        const Centroid& first = centroids_.front();
+        if (index < first.weight / 2.0) {
+            return min_ + (index - 1.0) / (first.weight / 2.0 - 1.0) * (first.mean - min_);
+        }
+
+        double cumulative = first.weight / 2.0;
+        for (std::size_t i = 0; i + 1 < centroids_.size(); ++i) {
+            const Centroid& a = centroids_[i];
+            const Centroid& b = centroids_[i + 1];
+            double gap = (a.weight + b.weight) / 2.0;
+            if (index < cumulative + gap) {
+                double t = (index - cumulative) / gap;
+                return a.mean + t * (b.mean - a.mean);
+            }
+            cumulative += gap;
+        }
+
+        // Between the last centroid's centre and max
+        const Centroid& last = centroids_.back();
+        double remaining = total - 1.0 - cumulative;
+        if (remaining <= 0.0) return max_;
+        double t = (index - cumulative) / remaining;
+        return last.mean + std::min(t, 1.0) * (max_ - last.mean);
+    }
+
+    // Fraction of mass at or below x
+    double cdf(double x) const {
+        flush();
+        if (centroids_.empty()) return 0.0;
+        if (x < min_) return 0.0;
+        if (x >= max_) return 1.0;
+
+        const double total = static_cast<double>(count_);
+        double cumulative = 0.0;
+        double prev_mean = min_;
+        double prev_cum = 0.0;
+        for (const Centroid& c : centroids_) {
+            double centre = cumulative + c.weight / 2.0;
+            if (x < c.mean) {
+                double t = (x - prev_mean) / (c.mean - prev_mean);
+                return (prev_cum + t * (centre - prev_cum)) / total;
+            }
+            cumulative += c.weight;
+            prev_mean = c.mean;
+            prev_cum = centre;
+        }
+        double t = (x - prev_mean) / (max_ - prev_mean);
+        return (prev_cum + t * (total - prev_cum)) / total;
+    }
+
+    double min() const { return count_ > 0 ? min_ : 0.0; }
+    double max() const { return count_ > 0 ? max_ : 0.0; }
+
+    const std::vector<Centroid>& centroids() const {
+        flush();
+        return centroids_;
+    }
+
+    double compression() const { return compression_; }
+
+    // Fold pending values into the centroids; until the next add(), const
+    // queries then only read
+    void flush() const {
+        if (!buffer_.empty()) compress();
+    }
+
+    // Pending values are folded in first, so only centroids are written
+    void serialize(ByteWriter& w) const {
+        flush();
+        w.tag(kTag);
+        w.write(compression_);
+        w.write(min_);
+        w.write(max_);
+        w.write(count_);
+        w.write(centroids_.size());
+        for (const Centroid& c : centroids_) {
+            w.write(c.mean);
+            w.write(c.weight);
+        }
+    }
+
+    static TDigestAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "TDigestAggregator");
+        // The buffer holds 10 * compression values
+        TDigestAggregator agg(r.read_in<double>(-std::numeric_limits<double>::max(),
+                                                static_cast<double>(kMaxConfigSize / 10), "TDigestAggregator"));
+        r.read(agg.min_);
+        r.read(agg.max_);
+        r.read(agg.count_);
+        const auto n = r.read<std::size_t>();
+        if (n > r.remaining() / 16) throw std::runtime_error("ByteReader: truncated input");
+        agg.centroids_.resize(n);
+        for (Centroid& c : agg.centroids_) {
+            r.read(c.mean);
+            r.read(c.weight);
+        }
+        return agg;
+    }
+
+    void reset() {
+        centroids_.clear();
+        buffer_.clear();
+        min_ = std::numeric_limits<double>::infinity();
+        max_ = -std::numeric_limits<double>::infinity();
+        count_ = 0;
+    }
+
+    std::uint64_t count() const { return count_; }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("TDIG");
+
+    void observe(double value) {
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+        ++count_;
+    }
+
+    // k1 scale function and its inverse
+    double scale(double q) const {
+        return compression_ / (2.0 * std::numbers::pi) * std::asin(2.0 * q - 1.0);
+    }
+
+    double scale_inverse(double k) const {
+        return (std::sin(k * 2.0 * std::numbers::pi / compression_) + 1.0) / 2.0;
+    }
+
+    static bool by_mean(const Centroid& a, const Centroid& b) {
+        return a.mean < b.mean;
+    }
+
+    // Sort the unit-weight buffer, interleave it with the (already sorted)
+    // centroids and re-cluster in one sweep
+    void compress() const {
+        if (buffer_.empty()) return;
+        detail::radix_sort(buffer_, radix_keys_, radix_tmp_);
+        scratch_.clear();
+        scratch_.reserve(centroids_.size() + buffer_.size());
+        auto c = centroids_.begin();
+        for (double v : buffer_) {
+            while (c != centroids_.end() && c->mean <= v) {
+                scratch_.push_back(*c++);
+            }
+            scratch_.push_back({v, 1.0});
+        }
+        scratch_.insert(scratch_.end(), c, centroids_.end());
+        buffer_.clear();
+        centroids_.clear();
+        merge_sorted(scratch_.begin(), scratch_.end(), static_cast<double>(count_));
+    }
+
+    // Greedy pass: grow each centroid while its span in k-space stays <= 1
+    template<typename It>
+    void merge_sorted(It first, It last, double total) const {
+        if (first == last) return;
+        Centroid current = *first;
+        double so_far = 0.0;
+        double limit = total * scale_inverse(scale(0.0) + 1.0);
+        for (++first; first != last; ++first) {
+            const Centroid& next = *first;
+            if (so_far + current.weight + next.weight <= limit) {
+                double w = current.weight + next.weight;
+                current.mean += (next.mean - current.mean) * next.weight / w;
+                current.weight = w;
+            } else {
+                so_far += current.weight;
+                centroids_.push_back(current);
+                limit = total * scale_inverse(scale(so_far / total) + 1.0);
+                current = next;
+            }
+        }
+        centroids_.push_back(current);
+    }
+
+    double compression_;
+    std::size_t buffer_limit_;
+    mutable std::vector<Centroid> centroids_;
+    mutable std::vector<double> buffer_;
+    mutable std::vector<Centroid> scratch_;
+    mutable std::vector<std::uint64_t> radix_keys_;
+    mutable std::vector<std::uint64_t> radix_tmp_;
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+    std::uint64_t count_ = 0;
+};
+
+} // namespace montecarlo
@@ -0,0 +1,120 @@
+#pragma once
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include "result.hpp"
+
+namespace montecarlo {
+
+namespace detail {
+
+// Shortest text that reads back to the same double
+inline void append_number(std::string& out, double value) {
+    char buf[32];
+    const auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, ec == std::errc{} ? end : buf);
+}
+
+inline void append_number(std::string& out, std::uint64_t value) {
+    char buf[24];
+    const auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, ec == std::errc{} ? end : buf);
+}
+
+// JSON has no NaN or infinity
+inline void append_json_number(std::string& out, double value) {
+    if (std::isfinite(value)) {
+        append_number(out, value);
+    } else {
+        out += "null";
+    }
+}
+
+} // namespace detail
+
+// One JSON object per result, on one line:
+// {"estimate":..,"variance":..,"standard_error":..,"iterations":..,
+//  "elapsed_ms":..,"setup_ms":..,"merge_ms":..,
+//  "workers":[{"trials":..,"elapsed_ms":..,"throughput":..},..]}
+// Doubles are written in shortest round-trip form; non-finite ones as null.
+inline std::string to_json(const Result& r) {
+    std::string out = "{\"estimate\":";
+    detail::append_json_number(out, r.estimate);
+    out += ",\"variance\":";
+    detail::append_json_number(out, r.variance);
+    out += ",\"standard_error\":";
+    detail::append_json_number(out, r.standard_error);
+    out += ",\"iterations\":";
+    detail::append_number(out, r.iterations);
+    out += ",\"elapsed_ms\":";
+    detail::append_json_number(out, r.elapsed_ms);
+    out += ",\"setup_ms\":";
+    detail::append_json_number(out, r.setup_ms);
+    out += ",\"merge_ms\":";
+    detail::append_json_number(out, r.merge_ms);
+    out += ",\"workers\":[";
+    for (std::size_t t = 0; t < r.workers.size(); ++t) {
+        if (t > 0) out += ',';
+        out += "{\"trials\":";
+        detail::append_number(out, r.workers[t].trials);
+        out += ",\"elapsed_ms\":";
+        detail::append_json_number(out, r.workers[t].elapsed_ms);
+        out += ",\"throughput\":";
+        detail::append_json_number(out, r.workers[t].throughput);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
+
+// Run-level CSV: csv_header() once, then one to_csv() row per result. The
+// per-worker breakdown has its own table, so the columns stay fixed.
+inline std::string csv_header() {
+    return "estimate,variance,standard_error,iterations,elapsed_ms,setup_ms,merge_ms,workers\n";
+}
+
+inline std::string to_csv(const Result& r) {
+    std::string out;
+    detail::append_number(out, r.estimate);
+    out += ',';
+    detail::append_number(out, r.variance);
+    out += ',';
+    detail::append_number(out, r.standard_error);
+    out += ',';
+    detail::append_number(out, r.iterations);
+    out += ',';
+    detail::append_number(out, r.elapsed_ms);
+    out += ',';
+    detail::append_number(out, r.setup_ms);
+    out += ',';
+    detail::append_number(out, r.merge_ms);
+    out += ',';
+    detail::append_number(out, static_cast<std::uint64_t>(r.workers.size()));
+    out += '\n';
+    return out;
+}
+
+// Per-worker CSV: worker_csv_header() once, then worker_csv() rows
+inline std::string worker_csv_header() {
+    return "worker,trials,elapsed_ms,throughput\n";
+}
+
+inline std::string worker_csv(const Result& r) {
+    std::string out;
+    for (std::size_t t = 0; t < r.workers.size(); ++t) {
+        detail::append_number(out, static_cast<std::uint64_t>(t));
+        out += ',';
+        detail::append_number(out, r.workers[t].trials);
+        out += ',';
+        detail::append_number(out, r.workers[t].elapsed_ms);
+        out += ',';
+        detail::append_number(out, r.workers[t].throughput);
+        out += '\n';
+    }
+    return out;
+}
+
+} // namespace montecarlo
@@ -0,0 +1,246 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include "bytes.hpp"
+
+namespace montecarlo {
+
+// Exact fixed-point accumulator for doubles (Kulisch-style). Every finite
+// double is an integer multiple of 2^-1074, so the sum is kept as a wide
+// integer in 32-bit digits held in int64 limbs; the spare high bits absorb
+// carries, which are only propagated every 2^30 additions. Addition is
+// exact and therefore associative: the state, and anything rounded from
+// it, is independent of summation and merge order.
+class Superaccumulator {
+ public:
+    void add(double x) {
+        if (!std::isfinite(x)) {
+            nonfinite_ += x;  // inf/nan propagation is itself order-independent
+            return;
+        }
+        const std::uint64_t bits = std::bit_cast<std::uint64_t>(x);
+        const std::uint64_t exp_bits = (bits >> 52) & 0x7FF;
+        std::uint64_t mant = bits & ((std::uint64_t{1} << 52) - 1);
+        if (exp_bits != 0) mant |= std::uint64_t{1} << 52;
+        if (mant == 0) return;
+        // x = mant * 2^(pos - 1074)
+        const std::uint64_t pos = exp_bits != 0 ? exp_bits - 1 : 0;
+        const std::size_t limb = static_cast<std::size_t>(pos / 32);
+        const unsigned shift = static_cast<unsigned>(pos % 32);
+
+        const std::uint64_t d0 = (mant & ((std::uint64_t{1} << (32 - shift)) - 1)) << shift;
+        const std::uint64_t rest = mant >> (32 - shift);
+        const std::int64_t sign = (bits >> 63) != 0 ? -1 : 1;
+        limbs_[limb] += sign * static_cast<std::int64_t>(d0);
+        limbs_[limb + 1] += sign * static_cast<std::int64_t>(rest & kDigitMask);
+        limbs_[limb + 2] += sign * static_cast<std::int64_t>(rest >> 32);
+        if (++unnormalized_ == kCarryBudget) normalize();
+    }
+
+    void merge(const Superaccumulator& other) {
+        normalize();
+        for (std::size_t i = 0; i < kLimbs; ++i) {
+            limbs_[i] += other.limbs_[i];
+        }
+        nonfinite_ += other.nonfinite_;
+        normalize();
+    }
+
+    // Deterministic rounding of the exact sum
+    double value() const {
+        if (nonfinite_ != 0.0) return nonfinite_;  // also true for nan
+        Superaccumulator copy = *this;
+        copy.normalize();
+        return copy.round_normalized();
+    }
+
+    // hi + lo carries ~106 bits of the exact sum
+    std::pair<double, double> value_double_double() const {
+        double hi = value();
+        if (!std::isfinite(hi)) return {hi, 0.0};
+        Superaccumulator rest = *this;
+        rest.add(-hi);
+        return {hi, rest.value()};
+    }
+
+    // Normalised limbs, so equal sums serialise identically
+    void serialize(ByteWriter& w) const {
+        Superaccumulator copy = *this;
+        copy.normalize();
+        for (std::int64_t limb : copy.limbs_) w.write(limb);
+        w.write(nonfinite_);
+    }
+
+    static Superaccumulator deserialize(ByteReader& r) {
+        Superaccumulator acc;
+        for (std::int64_t& limb : acc.limbs_) r.read(limb);
+        r.read(acc.nonfinite_);
+        return acc;
+    }
+
+    void reset() {
+        limbs_.fill(0);
+        nonfinite_ = 0.0;
+        unnormalized_ = 0;
+    }
+
+ private:
+    // 2098 bits of position + 53 bits of mantissa + headroom
+    static constexpr std::size_t kLimbs = 72;
+    static constexpr std::int64_t kDigitMask = 0xFFFFFFFF;
+    static constexpr std::uint64_t kCarryBudget = std::uint64_t{1} << 30;
+
+    // Digits below the top limb in [0, 2^32); the top limb carries the sign
+    void normalize() {
+        std::int64_t carry = 0;
+        for (std::size_t i = 0; i + 1 < kLimbs; ++i) {
+            std::int64_t v = limbs_[i] + carry;
+            carry = v >> 32;  // floor division
+            limbs_[i] = v - carry * (std::int64_t{1} << 32);
+        }
+        limbs_[kLimbs - 1] += carry;
+        unnormalized_ = 0;
+    }
+
+    double round_normalized() {
+        if (limbs_[kLimbs - 1] < 0) {
+            for (auto& limb : limbs_) limb = -limb;
+            normalize();
+            return -round_normalized();
+        }
+        std::size_t top = kLimbs;
+        while (top > 0 && limbs_[top - 1] == 0) --top;
+        if (top == 0) return 0.0;
+        // Top three digits (up to 96 bits) summed from the most significant
+        double out = 0.0;
+        for (std::size_t i = top; i > 0 && i + 3 > top; --i) {
+            out += std::ldexp(static_cast<double>(limbs_[i - 1]), 32 * static_cast<int>(i - 1) - 1074);
+        }
+        return out;
+    }
+
+    std::array<std::int64_t, kLimbs> limbs_{};
+    double nonfinite_ = 0.0;
+    std::uint64_t unnormalized_ = 0;
+};
+
+// Mean and variance that are bit-identical for any summation or merge
+// order, hence for any thread count or merge tree over the same samples.
+// Sum and sum of squares are exact (x^2 is split into two doubles with an
+// FMA); mean and variance are then formed in double-double arithmetic.
+// Several times slower than WelfordAggregator; see the aggregator_reproducible
+// bench row.
+class ReproducibleAggregator {
+ public:
+    void add(double value) {
+        sum_.add(value);
+        const double sq = value * value;
+        sumsq_.add(sq);
+        sumsq_.add(std::fma(value, value, -sq));
+        ++count_;
+    }
+
+    void add_batch(std::span<const double> values) {
+        for (double v : values) add(v);
+    }
+
+    void merge(const ReproducibleAggregator& other) {
+        sum_.merge(other.sum_);
+        sumsq_.merge(other.sumsq_);
+        count_ += other.count_;
+    }
+
+    // Deterministically rounded exact sum
+    double sum() const { return sum_.value(); }
+
+    double result() const {
+        if (count_ == 0) return 0.0;
+        auto [hi, lo] = sum_.value_double_double();
+        return div(hi, lo, static_cast<double>(count_)).first;
+    }
+
+    double variance() const {
+        if (count_ < 2) return 0.0;
+        const double n = static_cast<double>(count_);
+        auto [sh, sl] = sum_.value_double_double();
+        auto [qh, ql] = sumsq_.value_double_double();
+        // (Q - S * (S / n)) / (n - 1) in double-double
+        auto [mh, ml] = div(sh, sl, n);
+        auto [ph, pl] = mul(sh, sl, mh, ml);
+        auto [dh, dl] = add(qh, ql, -ph, -pl);
+        double v = div(dh, dl, n - 1.0).first;
+        return v > 0.0 ? v : 0.0;
+    }
+
+    double std_error() const {
+        return count_ > 0 ? std::sqrt(variance() / static_cast<double>(count_)) : 0.0;
+    }
+
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        sum_.serialize(w);
+        sumsq_.serialize(w);
+        w.write(count_);
+    }
+
+    static ReproducibleAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "ReproducibleAggregator");
+        ReproducibleAggregator agg;
+        agg.sum_ = Superaccumulator::deserialize(r);
+        agg.sumsq_ = Superaccumulator::deserialize(r);
+        r.read(agg.count_);
+        return agg;
+    }
+
+    void reset() {
+        sum_.reset();
+        sumsq_.reset();
+        count_ = 0;
+    }
+
+    std::uint64_t count() const { return count_; }
+
+ private:
+    using DD = std::pair<double, double>;
+
+    static constexpr std::uint32_t kTag = fourcc("RSUM");
+
+    static DD two_sum(double a, double b) {
+        double s = a + b;
+        double bb = s - a;
+        return {s, (a - (s - bb)) + (b - bb)};
+    }
+
+    static DD add(double ah, double al, double bh, double bl) {
+        auto [s, e] = two_sum(ah, bh);
+        e += al + bl;
+        return two_sum(s, e);
+    }
+
+    static DD mul(double ah, double al, double bh, double bl) {
+        double p = ah * bh;
+        double e = std::fma(ah, bh, -p) + (ah * bl + al * bh);
+        return two_sum(p, e);
+    }
+
+    static DD div(double ah, double al, double b) {
+        double q1 = ah / b;
+        // remainder a - q1 * b, exactly via FMA
+        double p = q1 * b;
+        double pe = std::fma(q1, b, -p);
+        auto [rh, rl] = add(ah, al, -p, -pe);
+        double q2 = (rh + rl) / b;
+        return two_sum(q1, q2);
+    }
+
+    Superaccumulator sum_;
+    Superaccumulator sumsq_;
+    std::uint64_t count_ = 0;
+};
+
+} // namespace montecarlo
@@ -0,0 +1,340 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bytes.hpp"
+#include "concepts.hpp"
+#include "rng.hpp"
+
+namespace montecarlo {
+
+namespace detail {
+
+// Keeps reservoir draws off the model's random streams
+inline constexpr std::uint64_t kReservoirSalt = 0x5eed5a3b1e0f7a11ULL;
+
+// Uniform on the open interval (0, 1)
+inline double open_unit(std::mt19937_64& rng) {
+    return (static_cast<double>(rng() >> 11) + 0.5) * 0x1p-53;
+}
+
+// Generator state in the standard textual form, so a restored reservoir
+// continues the same stream
+inline void write_rng(ByteWriter& w, const std::mt19937_64& rng) {
+    std::ostringstream os;
+    os << rng;
+    w.write(os.str());
+}
+
+inline std::mt19937_64 read_rng(ByteReader& r) {
+    std::string text;
+    r.read(text);
+    std::istringstream is(text);
+    std::mt19937_64 rng;
+    is >> rng;
+    if (!is) throw std::runtime_error("ByteReader: invalid generator state");
+    return rng;
+}
+
+inline std::uint64_t clamp_skip(double skip) {
+    constexpr double kMax = 9.0e18;
+    return skip < kMax ? static_cast<std::uint64_t>(skip) : static_cast<std::uint64_t>(kMax);
+}
+
+} // namespace detail
+
+// Uniform random sample of k trial outputs without storing all N.
+//
+// Algorithm L: after the reservoir fills, the gap to the next accepted
+// value is drawn directly, so a run costs O(k log(N/k)) RNG calls and
+// add_batch() jumps over rejected values without touching them.
+//
+// Draws come from a stream derived from the run seed and worker id in
+// begin_stream(), so a run is reproducible for a fixed thread count.
+// merge() draws a hypergeometric split of the k slots between the two
+// reservoirs, which yields a uniform sample of the union.
+class ReservoirAggregator {
+ public:
+    explicit ReservoirAggregator(std::size_t k = 1024, std::uint64_t seed = 0) :
+        k_(std::max<std::size_t>(k, 1)), rng_(make_rng(seed ^ detail::kReservoirSalt)) {
+        samples_.reserve(k_);
+    }
+
+    void begin_stream(const StreamContext& ctx) {
+        rng_ = make_rng(ctx.seed ^ detail::kReservoirSalt, ctx.stream_id);
+    }
+
+    void add(double value) {
+        add_batch(std::span<const double>(&value, 1));
+    }
+
+    void add_batch(std::span<const double> values) {
+        std::size_t i = 0;
+        while (i < values.size() && samples_.size() < k_) {
+            samples_.push_back(values[i++]);
+            if (++seen_ == k_) {
+                w_ = std::exp(std::log(detail::open_unit(rng_)) / static_cast<double>(k_));
+                draw_skip();
+            }
+        }
+        while (i < values.size()) {
+            const std::uint64_t remaining = values.size() - i;
+            if (skip_ >= remaining) {
+                skip_ -= remaining;
+                seen_ += remaining;
+                return;
+            }
+            i += static_cast<std::size_t>(skip_);
+            seen_ += skip_ + 1;
+            samples_[slot()] = values[i++];
+            w_ *= std::exp(std::log(detail::open_unit(rng_)) / static_cast<double>(k_));
+            draw_skip();
+        }
+    }
+
+    void merge(const ReservoirAggregator& other) {
+        if (other.seen_ == 0) return;
+        if (seen_ == 0) {
+            // Continue on the first worker's stream, which the run seed fixes
+            *this = other;
+            return;
+        }
+        std::vector<double> mine = std::move(samples_);
+        std::vector<double> theirs = other.samples_;
+        std::uint64_t pop_mine = seen_;
+        std::uint64_t pop_theirs = other.seen_;
+        samples_.clear();
+        samples_.reserve(k_);
+        // Each pick comes from a side with probability proportional to the
+        // part of its population not yet drawn; within a side any unpicked
+        // reservoir entry is equally likely
+        while (samples_.size() < k_ && (!mine.empty() || !theirs.empty())) {
+            const std::uint64_t total = pop_mine + pop_theirs;
+            const bool from_mine = std::uniform_int_distribution<std::uint64_t>(0, total - 1)(rng_) < pop_mine;
+            std::vector<double>& side = from_mine ? mine : theirs;
+            (from_mine ? pop_mine : pop_theirs) -= 1;
+            std::size_t pick = std::uniform_int_distribution<std::size_t>(0, side.size() - 1)(rng_);
+            samples_.push_back(side[pick]);
+            side[pick] = side.back();
+            side.pop_back();
+        }
+        seen_ += other.seen_;
+        if (samples_.size() == k_) {
+            // The threshold after n values is the k-th smallest of n uniform
+            // keys, i.e. Beta(k, n - k + 1)
+            const double a = std::gamma_distribution<double>(static_cast<double>(k_))(rng_);
+            const double b = std::gamma_distribution<double>(static_cast<double>(seen_ - k_ + 1))(rng_);
+            w_ = a / (a + b);
+            draw_skip();
+        }
+    }
+
+    const std::vector<double>& samples() const { return samples_; }
+
+    // Mean of the sample
+    double result() const {
+        if (samples_.empty()) return 0.0;
+        double sum = 0.0;
+        for (double v : samples_) sum += v;
+        return sum / static_cast<double>(samples_.size());
+    }
+
+    std::size_t capacity() const { return k_; }
+
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(k_);
+        detail::write_rng(w, rng_);
+        w.write(samples_);
+        w.write(seen_);
+        w.write(skip_);
+        w.write(w_);
+    }
+
+    static ReservoirAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "ReservoirAggregator");
+        ReservoirAggregator agg(r.read_in<std::size_t>(0, kMaxConfigSize, "ReservoirAggregator"));
+        agg.rng_ = detail::read_rng(r);
+        r.read(agg.samples_);
+        r.read(agg.seen_);
+        r.read(agg.skip_);
+        r.read(agg.w_);
+        if (agg.samples_.size() > agg.k_) throw std::runtime_error("ReservoirAggregator::deserialize: sample exceeds k");
+        return agg;
+    }
+
+    void reset() {
+        samples_.clear();
+        seen_ = 0;
+        skip_ = 0;
+        w_ = 0.0;
+    }
+
+    std::uint64_t count() const { return seen_; }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("RSVR");
+
+    void draw_skip() {
+        skip_ = detail::clamp_skip(std::floor(std::log(detail::open_unit(rng_)) / std::log1p(-w_)));
+    }
+
+    std::size_t slot() {
+        return std::uniform_int_distribution<std::size_t>(0, k_ - 1)(rng_);
+    }
+
+    std::size_t k_;
+    std::mt19937_64 rng_;
+    std::vector<double> samples_;
+    std::uint64_t seen_ = 0;
+    std::uint64_t skip_ = 0;
+    double w_ = 0.0;
+};
+
+// Weighted sample of k outputs without replacement, each trial feeding a
+// (value, weight) pair. Efraimidis-Spirakis keys u^(1/w) with exponential
+// jumps (A-ExpJ): the weight to pass before the next insertion is drawn
+// directly. Keys are kept as log(u)/w, and merge() keeps the k largest keys
+// of the union, which is exact.
+class WeightedReservoirAggregator {
+ public:
+    explicit WeightedReservoirAggregator(std::size_t k = 1024, std::uint64_t seed = 0) :
+        k_(std::max<std::size_t>(k, 1)), rng_(make_rng(seed ^ detail::kReservoirSalt)) {
+        heap_.reserve(k_);
+    }
+
+    void begin_stream(const StreamContext& ctx) {
+        rng_ = make_rng(ctx.seed ^ detail::kReservoirSalt, ctx.stream_id);
+    }
+
+    // Non-positive weights are counted but never sampled
+    void add(double value, double weight) {
+        ++count_;
+        if (!(weight > 0.0)) return;
+        if (heap_.size() < k_) {
+            push({std::log(detail::open_unit(rng_)) / weight, value});
+            if (heap_.size() == k_) draw_jump();
+            return;
+        }
+        jump_ -= weight;
+        if (jump_ > 0.0) return;
+        // The new key is conditioned to beat the current minimum
+        const double t = std::exp(heap_.front().first * weight);
+        const double u = t + (1.0 - t) * detail::open_unit(rng_);
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<>{});
+        heap_.back() = {std::log(u) / weight, value};
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<>{});
+        draw_jump();
+    }
+
+    void add(const std::pair<double, double>& value_weight) {
+        add(value_weight.first, value_weight.second);
+    }
+
+    void merge(const WeightedReservoirAggregator& other) {
+        if (count_ == 0) {
+            *this = other;
+            return;
+        }
+        for (const Entry& e : other.heap_) {
+            if (heap_.size() < k_) {
+                push(e);
+            } else if (e.first > heap_.front().first) {
+                std::pop_heap(heap_.begin(), heap_.end(), std::greater<>{});
+                heap_.back() = e;
+                std::push_heap(heap_.begin(), heap_.end(), std::greater<>{});
+            }
+        }
+        count_ += other.count_;
+        if (heap_.size() == k_) draw_jump();
+    }
+
+    std::vector<double> samples() const {
+        std::vector<double> out;
+        out.reserve(heap_.size());
+        for (const Entry& e : heap_) out.push_back(e.second);
+        return out;
+    }
+
+    // Mean of the sample, which estimates the weight-tilted mean
+    double result() const {
+        if (heap_.empty()) return 0.0;
+        double sum = 0.0;
+        for (const Entry& e : heap_) sum += e.second;
+        return sum / static_cast<double>(heap_.size());
+    }
+
+    std::size_t capacity() const { return k_; }
+
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(k_);
+        detail::write_rng(w, rng_);
+        w.write(heap_.size());
+        for (const Entry& e : heap_) {
+            w.write(e.first);
+            w.write(e.second);
+        }
+        w.write(count_);
+        w.write(jump_);
+    }
+
+    static WeightedReservoirAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "WeightedReservoirAggregator");
+        WeightedReservoirAggregator agg(r.read_in<std::size_t>(0, kMaxConfigSize, "WeightedReservoirAggregator"));
+        agg.rng_ = detail::read_rng(r);
+        const auto n = r.read<std::size_t>();
+        if (n > agg.k_ || n > r.remaining() / 16) throw std::runtime_error("ByteReader: truncated input");
+        agg.heap_.resize(n);
+        for (Entry& e : agg.heap_) {
+            r.read(e.first);
+            r.read(e.second);
+        }
+        r.read(agg.count_);
+        r.read(agg.jump_);
+        return agg;
+    }
+
+    void reset() {
+        heap_.clear();
+        count_ = 0;
+        jump_ = 0.0;
+    }
+
+    std::uint64_t count() const { return count_; }
+
+ private:
+    using Entry = std::pair<double, double>;  // (log key, value)
+
+    static constexpr std::uint32_t kTag = fourcc("WRSV");
+
+    void push(const Entry& e) {
+        heap_.push_back(e);
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<>{});
+    }
+
+    // Weight to skip: log(r) / log(T) with T the smallest key
+    void draw_jump() {
+        const double min_key = heap_.front().first;
+        jump_ = min_key < 0.0 ? std::log(detail::open_unit(rng_)) / min_key
+                              : std::numeric_limits<double>::infinity();
+    }
+
+    std::size_t k_;
+    std::mt19937_64 rng_;
+    std::vector<Entry> heap_;  // min-heap on the key
+    std::uint64_t count_ = 0;
+    double jump_ = 0.0;
+};
+
+} // namespace montecarlo
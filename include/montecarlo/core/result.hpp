@@ -1,14 +1,52 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
 #include <vector>
+#include "bytes.hpp"
 
 namespace montecarlo {
+// One worker's share of a run
+struct WorkerStats {
+    std::uint64_t trials{};
+    double elapsed_ms{};  // running trials, after seeding
+    double throughput{};  // trials per second
+};
+
+// Where a run's time went, filled in by execution policies that report it
+struct RunStats {
+    double setup_ms{};  // per-worker copies, thread start and seeding, until the last worker starts
+    double merge_ms{};  // folding per-worker aggregators together
+    std::vector<WorkerStats> workers;
+};
+
 struct Result {
     double estimate{};
     double variance{};
     double standard_error{};
     std::uint64_t iterations{};
     double elapsed_ms{};
+    double setup_ms{};
+    double merge_ms{};
+    std::vector<WorkerStats> workers;  // empty if the policy does not report them
+};
+
+// Result plus the aggregator that produced it, for statistics beyond the
+// scalar summary (quantiles, histograms, TupleAggregator members)
+template<typename Aggregator>
+struct AggregateResult : Result {
+    Aggregator aggregator;
+
+    template<std::size_t I>
+    const auto& get() const { return aggregator.template get<I>(); }
+
+    template<typename A>
+    const A& get() const { return aggregator.template get<A>(); }
 };
 
 struct ConfidenceInterval {
@@ -53,6 +91,54 @@ class WelfordAggregator {
         m2_ += delta * delta2;
     }
 
+    // Batch path: shifted sums over fixed-size blocks accumulate in
+    // independent lanes (no division, no loop-carried dependency), then each
+    // block is folded into the running state with Chan's merge.
+    void add_batch(std::span<const T> values) {
+        constexpr std::size_t kBlock = 1024;
+        constexpr std::size_t kLanes = 8;
+        std::size_t i = 0;
+        while (i < values.size()) {
+            const std::size_t n = std::min(kBlock, values.size() - i);
+            const T* x = values.data() + i;
+            // Shift by the current mean (or the first value) to keep the
+            // sum of squares well conditioned
+            const double shift = count_ > 0 ? mean_ : static_cast<double>(x[0]);
+
+            double s1[kLanes] = {};
+            double s2[kLanes] = {};
+            std::size_t j = 0;
+            for (; j + kLanes <= n; j += kLanes) {
+                for (std::size_t l = 0; l < kLanes; ++l) {
+                    double d = static_cast<double>(x[j + l]) - shift;
+                    s1[l] += d;
+                    s2[l] += d * d;
+                }
+            }
+            for (; j < n; ++j) {
+                double d = static_cast<double>(x[j]) - shift;
+                s1[0] += d;
+                s2[0] += d * d;
+            }
+            // Pairwise fold of the lanes
+            for (std::size_t w = kLanes / 2; w > 0; w /= 2) {
+                for (std::size_t l = 0; l < w; ++l) {
+                    s1[l] += s1[l + w];
+                    s2[l] += s2[l + w];
+                }
+            }
+
+            const double bn = static_cast<double>(n);
+            const double block_mean_offset = s1[0] / bn;
+            WelfordAggregator block;
+            block.count_ = n;
+            block.mean_ = shift + block_mean_offset;
+            block.m2_ = std::max(0.0, s2[0] - s1[0] * block_mean_offset);
+            merge(block);
+            i += n;
+        }
+    }
+
     double result() const {
         return mean_;
     }
@@ -82,6 +168,22 @@ class WelfordAggregator {
         count_ += other.count_;
     }
 
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(mean_);
+        w.write(m2_);
+        w.write(count_);
+    }
+
+    static WelfordAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "WelfordAggregator");
+        WelfordAggregator agg;
+        r.read(agg.mean_);
+        r.read(agg.m2_);
+        r.read(agg.count_);
+        return agg;
+    }
+
     void reset() {
         mean_ = 0.0;
         m2_ = 0.0;
@@ -91,6 +193,8 @@ class WelfordAggregator {
     std::uint64_t count() const { return count_; }
 
  private:
+    static constexpr std::uint32_t kTag = fourcc("WELF");
+
     double mean_ = 0.0;
     double m2_ = 0.0;
     std::uint64_t count_ = 0;
@@ -119,15 +223,176 @@ class HistogramAggregator {
 
     const std::vector<size_t>& histogram() const { return bins_; }
 
+    // Bin-wise merge; both sides must share the same bin layout
+    void merge(const HistogramAggregator& other) {
+        if (other.bins_.size() != bins_.size() || other.min_ != min_ || other.max_ != max_) {
+            throw std::invalid_argument("HistogramAggregator::merge: bin layouts differ");
+        }
+        size_t* dst = bins_.data();
+        const size_t* src = other.bins_.data();
+        for (size_t i = 0; i < bins_.size(); ++i) {
+            dst[i] += src[i];
+        }
+        count_ += other.count_;
+    }
+
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(min_);
+        w.write(max_);
+        w.write(bins_);
+        w.write(count_);
+    }
+
+    static HistogramAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "HistogramAggregator");
+        const double min = r.read_finite("HistogramAggregator");
+        const double max = r.read_finite("HistogramAggregator");
+        std::vector<size_t> bins;
+        r.read(bins);
+        HistogramAggregator agg(bins.size(), min, max);
+        agg.bins_ = std::move(bins);
+        r.read(agg.count_);
+        return agg;
+    }
+
     void reset() {
         std::fill(bins_.begin(), bins_.end(), 0);
         count_ = 0;
     }
 
+    // Includes values that fell outside [min, max)
+    std::uint64_t count() const { return count_; }
+
  private:
+    static constexpr std::uint32_t kTag = fourcc("HIST");
+
     std::vector<size_t> bins_;
     double min_, max_, bin_width_;
     size_t count_ = 0;
 };
 
+// Fixed-range histogram whose copies all share one set of atomic bins.
+// Under Parallel every worker holds a copy, so workers count straight into
+// the shared bins and the final merge is free -- worthwhile at high thread
+// counts with small bin arrays, where replaying T private arrays costs
+// more than the atomics. add_batch() pre-counts each block privately and
+// issues one relaxed fetch_add per touched bin; bins sit on their own cache
+// lines so workers hitting neighbouring bins do not false-share.
+template<typename T = double>
+class SharedHistogramAggregator {
+ public:
+    explicit SharedHistogramAggregator(size_t bins = 100, double min = 0.0,
+        double max = 1.0): state_(std::make_shared<State>(bins)),
+        scratch_(bins, 0), min_(min), max_(max),
+        bin_width_((max - min) / bins) {}
+
+    void add(T value) {
+        if (value >= min_ && value < max_) {
+            size_t idx = static_cast<size_t>((value - min_) / bin_width_);
+            if (idx < state_->bins.size()) {
+                state_->bins[idx].n.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        state_->count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void add_batch(std::span<const T> values) {
+        for (T value : values) {
+            if (value >= min_ && value < max_) {
+                size_t idx = static_cast<size_t>((value - min_) / bin_width_);
+                if (idx < scratch_.size()) {
+                    scratch_[idx]++;
+                }
+            }
+        }
+        for (size_t i = 0; i < scratch_.size(); ++i) {
+            if (scratch_[i] != 0) {
+                state_->bins[i].n.fetch_add(scratch_[i], std::memory_order_relaxed);
+                scratch_[i] = 0;
+            }
+        }
+        state_->count.fetch_add(values.size(), std::memory_order_relaxed);
+    }
+
+    double result() const {
+        return static_cast<double>(count());
+    }
+
+    // Snapshot of the shared bins
+    std::vector<std::uint64_t> histogram() const {
+        std::vector<std::uint64_t> out(state_->bins.size());
+        for (size_t i = 0; i < out.size(); ++i) {
+            out[i] = state_->bins[i].n.load(std::memory_order_relaxed);
+        }
+        return out;
+    }
+
+    // Copies share storage, so merging one is a no-op
+    void merge(const SharedHistogramAggregator& other) {
+        if (other.state_ == state_) return;
+        if (other.state_->bins.size() != state_->bins.size() || other.min_ != min_ || other.max_ != max_) {
+            throw std::invalid_argument("SharedHistogramAggregator::merge: bin layouts differ");
+        }
+        for (size_t i = 0; i < state_->bins.size(); ++i) {
+            state_->bins[i].n.fetch_add(other.state_->bins[i].n.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        }
+        state_->count.fetch_add(other.count(), std::memory_order_relaxed);
+    }
+
+    // Writes a snapshot of the shared bins; the deserialised aggregator owns
+    // fresh storage
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(min_);
+        w.write(max_);
+        w.write(histogram());
+        w.write(count());
+    }
+
+    static SharedHistogramAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "SharedHistogramAggregator");
+        const double min = r.read_finite("SharedHistogramAggregator");
+        const double max = r.read_finite("SharedHistogramAggregator");
+        std::vector<std::uint64_t> bins;
+        r.read(bins);
+        SharedHistogramAggregator agg(bins.size(), min, max);
+        for (size_t i = 0; i < bins.size(); ++i) {
+            agg.state_->bins[i].n.store(bins[i], std::memory_order_relaxed);
+        }
+        agg.state_->count.store(r.read<std::uint64_t>(), std::memory_order_relaxed);
+        return agg;
+    }
+
+    // Clears the bins seen by every copy
+    void reset() {
+        for (auto& bin : state_->bins) {
+            bin.n.store(0, std::memory_order_relaxed);
+        }
+        state_->count.store(0, std::memory_order_relaxed);
+    }
+
+    std::uint64_t count() const {
+        return state_->count.load(std::memory_order_relaxed);
+    }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("SHST");
+
+    struct alignas(64) Bin {
+        std::atomic<std::uint64_t> n{0};
+    };
+
+    struct State {
+        explicit State(size_t bins) : bins(bins) {}
+        std::vector<Bin> bins;
+        alignas(64) std::atomic<std::uint64_t> count{0};
+    };
+
+    std::shared_ptr<State> state_;
+    std::vector<std::uint64_t> scratch_;
+    double min_, max_, bin_width_;
+};
+
 } // namespace montecarlo
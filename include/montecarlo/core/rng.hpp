@@ -4,6 +4,23 @@
 
 namespace montecarlo {
 
+namespace detail {
+
+// splitmix64 finaliser
+inline std::uint64_t splitmix64(std::uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+// Seed for the index-th independent piece of a run (a batch contract, a
+// bootstrap chunk) drawn from one base seed
+inline std::uint64_t derive_seed(std::uint64_t seed, std::uint64_t index) {
+    return splitmix64(seed + 0x9e3779b97f4a7c15ULL * (index + 1));
+}
+
+} // namespace detail
+
 // Better parallel seeding using seed sequences
 inline std::mt19937_64 make_rng(std::uint64_t seed,
                                 std::uint64_t stream_id = 0) {
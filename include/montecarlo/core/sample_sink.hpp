@@ -0,0 +1,239 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "concepts.hpp"
+#include "result.hpp"
+#include "../io/sample_file.hpp"
+
+namespace montecarlo {
+
+// Writes every trial output to a columnar sample file (io/sample_file.hpp)
+// while estimating the mean like WelfordAggregator. Copies share one
+// thread-safe writer, so under Parallel each worker buffers its own
+// contiguous trials and appends them as whole blocks tagged with its
+// stream id and first trial index -- no locking per sample and no
+// interleaving. A block is written when the buffer fills, when the worker
+// is merged, and when a copy is taken or destroyed.
+//
+// With async_buffers > 0 the writes move to the writer's background
+// thread: each copy connects its own channel, a full buffer is swapped for
+// a recycled one and the worker carries on at once; it only waits when
+// all async_buffers of its buffers are queued behind the disk.
+//
+// With a compression codec each block is encoded by whoever writes it (the
+// background thread when async); the moments still see the exact values.
+//
+// The file is complete once close() is called or the last copy goes away;
+// reset() truncates it. Open the result with io::SampleFile::open().
+class SampleSinkAggregator {
+ public:
+    explicit SampleSinkAggregator(std::string path, bool trial_index = false,
+                                  std::size_t block_values = std::size_t{1} << 16, std::size_t async_buffers = 0,
+                                  io::SampleCompression compression = {}) :
+        writer_(std::make_shared<io::SampleFileWriter>(std::move(path), trial_index, async_buffers, compression)),
+        block_values_(std::max<std::size_t>(block_values, 1)) {}
+
+    // A copy starts with an empty buffer and no channel, so the source's
+    // buffer is written out first
+    SampleSinkAggregator(const SampleSinkAggregator& other) :
+        writer_(other.writer_), block_values_(other.block_values_), stream_id_(other.stream_id_),
+        moments_(other.moments_) {
+        other.flush();
+        next_trial_ = other.next_trial_;
+    }
+
+    SampleSinkAggregator& operator=(const SampleSinkAggregator& other) {
+        if (this != &other) {
+            flush();
+            other.flush();
+            channel_.reset();
+            writer_ = other.writer_;
+            block_values_ = other.block_values_;
+            stream_id_ = other.stream_id_;
+            next_trial_ = other.next_trial_;
+            moments_ = other.moments_;
+        }
+        return *this;
+    }
+
+    SampleSinkAggregator(SampleSinkAggregator&&) noexcept = default;
+
+    SampleSinkAggregator& operator=(SampleSinkAggregator&& other) {
+        if (this != &other) {
+            flush();
+            channel_ = std::move(other.channel_);
+            writer_ = std::move(other.writer_);
+            block_values_ = other.block_values_;
+            stream_id_ = other.stream_id_;
+            next_trial_ = other.next_trial_;
+            pending_ = std::move(other.pending_);
+            other.pending_.clear();
+            moments_ = other.moments_;
+        }
+        return *this;
+    }
+
+    ~SampleSinkAggregator() {
+        try {
+            flush();
+        } catch (...) {
+            // Destructors must not throw; the block is lost
+        }
+    }
+
+    void begin_stream(const StreamContext& ctx) {
+        flush();
+        stream_id_ = ctx.stream_id;
+        next_trial_ = ctx.first_trial;
+    }
+
+    void add(double value) {
+        pending_.push_back(value);
+        moments_.add(value);
+        if (pending_.size() >= block_values_) flush();
+    }
+
+    void add_batch(std::span<const double> values) {
+        moments_.add_batch(values);
+        while (!values.empty()) {
+            const std::size_t n = std::min(values.size(), block_values_ - pending_.size());
+            pending_.insert(pending_.end(), values.begin(), values.begin() + static_cast<std::ptrdiff_t>(n));
+            values = values.subspan(n);
+            if (pending_.size() >= block_values_) flush();
+        }
+    }
+
+    // Same file: write out the other worker's buffer. Another file: copy
+    // its blocks across.
+    void merge(const SampleSinkAggregator& other) {
+        other.flush();
+        if (other.writer_ != writer_) writer_->append_file(*other.writer_);
+        moments_.merge(other.moments_);
+    }
+
+    // Write pending values and finish the file; copies sharing it must not
+    // add afterwards
+    void close() {
+        flush();
+        writer_->finish();
+    }
+
+    const std::string& path() const { return writer_->path(); }
+
+    double result() const { return moments_.result(); }
+    double variance() const { return moments_.variance(); }
+    double std_error() const { return moments_.std_error(); }
+
+    // Flushes pending values first, then records where the file stands;
+    // deserialize() reopens the file at that point and drops anything
+    // written after it, so a restored sink continues the same file
+    void serialize(ByteWriter& w) const {
+        flush();
+        writer_->flush();
+        w.tag(kTag);
+        w.write(writer_->path());
+        w.write(writer_->flags());
+        w.write(block_values_);
+        w.write(writer_->async_buffers());
+        w.write(static_cast<std::uint32_t>(writer_->compression().codec));
+        w.write(writer_->compression().mantissa_bits);
+        w.write(stream_id_);
+        w.write(next_trial_);
+        moments_.serialize(w);
+        const std::vector<io::SampleBlockEntry> index = writer_->index();
+        w.write(index.size());
+        for (const io::SampleBlockEntry& e : index) {
+            w.write(e.offset);
+            w.write(e.count);
+            w.write(e.stream_id);
+            w.write(e.first_trial);
+        }
+        w.write(writer_->data_end());
+    }
+
+    static SampleSinkAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "SampleSinkAggregator");
+        std::string path;
+        r.read(path);
+        const auto flags = r.read<std::uint32_t>();
+        const auto block_values = r.read<std::size_t>();
+        // Each async buffer is allocated up front by the writer's channel
+        const auto async_buffers = r.read_in<std::size_t>(0, kMaxAsyncBuffers, "SampleSinkAggregator");
+        io::SampleCompression compression;
+        compression.codec = static_cast<io::SampleCodec>(r.read_in<std::uint32_t>(
+            0, static_cast<std::uint32_t>(io::SampleCodec::Xor), "SampleSinkAggregator"));
+        r.read(compression.mantissa_bits);
+        std::uint64_t stream_id = 0;
+        std::uint64_t next_trial = 0;
+        r.read(stream_id);
+        r.read(next_trial);
+        WelfordAggregator<> moments = WelfordAggregator<>::deserialize(r);
+        const auto blocks = r.read<std::size_t>();
+        if (blocks > r.remaining() / 32) throw std::runtime_error("ByteReader: truncated input");
+        std::vector<io::SampleBlockEntry> index(blocks);
+        for (io::SampleBlockEntry& e : index) {
+            r.read(e.offset);
+            r.read(e.count);
+            r.read(e.stream_id);
+            r.read(e.first_trial);
+        }
+        const auto data_end = r.read<std::uint64_t>();
+        SampleSinkAggregator agg(
+            std::make_shared<io::SampleFileWriter>(std::move(path), flags, std::move(index), data_end, async_buffers,
+                                                   compression),
+            block_values);
+        agg.stream_id_ = stream_id;
+        agg.next_trial_ = next_trial;
+        agg.moments_ = moments;
+        return agg;
+    }
+
+    // Truncates the shared file
+    void reset() {
+        pending_.clear();
+        writer_->truncate();
+        stream_id_ = 0;
+        next_trial_ = 0;
+        moments_.reset();
+    }
+
+    std::uint64_t count() const { return moments_.count(); }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("SMPL");
+    static constexpr std::size_t kMaxAsyncBuffers = 1024;
+
+    SampleSinkAggregator(std::shared_ptr<io::SampleFileWriter> writer, std::size_t block_values) :
+        writer_(std::move(writer)), block_values_(std::max<std::size_t>(block_values, 1)) {}
+
+    // Pending values become one block
+    void flush() const {
+        if (pending_.empty()) return;
+        const std::size_t n = pending_.size();
+        if (writer_->async()) {
+            if (!channel_) channel_ = writer_->connect();
+            channel_->submit(stream_id_, next_trial_, pending_);  // swaps in a recycled buffer
+        } else {
+            writer_->append(stream_id_, next_trial_, pending_);
+            pending_.clear();
+        }
+        next_trial_ += n;
+    }
+
+    std::shared_ptr<io::SampleFileWriter> writer_;
+    mutable std::shared_ptr<io::SampleChannel> channel_;  // async only; destroyed before writer_
+    std::size_t block_values_;
+    std::uint64_t stream_id_ = 0;
+    mutable std::uint64_t next_trial_ = 0;
+    mutable std::vector<double> pending_;
+    WelfordAggregator<> moments_;
+};
+
+} // namespace montecarlo
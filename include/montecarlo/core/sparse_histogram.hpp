@@ -0,0 +1,455 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "bytes.hpp"
+#include "rng.hpp"
+
+namespace montecarlo {
+
+// Exact counts of integer outcomes over a wide support (loss counts,
+// defaults, ...). The bulk of the distribution lives in a dense window of
+// counters, so the hot path is a subtract, a compare and an increment; the
+// sparse tail goes to an open-addressing (linear probing) table of
+// (key, count) cells.
+//
+// The window is placed at the first value and adapts as the tail grows:
+// once the tail has collected enough distinct keys it is inspected, and
+// the window either stretches towards tail keys that would fill at least
+// a quarter of the new cells (a dense cell costs 8 bytes, a tail cell
+// about 32 at the table's load factor) or, if the tail holds most of the
+// mass, re-centres on the tail's median. The window never exceeds
+// `max_window` cells. Doubles are rounded to the nearest integer, clamped
+// to the int64 range, and NaNs dropped. Window arithmetic runs on keys
+// mapped order-preservingly to uint64, so any pair of int64 keys works.
+class SparseHistogramAggregator {
+ public:
+    explicit SparseHistogramAggregator(std::size_t window = 1024, std::size_t max_window = std::size_t{1} << 20) :
+        initial_window_(std::max<std::size_t>(window, 1)),
+        max_window_(std::max(max_window, initial_window_)),
+        next_check_(first_check()) {}
+
+    template<std::integral I>
+    void add(I value) {
+        add_count(static_cast<std::int64_t>(value), 1);
+    }
+
+    void add(double value) {
+        if (!std::isnan(value)) add_count(to_key(value), 1);
+    }
+
+    // Integer blocks; the window test and increment are inlined and only
+    // tail keys leave the loop
+    void add_batch(std::span<const std::int64_t> values) {
+        if (values.empty()) return;
+        if (window_.empty()) place(values.front());
+        std::uint64_t* cells = window_.data();
+        std::uint64_t width = window_.size();
+        std::uint64_t base = static_cast<std::uint64_t>(base_);
+        std::size_t counted = 0;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            const std::int64_t v = values[i];
+            const std::uint64_t offset = static_cast<std::uint64_t>(v) - base;
+            if (offset < width) {
+                ++cells[offset];
+            } else {
+                // Bring count_ up to date so a resize sees the true mass
+                count_ += i + 1 - counted;
+                counted = i + 1;
+                tail_add(v, 1);
+                // The window may have been resized
+                cells = window_.data();
+                width = window_.size();
+                base = static_cast<std::uint64_t>(base_);
+            }
+        }
+        count_ += values.size() - counted;
+    }
+
+    void add_batch(std::span<const double> values) {
+        std::array<std::int64_t, 256> block;
+        std::size_t n = 0;
+        for (double v : values) {
+            if (std::isnan(v)) continue;
+            block[n++] = to_key(v);
+            if (n == block.size()) {
+                add_batch(std::span<const std::int64_t>(block.data(), n));
+                n = 0;
+            }
+        }
+        add_batch(std::span<const std::int64_t>(block.data(), n));
+    }
+
+    // Identical windows add cell-wise; otherwise each non-zero cell is
+    // re-inserted
+    void merge(const SparseHistogramAggregator& other) {
+        if (other.count_ == 0) return;
+        if (count_ == 0) {
+            *this = other;
+            return;
+        }
+        if (other.base_ == base_ && other.window_.size() == window_.size()) {
+            for (std::size_t i = 0; i < window_.size(); ++i) window_[i] += other.window_[i];
+            count_ += other.count_ - other.tail_count_;
+        } else {
+            for (std::size_t i = 0; i < other.window_.size(); ++i) {
+                if (other.window_[i] != 0) add_count(other.key_at(i), other.window_[i]);
+            }
+        }
+        for (const Cell& c : other.table_) {
+            if (c.n != 0) add_count(c.key, c.n);
+        }
+    }
+
+    // Occurrences of `key`
+    std::uint64_t count_of(std::int64_t key) const {
+        const std::uint64_t offset = static_cast<std::uint64_t>(key) - static_cast<std::uint64_t>(base_);
+        if (offset < window_.size()) return window_[offset];
+        if (table_.empty()) return 0;
+        for (std::size_t i = hash(key) & mask_;; i = (i + 1) & mask_) {
+            if (table_[i].n == 0) return 0;
+            if (table_[i].key == key) return table_[i].n;
+        }
+    }
+
+    // Visit (key, count) for every key seen, in ascending key order
+    template<typename F>
+    void for_each(F&& f) const {
+        const std::vector<Cell> tail = sorted_tail();
+        auto it = tail.begin();
+        for (; it != tail.end() && it->key < base_; ++it) f(it->key, it->n);
+        for (std::size_t i = 0; i < window_.size(); ++i) {
+            if (window_[i] != 0) f(key_at(i), window_[i]);
+        }
+        for (; it != tail.end(); ++it) f(it->key, it->n);
+    }
+
+    std::vector<std::pair<std::int64_t, std::uint64_t>> counts() const {
+        std::vector<std::pair<std::int64_t, std::uint64_t>> out;
+        for_each([&](std::int64_t key, std::uint64_t n) { out.emplace_back(key, n); });
+        return out;
+    }
+
+    // Smallest key whose cumulative count reaches q * count (inverse ECDF)
+    std::int64_t quantile(double q) const {
+        const double target = std::clamp(q, 0.0, 1.0) * static_cast<double>(count_);
+        std::uint64_t running = 0;
+        std::int64_t out = 0;
+        bool found = false;
+        for_each([&](std::int64_t key, std::uint64_t n) {
+            if (found) return;
+            running += n;
+            out = key;
+            found = static_cast<double>(running) >= target;
+        });
+        return out;
+    }
+
+    double result() const {
+        double mean = 0.0;
+        for_each([&](std::int64_t key, std::uint64_t n) {
+            mean += static_cast<double>(key) * static_cast<double>(n);
+        });
+        return count_ > 0 ? mean / static_cast<double>(count_) : 0.0;
+    }
+
+    // Two passes over the distinct keys
+    double variance() const {
+        if (count_ < 2) return 0.0;
+        const double mean = result();
+        double m2 = 0.0;
+        for_each([&](std::int64_t key, std::uint64_t n) {
+            const double d = static_cast<double>(key) - mean;
+            m2 += d * d * static_cast<double>(n);
+        });
+        return m2 / static_cast<double>(count_ - 1);
+    }
+
+    double std_error() const {
+        return count_ > 0 ? std::sqrt(variance() / static_cast<double>(count_)) : 0.0;
+    }
+
+    // Number of distinct keys seen
+    std::size_t distinct() const {
+        std::size_t n = tail_size_;
+        for (std::uint64_t c : window_) n += c != 0;
+        return n;
+    }
+
+    // Current dense window [first, first + size)
+    std::int64_t window_begin() const { return base_; }
+    std::size_t window_size() const { return window_.size(); }
+    std::size_t tail_size() const { return tail_size_; }
+
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(initial_window_);
+        w.write(max_window_);
+        w.write(base_);
+        w.write(window_);
+        const std::vector<Cell> tail = sorted_tail();
+        w.write(tail.size());
+        for (const Cell& c : tail) {
+            w.write(c.key);
+            w.write(c.n);
+        }
+        w.write(count_);
+    }
+
+    static SparseHistogramAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "SparseHistogramAggregator");
+        const auto window = r.read_in<std::size_t>(0, kMaxConfigSize, "SparseHistogramAggregator");
+        SparseHistogramAggregator agg(window, r.read_in<std::size_t>(0, kMaxConfigSize, "SparseHistogramAggregator"));
+        r.read(agg.base_);
+        r.read(agg.window_);
+        if (agg.window_.size() > agg.max_window_) throw std::runtime_error("SparseHistogramAggregator: window too large");
+        const auto tail = r.read<std::size_t>();
+        if (tail > r.remaining() / 16) throw std::runtime_error("ByteReader: truncated input");
+        std::vector<Cell> cells(tail);
+        for (Cell& c : cells) {
+            r.read(c.key);
+            r.read(c.n);
+        }
+        agg.rebuild_tail(cells);
+        r.read(agg.count_);
+        agg.next_check_ = std::max(agg.first_check(), 2 * agg.tail_size_);
+        return agg;
+    }
+
+    void reset() {
+        window_.clear();
+        base_ = 0;
+        table_.clear();
+        mask_ = 0;
+        tail_size_ = 0;
+        tail_count_ = 0;
+        count_ = 0;
+        next_check_ = first_check();
+    }
+
+    std::uint64_t count() const { return count_; }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("SPHS");
+    // Dense cells must be at least 1/kMinFill occupied to replace tail cells
+    static constexpr std::uint64_t kMinFill = 4;
+
+    struct Cell {
+        std::int64_t key;
+        std::uint64_t n;  // 0 marks an empty slot
+    };
+
+    std::size_t first_check() const { return std::max<std::size_t>(64, initial_window_ / 8); }
+
+    std::int64_t key_at(std::size_t i) const {
+        return static_cast<std::int64_t>(static_cast<std::uint64_t>(base_) + i);
+    }
+
+    // Nearest integer; llround is unspecified outside the int64 range
+    static std::int64_t to_key(double value) {
+        constexpr double kTop = 9223372036854775808.0;  // 2^63
+        if (value >= kTop) return std::numeric_limits<std::int64_t>::max();
+        if (value < -kTop) return std::numeric_limits<std::int64_t>::min();
+        return std::llround(value);
+    }
+
+    // Order-preserving map of int64 keys onto uint64, where distances
+    // between keys cannot overflow
+    static std::uint64_t biased(std::int64_t key) {
+        return static_cast<std::uint64_t>(key) ^ (std::uint64_t{1} << 63);
+    }
+
+    static std::int64_t unbiased(std::uint64_t key) {
+        return static_cast<std::int64_t>(key ^ (std::uint64_t{1} << 63));
+    }
+
+    // Start of a `width`-cell window around `centre` that stays inside the
+    // key range
+    static std::int64_t window_start(std::int64_t centre, std::uint64_t width) {
+        const std::uint64_t c = biased(centre);
+        const std::uint64_t lo = c >= width / 2 ? c - width / 2 : 0;
+        return unbiased(std::min(lo, std::numeric_limits<std::uint64_t>::max() - (width - 1)));
+    }
+
+    void place(std::int64_t centre) {
+        base_ = window_start(centre, initial_window_);
+        window_.assign(initial_window_, 0);
+    }
+
+    void add_count(std::int64_t key, std::uint64_t n) {
+        if (window_.empty()) place(key);
+        const std::uint64_t offset = static_cast<std::uint64_t>(key) - static_cast<std::uint64_t>(base_);
+        if (offset < window_.size()) {
+            window_[offset] += n;
+        } else {
+            tail_add(key, n);
+        }
+        count_ += n;
+    }
+
+    static std::size_t hash(std::int64_t key) {
+        return static_cast<std::size_t>(detail::splitmix64(static_cast<std::uint64_t>(key)));
+    }
+
+    // Bumps tail_count_ but not count_
+    void tail_add(std::int64_t key, std::uint64_t n) {
+        tail_count_ += n;
+        if (table_.empty()) rehash(16);
+        std::size_t i = hash(key) & mask_;
+        for (; table_[i].n != 0; i = (i + 1) & mask_) {
+            if (table_[i].key == key) {
+                table_[i].n += n;
+                return;
+            }
+        }
+        table_[i] = {key, n};
+        // Keep the load factor at or below one half
+        if (2 * ++tail_size_ > table_.size()) rehash(2 * table_.size());
+        if (tail_size_ >= next_check_) adapt();
+    }
+
+    void rehash(std::size_t capacity) {
+        std::vector<Cell> old = std::move(table_);
+        table_.assign(capacity, Cell{0, 0});
+        mask_ = capacity - 1;
+        for (const Cell& c : old) {
+            if (c.n == 0) continue;
+            std::size_t i = hash(c.key) & mask_;
+            while (table_[i].n != 0) i = (i + 1) & mask_;
+            table_[i] = c;
+        }
+    }
+
+    void rebuild_tail(const std::vector<Cell>& cells) {
+        std::size_t capacity = 16;
+        while (capacity < 2 * cells.size() + 2) capacity <<= 1;
+        table_.assign(capacity, Cell{0, 0});
+        mask_ = capacity - 1;
+        tail_size_ = 0;
+        tail_count_ = 0;
+        for (const Cell& c : cells) {
+            std::size_t i = hash(c.key) & mask_;
+            while (table_[i].n != 0) i = (i + 1) & mask_;
+            table_[i] = c;
+            ++tail_size_;
+            tail_count_ += c.n;
+        }
+    }
+
+    std::vector<Cell> sorted_tail() const {
+        std::vector<Cell> tail;
+        tail.reserve(tail_size_);
+        for (const Cell& c : table_) {
+            if (c.n != 0) tail.push_back(c);
+        }
+        std::sort(tail.begin(), tail.end(), [](const Cell& a, const Cell& b) { return a.key < b.key; });
+        return tail;
+    }
+
+    // Stretch or move the window to absorb the tail where that pays
+    void adapt() {
+        const std::vector<Cell> tail = sorted_tail();
+        const std::uint64_t width = window_.size();
+        const std::uint64_t base = biased(base_);
+
+        if (2 * tail_count_ > count_) {
+            // Most of the mass is in the tail: re-centre on its median
+            std::uint64_t running = 0;
+            std::int64_t median = tail.back().key;
+            for (const Cell& c : tail) {
+                running += c.n;
+                if (2 * running >= tail_count_) {
+                    median = c.key;
+                    break;
+                }
+            }
+            relocate(window_start(median, width), static_cast<std::size_t>(width), tail);
+            next_check_ = std::max(first_check(), 2 * tail_size_);
+            return;
+        }
+
+        // Furthest tail key on each side that keeps the fill rate, as cells
+        // to add below and above the window
+        const auto split = std::lower_bound(tail.begin(), tail.end(), base_,
+            [](const Cell& c, std::int64_t key) { return c.key < key; });
+        std::uint64_t below = 0;
+        std::uint64_t above = 0;
+        std::uint64_t taken = 0;
+        for (auto it = std::make_reverse_iterator(split); it != tail.rend(); ++it) {
+            ++taken;
+            const std::uint64_t grown = base - biased(it->key);
+            if (grown > max_window_ - width) break;
+            if (taken * kMinFill >= grown) below = grown;
+        }
+        taken = 0;
+        for (auto it = split; it != tail.end(); ++it) {
+            ++taken;
+            const std::uint64_t grown = biased(it->key) - (base + (width - 1));
+            if (grown > max_window_ - width - below) break;
+            if (taken * kMinFill >= grown) above = grown;
+        }
+        if (below == 0 && above == 0) {
+            // Nothing worth absorbing yet; look again once the tail doubles
+            next_check_ = 2 * tail_size_;
+            return;
+        }
+        // Grow at least geometrically so repeated stretches stay amortised,
+        // without leaving the key range
+        const std::uint64_t size = width + below + above;
+        const std::uint64_t extra = std::min<std::uint64_t>(max_window_, std::max(size, 2 * width)) - size;
+        if (below > 0 && above > 0) {
+            below += extra / 2;
+            above += extra - extra / 2;
+        } else if (below > 0) {
+            below += extra;
+        } else {
+            above += extra;
+        }
+        below = std::min(below, base);
+        above = std::min(above, std::numeric_limits<std::uint64_t>::max() - base - (width - 1));
+        relocate(unbiased(base - below), static_cast<std::size_t>(width + below + above), tail);
+        next_check_ = std::max(first_check(), 2 * tail_size_);
+    }
+
+    // Move every count into the window [lo, lo + width) or the tail
+    void relocate(std::int64_t lo, std::size_t width, const std::vector<Cell>& tail) {
+        std::vector<std::uint64_t> window(width, 0);
+        std::vector<Cell> rest;
+        auto put = [&](std::int64_t key, std::uint64_t n) {
+            const std::uint64_t offset = static_cast<std::uint64_t>(key) - static_cast<std::uint64_t>(lo);
+            if (offset < width) {
+                window[offset] += n;
+            } else {
+                rest.push_back({key, n});
+            }
+        };
+        for (std::size_t i = 0; i < window_.size(); ++i) {
+            if (window_[i] != 0) put(key_at(i), window_[i]);
+        }
+        for (const Cell& c : tail) put(c.key, c.n);
+        window_ = std::move(window);
+        base_ = lo;
+        rebuild_tail(rest);
+    }
+
+    std::size_t initial_window_;
+    std::size_t max_window_;
+    std::int64_t base_ = 0;
+    std::vector<std::uint64_t> window_;  // empty until the first value
+    std::vector<Cell> table_;
+    std::size_t mask_ = 0;
+    std::size_t tail_size_ = 0;
+    std::uint64_t tail_count_ = 0;
+    std::uint64_t count_ = 0;
+    std::size_t next_check_;
+};
+
+} // namespace montecarlo
@@ -0,0 +1,213 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <span>
+#include <vector>
+#include "concepts.hpp"
+
+namespace montecarlo {
+
+// Exact empirical Value-at-Risk and Expected Shortfall in O(k) memory.
+//
+// With N trials and k = ceil((1 - alpha) * N), VaR is the k-th worst value
+// and ES the mean of the k worst. Under an execution policy N is known from
+// the StreamContext, so each worker keeps its k worst values in a bounded
+// min-heap; the global k worst are always among the union of the workers'
+// heaps, so merging them is exact.
+//
+// When N is not known up front, use the two-pass threshold scheme: a cheap
+// pilot (e.g. a TDigestAggregator quantile with some margin) supplies a
+// threshold below VaR, and the aggregator keeps every value beyond it.
+// exact() reports whether the threshold was conservative enough.
+//
+// A standalone instance built without expected_trials and never given a
+// stream has no bound to size its heap from, so it keeps every value.
+class TailAggregator {
+ public:
+    enum class Tail { upper, lower };
+
+    // upper: large values are losses (default); lower: small values are
+    // (e.g. P&L). expected_trials sizes the heap for standalone use.
+    explicit TailAggregator(double alpha = 0.99, Tail tail = Tail::upper,
+                            std::uint64_t expected_trials = 0) :
+        alpha_(std::clamp(alpha, 0.0, 1.0)), tail_(tail) {
+        if (expected_trials > 0) capacity_ = tail_size(expected_trials);
+        initial_capacity_ = capacity_;
+    }
+
+    // Threshold mode: keep every value at or beyond `threshold`
+    static TailAggregator beyond(double threshold, double alpha = 0.99, Tail tail = Tail::upper) {
+        TailAggregator agg(alpha, tail);
+        agg.threshold_ = agg.key(threshold);
+        agg.use_threshold_ = true;
+        return agg;
+    }
+
+    void begin_stream(const StreamContext& ctx) {
+        if (!use_threshold_) capacity_ = tail_size(ctx.run_trials);
+    }
+
+    void add(double value) {
+        ++count_;
+        offer(key(value));
+    }
+
+    // Once the heap is full, most values fail the cut-off test, which runs
+    // as a tight branch over the block
+    void add_batch(std::span<const double> values) {
+        count_ += values.size();
+        for (double v : values) {
+            double k = key(v);
+            if (k > cutoff()) offer(k);
+        }
+    }
+
+    // The merged heap is sized for the larger of the two runs (unsized
+    // counts as larger); a fresh merge target takes the workers' size
+    void merge(const TailAggregator& other) {
+        if (!use_threshold_) {
+            if (capacity_ == 0 && count_ == 0) {
+                capacity_ = other.capacity_;
+            } else if (capacity_ > 0) {
+                capacity_ = other.capacity_ == 0 ? 0 : std::max(capacity_, other.capacity_);
+            }
+        }
+        for (double k : other.heap_) {
+            offer(k);
+        }
+        count_ += other.count_;
+    }
+
+    // k = ceil((1 - alpha) * N) for the trials seen so far
+    std::uint64_t tail_size() const {
+        return tail_size(count_);
+    }
+
+    // The k-th worst value
+    double value_at_risk() const {
+        std::vector<double> worst = sorted_worst();
+        if (worst.empty()) return 0.0;
+        return value(worst.back());
+    }
+
+    // Mean of the k worst values
+    double expected_shortfall() const {
+        std::vector<double> worst = sorted_worst();
+        if (worst.empty()) return 0.0;
+        double sum = 0.0;
+        for (double k : worst) sum += k;
+        return value(sum / static_cast<double>(worst.size()));
+    }
+
+    double result() const {
+        return expected_shortfall();
+    }
+
+    // False if fewer than k values were retained (threshold mode with a
+    // threshold beyond VaR, or a heap sized for fewer trials than were run)
+    bool exact() const {
+        return heap_.size() >= tail_size();
+    }
+
+    // Worst values first, in the original sign convention
+    std::vector<double> tail() const {
+        std::vector<double> worst = sorted_worst();
+        for (double& k : worst) k = value(k);
+        return worst;
+    }
+
+    double alpha() const { return alpha_; }
+    std::size_t retained() const { return heap_.size(); }
+
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(alpha_);
+        w.write(tail_ == Tail::upper ? 0 : 1);
+        w.write(capacity_);
+        w.write(initial_capacity_);
+        w.write(use_threshold_);
+        w.write(threshold_);
+        w.write(heap_);
+        w.write(count_);
+    }
+
+    static TailAggregator deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "TailAggregator");
+        const double alpha = r.read_in<double>(0.0, 1.0, "TailAggregator");
+        TailAggregator agg(alpha, r.read<int>() == 0 ? Tail::upper : Tail::lower);
+        r.read(agg.capacity_);
+        r.read(agg.initial_capacity_);
+        r.read(agg.use_threshold_);
+        r.read(agg.threshold_);
+        r.read(agg.heap_);
+        r.read(agg.count_);
+        if (!agg.use_threshold_) std::make_heap(agg.heap_.begin(), agg.heap_.end(), std::greater<>{});
+        return agg;
+    }
+
+    // Back to the heap size given at construction
+    void reset() {
+        heap_.clear();
+        count_ = 0;
+        capacity_ = initial_capacity_;
+    }
+
+    std::uint64_t count() const { return count_; }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("TAIL");
+
+    std::uint64_t tail_size(std::uint64_t n) const {
+        if (n == 0) return 0;
+        double k = std::ceil((1.0 - alpha_) * static_cast<double>(n) - 1e-9);
+        return std::max<std::uint64_t>(1, static_cast<std::uint64_t>(k));
+    }
+
+    // Internally the worst values are always the largest keys
+    double key(double value) const { return tail_ == Tail::upper ? value : -value; }
+    double value(double key) const { return tail_ == Tail::upper ? key : -key; }
+
+    double cutoff() const {
+        if (use_threshold_) return std::nextafter(threshold_, -std::numeric_limits<double>::infinity());
+        return capacity_ == 0 || heap_.size() < capacity_ ? -std::numeric_limits<double>::infinity()
+                                                          : heap_.front();
+    }
+
+    void offer(double k) {
+        if (use_threshold_) {
+            if (k >= threshold_) heap_.push_back(k);
+            return;
+        }
+        if (capacity_ == 0 || heap_.size() < capacity_) {  // unsized: keep everything
+            heap_.push_back(k);
+            std::push_heap(heap_.begin(), heap_.end(), std::greater<>{});
+        } else if (k > heap_.front()) {
+            std::pop_heap(heap_.begin(), heap_.end(), std::greater<>{});
+            heap_.back() = k;
+            std::push_heap(heap_.begin(), heap_.end(), std::greater<>{});
+        }
+    }
+
+    // The k largest keys, largest first
+    std::vector<double> sorted_worst() const {
+        std::vector<double> worst = heap_;
+        std::sort(worst.begin(), worst.end(), std::greater<>{});
+        worst.resize(std::min<std::size_t>(worst.size(), tail_size()));
+        return worst;
+    }
+
+    double alpha_;
+    Tail tail_;
+    std::uint64_t capacity_ = 0;  // 0: unsized, no bound yet
+    std::uint64_t initial_capacity_ = 0;
+    bool use_threshold_ = false;
+    double threshold_ = 0.0;
+    std::vector<double> heap_;
+    std::uint64_t count_ = 0;
+};
+
+} // namespace montecarlo
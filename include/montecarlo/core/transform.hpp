@@ -1,6 +1,8 @@
 #pragma once
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
+#include "config_hash.hpp"
 
 namespace montecarlo::transform {
 
@@ -9,6 +11,8 @@ struct Identity {
     double operator()(double x) const noexcept {
         return x;
     }
+
+    std::uint64_t config_hash() const { return ConfigHasher{}.add("transform::Identity").value(); }
 };
 
 // Square transform
@@ -16,6 +20,8 @@ struct Square {
     double operator()(double x) const noexcept {
         return x * x;
     }
+
+    std::uint64_t config_hash() const { return ConfigHasher{}.add("transform::Square").value(); }
 };
 
 // Absolute value transform
@@ -23,6 +29,8 @@ struct Abs {
     double operator()(double x) const noexcept {
         return std::abs(x);
     }
+
+    std::uint64_t config_hash() const { return ConfigHasher{}.add("transform::Abs").value(); }
 };
 
 // Natural logarithm (with offset to handle negative values)
@@ -33,6 +41,10 @@ struct Log {
         return std::log(x + offset_);
     }
 
+    std::uint64_t config_hash() const {
+        return ConfigHasher{}.add("transform::Log").add(offset_).value();
+    }
+
  private:
     double offset_;
 };
@@ -42,6 +54,8 @@ struct Exp {
     double operator()(double x) const noexcept {
         return std::exp(x);
     }
+
+    std::uint64_t config_hash() const { return ConfigHasher{}.add("transform::Exp").value(); }
 };
 
 // Indicator function (returns 1 if condition met, 0 otherwise)
@@ -53,6 +67,10 @@ struct Indicator {
         return (greater_than_ ? (x > threshold_) : (x < threshold_)) ? 1.0 : 0.0;
     }
 
+    std::uint64_t config_hash() const {
+        return ConfigHasher{}.add("transform::Indicator").add(threshold_).add(greater_than_).value();
+    }
+
  private:
     double threshold_;
     bool greater_than_;
@@ -66,6 +84,10 @@ struct Clamp {
         return std::clamp(x, min_, max_);
     }
 
+    std::uint64_t config_hash() const {
+        return ConfigHasher{}.add("transform::Clamp").add(min_).add(max_).value();
+    }
+
  private:
     double min_;
     double max_;
@@ -79,6 +101,10 @@ struct LinearScale {
         return a_ * x + b_;
     }
 
+    std::uint64_t config_hash() const {
+        return ConfigHasher{}.add("transform::LinearScale").add(a_).add(b_).value();
+    }
+
  private:
     double a_;
     double b_;
@@ -92,6 +118,10 @@ struct Power {
         return std::pow(x, exponent_);
     }
 
+    std::uint64_t config_hash() const {
+        return ConfigHasher{}.add("transform::Power").add(exponent_).value();
+    }
+
  private:
     double exponent_;
 };
@@ -101,6 +131,8 @@ struct Sigmoid {
     double operator()(double x) const noexcept {
         return 1.0 / (1.0 + std::exp(-x));
     }
+
+    std::uint64_t config_hash() const { return ConfigHasher{}.add("transform::Sigmoid").value(); }
 };
 
 // Compose two transforms: f(g(x))
@@ -112,6 +144,10 @@ struct Compose {
         return f_(g_(x));
     }
 
+    std::uint64_t config_hash() const {
+        return ConfigHasher{}.add("transform::Compose").add(::montecarlo::detail::config_hash(f_)).add(::montecarlo::detail::config_hash(g_)).value();
+    }
+
  private:
     F f_;
     G g_;
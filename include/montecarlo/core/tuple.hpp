@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "concepts.hpp"
+
+namespace montecarlo {
+
+// Runs several aggregators over the same trials in one pass. Every value
+// (or block) is fanned out to all members and merge() is member-wise, so a
+// mean, a histogram and a quantile sketch come out of one simulation.
+// The first member supplies result()/variance()/std_error() for Result.
+template<typename... Aggregators>
+class TupleAggregator {
+    static_assert(sizeof...(Aggregators) > 0, "TupleAggregator needs at least one member");
+    using First = std::tuple_element_t<0, std::tuple<Aggregators...>>;
+
+ public:
+    TupleAggregator() = default;
+
+    explicit TupleAggregator(Aggregators... members) :
+        members_(std::move(members)...) {}
+
+    void begin_stream(const StreamContext& ctx) {
+        for_each([&](auto& member) {
+            if constexpr (StreamAwareAggregator<std::decay_t<decltype(member)>>) {
+                member.begin_stream(ctx);
+            }
+        });
+    }
+
+    template<typename V>
+    void add(const V& value) {
+        ++count_;
+        for_each([&](auto& member) { member.add(value); });
+    }
+
+    // Members without a batch path receive the block one value at a time
+    void add_batch(std::span<const double> values) {
+        count_ += values.size();
+        for_each([&](auto& member) {
+            if constexpr (BatchAggregator<std::decay_t<decltype(member)>>) {
+                member.add_batch(values);
+            } else {
+                for (double v : values) member.add(v);
+            }
+        });
+    }
+
+    void merge(const TupleAggregator& other) {
+        merge_members(other, std::index_sequence_for<Aggregators...>{});
+        count_ += other.count_;
+    }
+
+    double result() const
+        requires requires(const First& a) { { a.result() } -> std::convertible_to<double>; } {
+        return static_cast<double>(get<0>().result());
+    }
+
+    double variance() const
+        requires requires(const First& a) { a.variance(); } {
+        return get<0>().variance();
+    }
+
+    double std_error() const
+        requires requires(const First& a) { a.std_error(); } {
+        return get<0>().std_error();
+    }
+
+    template<std::size_t I>
+    auto& get() { return std::get<I>(members_); }
+
+    template<std::size_t I>
+    const auto& get() const { return std::get<I>(members_); }
+
+    template<typename A>
+    A& get() { return std::get<A>(members_); }
+
+    template<typename A>
+    const A& get() const { return std::get<A>(members_); }
+
+    static constexpr std::size_t size() { return sizeof...(Aggregators); }
+
+    void serialize(ByteWriter& w) const
+        requires (MergeableAggregator<Aggregators> && ...) {
+        w.tag(kTag);
+        w.write(sizeof...(Aggregators));
+        std::apply([&](const auto&... member) { (member.serialize(w), ...); }, members_);
+        w.write(count_);
+    }
+
+    static TupleAggregator deserialize(ByteReader& r)
+        requires (MergeableAggregator<Aggregators> && ...) {
+        r.expect_tag(kTag, "TupleAggregator");
+        if (r.read<std::size_t>() != sizeof...(Aggregators)) {
+            throw std::runtime_error("TupleAggregator::deserialize: member count differs");
+        }
+        // Braced initialisation runs the member readers left to right
+        TupleAggregator agg{Aggregators::deserialize(r)...};
+        r.read(agg.count_);
+        return agg;
+    }
+
+    void reset() {
+        for_each([](auto& member) { member.reset(); });
+        count_ = 0;
+    }
+
+    std::uint64_t count() const { return count_; }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("TUPL");
+
+    template<typename F>
+    void for_each(F&& f) {
+        std::apply([&](auto&... member) { (f(member), ...); }, members_);
+    }
+
+    template<std::size_t... I>
+    void merge_members(const TupleAggregator& other, std::index_sequence<I...>) {
+        (std::get<I>(members_).merge(std::get<I>(other.members_)), ...);
+    }
+
+    std::tuple<Aggregators...> members_;
+    std::uint64_t count_ = 0;
+};
+
+} // namespace montecarlo
@@ -0,0 +1,95 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "../core/result.hpp"
+#include "../core/rng.hpp"
+#include "../io/param_file.hpp"
+#include "feed.hpp"
+#include "worker_pool.hpp"
+
+namespace montecarlo::execution {
+
+// Per-contract outputs; std_error may be left empty
+struct BatchOutput {
+    std::span<double> estimate;
+    std::span<double> std_error;
+};
+
+// Prices many independent contracts, each with its own parameters, on a
+// persistent WorkerPool. Parameters come column-wise from a mapped
+// io::ParamFile; make_model(io::ParamRow) builds each contract's model by
+// value, so the per-contract loop allocates nothing and starts no thread.
+// Workers claim contracts in chunks from an atomic counter, which balances
+// uneven contracts without a queue.
+//
+// Contract i always draws from its own generator seeded from (seed, i),
+// so results do not depend on the thread count or the schedule. Models
+// should be cheap to construct: they are built once per contract.
+class Batch {
+ public:
+    explicit Batch(std::size_t threads = 0, std::size_t chunk = 16) :
+        pool_(std::make_unique<WorkerPool>(threads)), chunk_(std::max<std::size_t>(chunk, 1)) {}
+
+    std::size_t threads() const { return pool_->size(); }
+
+    template<typename MakeModel, typename Aggregator = WelfordAggregator<>,
+             typename RngFactory = ::montecarlo::DefaultRngFactory>
+    void run(const io::ParamFile& params, MakeModel&& make_model, std::uint64_t trials, BatchOutput out,
+             std::uint64_t seed = 42, const Aggregator& prototype = Aggregator{},
+             RngFactory rng_factory = RngFactory{}) const {
+        const std::size_t rows = params.rows();
+        if (out.estimate.size() < rows || (!out.std_error.empty() && out.std_error.size() < rows)) {
+            throw std::invalid_argument("Batch::run: output spans shorter than the parameter file");
+        }
+        std::atomic<std::size_t> next{0};
+        auto work = [&](std::size_t) {
+            Aggregator agg = prototype;
+            auto rng = rng_factory(seed);
+            for (std::size_t first = next.fetch_add(chunk_, std::memory_order_relaxed); first < rows;
+                 first = next.fetch_add(chunk_, std::memory_order_relaxed)) {
+                const std::size_t last = std::min(rows, first + chunk_);
+                for (std::size_t i = first; i < last; ++i) {
+                    auto model = make_model(params.row(i));
+                    reseed(rng, rng_factory, seed, i);
+                    agg.reset();
+                    detail::feed(model, agg, rng, trials);
+                    out.estimate[i] = agg.result();
+                    if (!out.std_error.empty()) {
+                        if constexpr (requires { agg.std_error(); }) {
+                            out.std_error[i] = agg.std_error();
+                        } else {
+                            out.std_error[i] = 0.0;
+                        }
+                    }
+                }
+            }
+        };
+        pool_->run(work);
+    }
+
+ private:
+    // Standard engines reseed in place (seed_seq-based make_rng would
+    // allocate per contract); other generators are rebuilt from the
+    // factory
+    template<typename Rng, typename RngFactory>
+    static void reseed(Rng& rng, RngFactory& rng_factory, std::uint64_t seed, std::uint64_t contract) {
+        const std::uint64_t h = ::montecarlo::detail::derive_seed(seed, contract);
+        if constexpr (requires { rng.seed(static_cast<typename Rng::result_type>(h)); }) {
+            rng.seed(static_cast<typename Rng::result_type>(h));
+        } else {
+            rng = rng_factory(h);
+        }
+    }
+
+    std::unique_ptr<WorkerPool> pool_;
+    std::size_t chunk_;
+};
+
+} // namespace montecarlo::execution
@@ -0,0 +1,254 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../core/rng.hpp"
+#include "../io/checkpoint_file.hpp"
+#include "feed.hpp"
+
+namespace montecarlo::execution {
+
+struct CheckpointOptions {
+    std::string path;
+    // Trials each worker runs between snapshots, rounded up to whole feed
+    // blocks; this bounds both the checkpoint cost and the work lost to a
+    // pre-emption. A snapshot serialises the worker's aggregator on the
+    // worker thread, O(state size), so a slice is also stretched to at least
+    // one trial per 8 bytes of the last snapshot: aggregators whose state
+    // grows with the trial count (ExactQuantileAggregator, threshold-mode
+    // TailAggregator) then snapshot at roughly doubling trial counts and the
+    // total checkpoint cost stays linear in the run.
+    std::uint64_t interval = std::uint64_t{1} << 20;
+};
+
+namespace detail {
+
+// Background thread that keeps the checkpoint file current. Workers hand
+// in snapshots of their own state under a short lock; the thread writes
+// the latest snapshot of every worker, so a slow disk coalesces snapshots
+// instead of stalling the workers. Write errors surface from finish().
+class CheckpointWriter {
+ public:
+    CheckpointWriter(std::string path, io::Checkpoint initial, bool write_now) :
+        path_(std::move(path)), current_(std::move(initial)), pending_(current_.workers.size()),
+        fresh_(current_.workers.size(), false), dirty_(write_now) {
+        thread_ = std::thread([this] { run(); });
+    }
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    ~CheckpointWriter() {
+        try {
+            finish();
+        } catch (...) {
+            // Destructors must not throw; the previous checkpoint survives
+        }
+    }
+
+    void publish(std::size_t worker, io::WorkerCheckpoint snapshot) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_[worker] = std::move(snapshot);
+            fresh_[worker] = true;
+            dirty_ = true;
+        }
+        wake_.notify_one();
+    }
+
+    // Write whatever is still pending and stop the thread
+    void finish() {
+        if (thread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_one();
+            thread_.join();
+        }
+        if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+
+ private:
+    void run() {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return dirty_ || stopping_; });
+                if (!dirty_) return;
+                for (std::size_t w = 0; w < fresh_.size(); ++w) {
+                    if (fresh_[w]) std::swap(current_.workers[w], pending_[w]);
+                    fresh_[w] = false;
+                }
+                dirty_ = false;
+            }
+            try {
+                current_.save(path_);
+            } catch (...) {
+                if (!error_) error_ = std::current_exception();
+            }
+        }
+    }
+
+    std::string path_;
+    io::Checkpoint current_;  // writer thread only
+    std::mutex mutex_;        // guards everything below
+    std::condition_variable wake_;
+    std::vector<io::WorkerCheckpoint> pending_;
+    std::vector<bool> fresh_;
+    bool dirty_;
+    bool stopping_ = false;
+    std::exception_ptr error_;  // writer thread until joined
+    std::thread thread_;
+};
+
+template<typename Rng>
+std::string save_rng(const Rng& rng) {
+    std::ostringstream out;
+    out << rng;
+    return out.str();
+}
+
+template<typename Rng>
+void load_rng(Rng& rng, const std::string& state) {
+    std::istringstream in(state);
+    in >> rng;
+    if (!in) throw std::runtime_error("Checkpoint: unreadable generator state");
+}
+
+// Run `workers` streams laid out exactly as Sequential (one worker) or
+// Parallel (several) lay them out, in slices of opts.interval trials, and
+// publish each worker's state after every slice. With `resume` the
+// streams continue from a checkpoint instead of starting afresh. Slices are
+// whole feed blocks, so aggregators see the same add_batch() calls as in
+// an uninterrupted run and finish in the same state.
+template<typename Model, typename Aggregator, typename RngFactory>
+void run_checkpointed(Model model, Aggregator& agg, std::uint64_t iterations, std::uint64_t seed,
+                      std::size_t workers, RngFactory rng_factory, const CheckpointOptions& opts,
+                      const io::Checkpoint* resume, RunStats* stats = nullptr) {
+    using Rng = std::decay_t<decltype(rng_factory(seed))>;
+    static_assert(requires(std::ostream& os, std::istream& is, Rng& rng) {
+        os << rng;
+        is >> rng;
+    }, "Checkpointing needs a generator that streams its state with << and >>");
+
+    const auto start_time = Clock::now();
+    io::Checkpoint start;
+    std::vector<CacheAligned<Aggregator>> locals;
+    std::vector<Rng> rngs;
+    locals.reserve(workers > 1 ? workers : 0);
+    if (resume != nullptr) {
+        if (resume->workers.size() != workers) {
+            throw std::invalid_argument("Checkpoint: written by a run with a different number of workers");
+        }
+        start = *resume;
+        if (workers == 1) {
+            agg = from_bytes<Aggregator>(start.workers[0].state);
+        } else {
+            agg.reset();
+            for (const io::WorkerCheckpoint& w : start.workers) {
+                locals.push_back({from_bytes<Aggregator>(w.state)});
+            }
+        }
+        for (std::size_t t = 0; t < workers; ++t) {
+            rngs.push_back(rng_factory(seed + static_cast<std::uint64_t>(t)));
+            load_rng(rngs.back(), start.workers[t].rng);
+        }
+    } else {
+        agg.reset();
+        start.seed = seed;
+        start.iterations = iterations;
+        std::uint64_t first_trial = 0;
+        for (std::size_t t = 0; t < workers; ++t) {
+            const std::uint64_t trials = iterations / workers + (t < iterations % workers ? 1 : 0);
+            const StreamContext ctx{seed, t, first_trial, trials, iterations};
+            first_trial += trials;
+            rngs.push_back(rng_factory(seed + static_cast<std::uint64_t>(t)));
+            if (workers == 1) {
+                begin_stream(agg, ctx);
+            } else {
+                locals.push_back({agg});
+                begin_stream(locals.back().value, ctx);
+            }
+            Aggregator& a = workers == 1 ? agg : locals.back().value;
+            start.workers.push_back({t, ctx.first_trial, trials, 0, save_rng(rngs.back()), to_bytes(a)});
+        }
+    }
+
+    std::vector<io::WorkerCheckpoint> positions = start.workers;
+    CheckpointWriter writer(opts.path, std::move(start), resume == nullptr);
+    const std::uint64_t slice = std::max<std::uint64_t>((opts.interval + kFeedBlock - 1) / kFeedBlock, 1) * kFeedBlock;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    std::atomic<bool> failed{false};
+    std::vector<WorkerClock> clocks(workers);
+    std::vector<std::uint64_t> trials(workers);
+
+    auto work = [&, model](std::size_t t) mutable {
+        Aggregator& a = workers == 1 ? agg : locals[t].value;
+        io::WorkerCheckpoint& at = positions[t];
+        clocks[t].begin = Clock::now();
+        trials[t] = at.trials - at.done;
+        try {
+            std::uint64_t next = slice;
+            while (at.done < at.trials && !failed.load(std::memory_order_relaxed)) {
+                const std::uint64_t n = std::min(next, at.trials - at.done);
+                feed(model, a, rngs[t], n);
+                at.done += n;
+                std::vector<std::byte> state = to_bytes(a);
+                const std::uint64_t words = state.size() / sizeof(std::uint64_t);
+                next = std::max(slice, (words + kFeedBlock - 1) / kFeedBlock * kFeedBlock);
+                writer.publish(t, {at.stream_id, at.first_trial, at.trials, at.done, save_rng(rngs[t]), std::move(state)});
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) error = std::current_exception();
+            failed.store(true, std::memory_order_relaxed);
+        }
+        clocks[t].end = Clock::now();
+    };
+
+#ifdef MCLIB_PARALLEL_ENABLED
+    std::vector<std::thread> threads;
+    for (std::size_t t = 1; t < workers; ++t) threads.emplace_back(work, t);
+    work(0);
+    for (auto& thread : threads) thread.join();
+#else
+    for (std::size_t t = 0; t < workers; ++t) work(t);
+#endif
+
+    // A failed trial outranks a failed checkpoint write
+    try {
+        writer.finish();
+    } catch (...) {
+        if (!error) throw;
+    }
+    if (error) std::rethrow_exception(error);
+
+    const auto merge_begin = Clock::now();
+    if (!locals.empty()) {
+        if constexpr (requires(Aggregator& a, const Aggregator& b) { a.merge(b); }) {
+            for (const auto& slot : locals) agg.merge(slot.value);
+        } else {
+            throw std::logic_error("Checkpoint: several workers need an aggregator with merge()");
+        }
+    }
+    record_stats(stats, start_time, clocks, trials, merge_begin, Clock::now());
+}
+
+} // namespace detail
+
+} // namespace montecarlo::execution
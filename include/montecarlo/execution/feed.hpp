@@ -0,0 +1,112 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include "../core/concepts.hpp"
+#include "../core/result.hpp"
+
+namespace montecarlo::execution::detail {
+
+// Trials buffered per add_batch() call
+inline constexpr std::size_t kFeedBlock = 256;
+
+// Assumed destructive-interference size
+inline constexpr std::size_t kCacheLine = 64;
+
+// Per-worker slot padded to whole cache lines so workers updating adjacent
+// slots never false-share
+template<typename T>
+struct alignas(kCacheLine) CacheAligned {
+    T value;
+};
+
+using Clock = std::chrono::steady_clock;
+
+inline double elapsed_ms(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// When one worker started and finished its trials
+struct WorkerClock {
+    Clock::time_point begin;
+    Clock::time_point end;
+};
+
+// Fill `stats` from the run's start, each worker's clock and the merge
+// interval
+inline void record_stats(RunStats* stats, Clock::time_point start, std::span<const WorkerClock> clocks,
+                         std::span<const std::uint64_t> trials, Clock::time_point merge_begin,
+                         Clock::time_point merge_end) {
+    if (stats == nullptr) return;
+    Clock::time_point last_begin = start;
+    stats->workers.clear();
+    for (std::size_t t = 0; t < clocks.size(); ++t) {
+        last_begin = std::max(last_begin, clocks[t].begin);
+        const double ms = elapsed_ms(clocks[t].begin, clocks[t].end);
+        stats->workers.push_back({trials[t], ms, ms > 0.0 ? static_cast<double>(trials[t]) / (ms / 1000.0) : 0.0});
+    }
+    stats->setup_ms = elapsed_ms(start, last_begin);
+    stats->merge_ms = elapsed_ms(merge_begin, merge_end);
+}
+
+// Tell stream-aware aggregators which trials they are about to receive
+template<typename Aggregator>
+void begin_stream(Aggregator& agg, const StreamContext& ctx) {
+    if constexpr (StreamAwareAggregator<Aggregator>) {
+        agg.begin_stream(ctx);
+    }
+}
+
+// Works with both trial and call styles; the result is passed through as
+// the model returned it (a double, or e.g. an array for vector outputs)
+template<typename Model, typename Rng>
+auto invoke_trial(Model& model, Rng& rng) {
+    if constexpr (requires { model.trial(rng); }) {
+        return model.trial(rng);
+    } else {
+        return model(rng);
+    }
+}
+
+// Run `iterations` trials into `agg`, handing whole blocks to aggregators
+// that support add_batch() (integer blocks for integer models where the
+// aggregator takes them) and single values to everything else
+template<typename Model, typename Aggregator, typename Rng>
+void feed(Model& model, Aggregator& agg, Rng& rng, std::uint64_t iterations) {
+    using Output = decltype(invoke_trial(model, rng));
+    if constexpr (IntegerBatchAggregator<Aggregator> && std::integral<Output>) {
+        std::array<std::int64_t, kFeedBlock> block;
+        std::uint64_t done = 0;
+        while (done < iterations) {
+            const std::size_t n = static_cast<std::size_t>(
+                std::min<std::uint64_t>(kFeedBlock, iterations - done));
+            for (std::size_t i = 0; i < n; ++i) {
+                block[i] = static_cast<std::int64_t>(invoke_trial(model, rng));
+            }
+            agg.add_batch(std::span<const std::int64_t>(block.data(), n));
+            done += n;
+        }
+    } else if constexpr (BatchAggregator<Aggregator> && std::convertible_to<Output, double>) {
+        std::array<double, kFeedBlock> block;
+        std::uint64_t done = 0;
+        while (done < iterations) {
+            const std::size_t n = static_cast<std::size_t>(
+                std::min<std::uint64_t>(kFeedBlock, iterations - done));
+            for (std::size_t i = 0; i < n; ++i) {
+                block[i] = invoke_trial(model, rng);
+            }
+            agg.add_batch(std::span<const double>(block.data(), n));
+            done += n;
+        }
+    } else {
+        for (std::uint64_t i = 0; i < iterations; ++i) {
+            agg.add(invoke_trial(model, rng));
+        }
+    }
+}
+
+} // namespace montecarlo::execution::detail
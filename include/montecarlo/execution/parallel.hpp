@@ -4,6 +4,7 @@
 #include <thread>
 #include <algorithm>
 #include "../core/rng.hpp"
+#include "feed.hpp"
 
 namespace montecarlo::execution {
 class Parallel {
@@ -12,27 +13,38 @@ class Parallel {
         : num_threads_(num_threads > 0 ? num_threads : std::thread::hardware_concurrency()) {}
 
     template<typename Model, typename Aggregator, typename RngFactory = ::montecarlo::DefaultRngFactory>
-    void run(Model model, Aggregator& agg, size_t iterations, uint64_t seed = 42, RngFactory rng_factory = RngFactory{}) const {
+    void run(Model model, Aggregator& agg, size_t iterations, uint64_t seed = 42, RngFactory rng_factory = RngFactory{},
+             RunStats* stats = nullptr) const {
+        // Replaying each worker's mean count() times cost O(N) and lost the
+        // dispersion, so per-thread results must merge natively
+        static_assert(requires(Aggregator& a, const Aggregator& b) { a.merge(b); },
+                      "Parallel needs an aggregator with merge(const Aggregator&)");
+        const auto start = detail::Clock::now();
         std::vector<std::thread> threads;
-        std::vector<Aggregator> local_aggs(num_threads_);
+        // Per-thread aggregators are copies of the (reset) caller's one so
+        // they inherit its configuration
+        agg.reset();
+        std::vector<detail::CacheAligned<Aggregator>> local_aggs(num_threads_, {agg});
+
+        std::vector<detail::WorkerClock> clocks(num_threads_);
+        std::vector<std::uint64_t> trials(num_threads_);
 
         size_t iters_per_thread = iterations / num_threads_;
         size_t remaining = iterations % num_threads_;
 
+        size_t first_trial = 0;
         for (size_t t = 0; t < num_threads_; ++t) {
             size_t thread_iters = iters_per_thread + (t < remaining ? 1 : 0);
-            threads.emplace_back([model, &local_aggs, t, thread_iters, seed, rng_factory]() mutable {
+            StreamContext ctx{seed, t, first_trial, thread_iters, iterations};
+            first_trial += thread_iters;
+            trials[t] = thread_iters;
+            threads.emplace_back([model, &local_aggs, &clocks, t, ctx, seed, rng_factory]() mutable {
                 // Bump seed per thread to dodge collisions
                 auto rng = rng_factory(seed + static_cast<uint64_t>(t));
-                for (std::uint64_t i = 0; i < thread_iters; ++i) {
-                    double result;
-                    if constexpr (requires { model.trial(rng); }) {
-                        result = model.trial(rng);
-                    } else {
-                        result = model(rng);
-                    }
-                    local_aggs[t].add(result);
-                }
+                detail::begin_stream(local_aggs[t].value, ctx);
+                const auto begin = detail::Clock::now();
+                detail::feed(model, local_aggs[t].value, rng, ctx.trials);
+                clocks[t] = {begin, detail::Clock::now()};
             });
         }
 
@@ -40,23 +52,16 @@ class Parallel {
             thread.join();
         }
 
-        // Merge results - aggregate all local results into main aggregator.
-        // Prefer a native merge() if the aggregator exposes one, otherwise
-        // fall back to replaying the per-thread means.
-        agg.reset();
-        for (const auto& local_agg : local_aggs) {
-            if constexpr (requires { agg.merge(local_agg); }) {
-                agg.merge(local_agg);
-            } else {
-                if (local_agg.count() > 0) {
-                    for (size_t i = 0; i < local_agg.count(); ++i) {
-                        agg.add(local_agg.result());
-                    }
-                }
-            }
+        // Fold the per-thread partial results together in thread order
+        const auto merge_begin = detail::Clock::now();
+        for (const auto& slot : local_aggs) {
+            agg.merge(slot.value);
         }
+        detail::record_stats(stats, start, clocks, trials, merge_begin, detail::Clock::now());
     }
 
+    size_t threads() const { return num_threads_; }
+
  private:
     size_t num_threads_;
 };
@@ -1,25 +1,25 @@
 #pragma once
 #include <random>
 #include "../core/rng.hpp"
+#include "feed.hpp"
 
 namespace montecarlo::execution {
 
 class Sequential {
  public:
     template<typename Model, typename Aggregator, typename RngFactory = ::montecarlo::DefaultRngFactory>
-    void run(Model&& model, Aggregator& agg, size_t iterations, uint64_t seed = 42, RngFactory rng_factory = RngFactory{}) const {
+    void run(Model&& model, Aggregator& agg, size_t iterations, uint64_t seed = 42, RngFactory rng_factory = RngFactory{},
+             RunStats* stats = nullptr) const {
+        const auto start = detail::Clock::now();
         auto rng = rng_factory(seed);
         // Reuse one generator for the whole run
-        
-        for (std::uint64_t i = 0; i < iterations; ++i) {
-            double result;
-            if constexpr (requires { model.trial(rng); }) {
-                result = model.trial(rng);
-            } else {
-                result = model(rng);
-            }
-            agg.add(result);
-        }
+        detail::begin_stream(agg, {seed, 0, 0, iterations, iterations});
+        detail::WorkerClock clock;
+        clock.begin = detail::Clock::now();
+        detail::feed(model, agg, rng, iterations);
+        clock.end = detail::Clock::now();
+        const std::uint64_t trials = iterations;
+        detail::record_stats(stats, start, {&clock, 1}, {&trials, 1}, clock.end, clock.end);
     }
 };
 
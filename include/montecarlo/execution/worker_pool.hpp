@@ -0,0 +1,104 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <vector>
+#ifdef MCLIB_PARALLEL_ENABLED
+#include <thread>
+#endif
+
+namespace montecarlo::execution {
+
+// Fixed set of threads that run one fork-join task at a time. Threads are
+// started once and sleep on an atomic between tasks, so repeated batches
+// spawn nothing; the calling thread works as worker 0. Without
+// MCLIB_PARALLEL_ENABLED the pool is just the caller.
+class WorkerPool {
+ public:
+    explicit WorkerPool(std::size_t threads = 0) {
+#ifdef MCLIB_PARALLEL_ENABLED
+        size_ = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+        for (std::size_t t = 1; t < size_; ++t) {
+            threads_.emplace_back([this, t] { loop(t); });
+        }
+#else
+        (void)threads;
+#endif
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+#ifdef MCLIB_PARALLEL_ENABLED
+        stopping_.store(true, std::memory_order_release);
+        generation_.fetch_add(1, std::memory_order_acq_rel);
+        generation_.notify_all();
+        for (auto& thread : threads_) thread.join();
+#endif
+    }
+
+    std::size_t size() const { return size_; }
+
+    // Call f(worker) on every worker and wait for all of them; the first
+    // exception thrown by any worker is rethrown here
+    template<typename F>
+    void run(F& f) {
+        std::lock_guard<std::mutex> lock(run_mutex_);
+        task_ = &f;
+        invoke_ = [](void* task, std::size_t worker) { (*static_cast<F*>(task))(worker); };
+        error_ = nullptr;
+#ifdef MCLIB_PARALLEL_ENABLED
+        pending_.store(size_ - 1, std::memory_order_release);
+        generation_.fetch_add(1, std::memory_order_acq_rel);
+        generation_.notify_all();
+#endif
+        execute(0);
+#ifdef MCLIB_PARALLEL_ENABLED
+        for (std::size_t left = pending_.load(std::memory_order_acquire); left != 0;
+             left = pending_.load(std::memory_order_acquire)) {
+            pending_.wait(left, std::memory_order_acquire);
+        }
+#endif
+        if (error_) std::rethrow_exception(error_);
+    }
+
+ private:
+    void execute(std::size_t worker) {
+        try {
+            invoke_(task_, worker);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex_);
+            if (!error_) error_ = std::current_exception();
+        }
+    }
+
+#ifdef MCLIB_PARALLEL_ENABLED
+    void loop(std::size_t worker) {
+        std::uint64_t seen = 0;
+        for (;;) {
+            generation_.wait(seen, std::memory_order_acquire);
+            seen = generation_.load(std::memory_order_acquire);
+            if (stopping_.load(std::memory_order_acquire)) return;
+            execute(worker);
+            if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) pending_.notify_one();
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    std::atomic<std::uint64_t> generation_{0};
+    std::atomic<std::size_t> pending_{0};
+    std::atomic<bool> stopping_{false};
+#endif
+    std::size_t size_ = 1;
+    std::mutex run_mutex_;
+    std::mutex error_mutex_;
+    void* task_ = nullptr;
+    void (*invoke_)(void*, std::size_t) = nullptr;
+    std::exception_ptr error_;
+};
+
+} // namespace montecarlo::execution
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../core/bytes.hpp"
+#include "mapped_file.hpp"
+#include "writable_file.hpp"
+
+namespace montecarlo::io {
+
+// One worker's position in a checkpointed run
+struct WorkerCheckpoint {
+    std::uint64_t stream_id = 0;
+    std::uint64_t first_trial = 0;
+    std::uint64_t trials = 0;      // assigned to this worker
+    std::uint64_t done = 0;        // of those, completed
+    std::string rng;               // generator state as written by operator<<
+    std::vector<std::byte> state;  // aggregator serialize() output
+};
+
+// Everything needed to continue a run where it stopped: per worker, the
+// trials done, the generator state and the aggregator state. The merged
+// state is the workers' states merged in worker order, exactly as the run
+// itself merges them at the end, so it is derived on demand by
+// aggregate<A>() rather than stored twice.
+//
+// Files are written whole to `path.tmp`, synced and renamed over `path`,
+// so a crash mid-write leaves the previous checkpoint intact.
+struct Checkpoint {
+    std::uint64_t seed = 0;
+    std::uint64_t iterations = 0;
+    std::vector<WorkerCheckpoint> workers;
+
+    std::uint64_t completed() const {
+        std::uint64_t n = 0;
+        for (const WorkerCheckpoint& w : workers) n += w.done;
+        return n;
+    }
+
+    bool finished() const { return completed() == iterations; }
+
+    // Aggregate of the trials completed so far
+    template<typename Aggregator>
+    Aggregator aggregate() const {
+        if (workers.empty()) throw std::logic_error("Checkpoint::aggregate: no workers");
+        Aggregator agg = from_bytes<Aggregator>(workers.front().state);
+        if (workers.size() == 1) return agg;
+        agg.reset();
+        for (const WorkerCheckpoint& w : workers) agg.merge(from_bytes<Aggregator>(w.state));
+        return agg;
+    }
+
+    void serialize(ByteWriter& w) const {
+        w.tag(kTag);
+        w.write(seed);
+        w.write(iterations);
+        w.write(workers.size());
+        for (const WorkerCheckpoint& worker : workers) {
+            w.write(worker.stream_id);
+            w.write(worker.first_trial);
+            w.write(worker.trials);
+            w.write(worker.done);
+            w.write(worker.rng);
+            w.write_bytes(worker.state);
+        }
+    }
+
+    static Checkpoint deserialize(ByteReader& r) {
+        r.expect_tag(kTag, "Checkpoint");
+        Checkpoint c;
+        r.read(c.seed);
+        r.read(c.iterations);
+        const auto count = r.read<std::size_t>();
+        if (count > r.remaining() / 48) throw std::runtime_error("ByteReader: truncated input");
+        c.workers.resize(count);
+        for (WorkerCheckpoint& worker : c.workers) {
+            r.read(worker.stream_id);
+            r.read(worker.first_trial);
+            r.read(worker.trials);
+            r.read(worker.done);
+            r.read(worker.rng);
+            const std::span<const std::byte> state = r.read_bytes();
+            worker.state.assign(state.begin(), state.end());
+            if (worker.done > worker.trials) throw std::runtime_error("Checkpoint: more trials done than assigned");
+        }
+        return c;
+    }
+
+    // Atomically replace the file at `path`
+    void save(const std::string& path) const {
+        const std::vector<std::byte> bytes = to_bytes(*this);
+        const std::string tmp = path + ".tmp";
+        {
+            WritableFile file = WritableFile::create(tmp);
+            file.write_at(0, bytes);
+            file.sync();
+        }
+        std::filesystem::rename(tmp, path);
+    }
+
+    static Checkpoint load(const std::string& path) {
+        const MappedFile file = MappedFile::open(path);
+        return from_bytes<Checkpoint>(file.bytes());
+    }
+
+ private:
+    static constexpr std::uint32_t kTag = fourcc("CKPT");
+};
+
+} // namespace montecarlo::io
@@ -0,0 +1,151 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MCLIB_HAS_MMAP 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace montecarlo::io {
+
+// Read-only view of a file's bytes: mmap(2) where available, otherwise the
+// file is read into memory. Move-only; the mapping lives as long as the
+// object.
+class MappedFile {
+ public:
+    MappedFile() = default;
+
+    static MappedFile open(const std::string& path) {
+        MappedFile file;
+#ifdef MCLIB_HAS_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) fail("open", path);
+        file.map_fd(fd, path);
+        ::close(fd);
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) throw std::runtime_error("MappedFile: cannot open " + path);
+        file.fallback_.resize(static_cast<std::size_t>(in.tellg()));
+        in.seekg(0);
+        in.read(reinterpret_cast<char*>(file.fallback_.data()), static_cast<std::streamsize>(file.fallback_.size()));
+        file.data_ = file.fallback_.data();
+        file.size_ = file.fallback_.size();
+#endif
+        return file;
+    }
+
+    // Write `bytes` to an anonymous temporary file in `directory` and map
+    // it back, moving the data out of the heap into the page cache. The
+    // file is unlinked at once, so nothing is left behind.
+    static MappedFile spill(const std::string& directory, std::span<const std::byte> bytes) {
+        MappedFile file;
+#ifdef MCLIB_HAS_MMAP
+        std::string path = directory + "/mclib-spill-XXXXXX";
+        const int fd = ::mkstemp(path.data());
+        if (fd < 0) fail("mkstemp", path);
+        ::unlink(path.c_str());
+        std::size_t done = 0;
+        while (done < bytes.size()) {
+            const ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                ::close(fd);
+                fail("write", path);
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        file.map_fd(fd, path);
+        ::close(fd);
+#else
+        (void)directory;
+        file.fallback_.assign(bytes.begin(), bytes.end());
+        file.data_ = file.fallback_.data();
+        file.size_ = file.fallback_.size();
+#endif
+        return file;
+    }
+
+    MappedFile(MappedFile&& other) noexcept { swap(other); }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            MappedFile tmp(std::move(other));
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifdef MCLIB_HAS_MMAP
+        if (mapped_) ::munmap(const_cast<std::byte*>(data_), size_);
+#endif
+    }
+
+    std::span<const std::byte> bytes() const { return {data_, size_}; }
+
+    // The bytes reinterpreted as T; the caller vouches for the layout
+    template<typename T>
+    std::span<const T> as(std::size_t offset = 0) const {
+        if (offset > size_) throw std::out_of_range("MappedFile::as: offset past end");
+        return {reinterpret_cast<const T*>(data_ + offset), (size_ - offset) / sizeof(T)};
+    }
+
+    std::size_t size() const { return size_; }
+    bool mapped() const { return mapped_; }
+
+ private:
+    [[noreturn]] static void fail(const char* what, const std::string& path) {
+#ifdef MCLIB_HAS_MMAP
+        throw std::runtime_error(std::string("MappedFile: ") + what + " " + path + ": " + std::strerror(errno));
+#else
+        throw std::runtime_error(std::string("MappedFile: ") + what + " " + path);
+#endif
+    }
+
+#ifdef MCLIB_HAS_MMAP
+    void map_fd(int fd, const std::string& path) {
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            fail("fstat", path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        if (size_ == 0) return;  // mmap rejects empty files
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            fail("mmap", path);
+        }
+        data_ = static_cast<const std::byte*>(p);
+        mapped_ = true;
+    }
+#endif
+
+    void swap(MappedFile& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(mapped_, other.mapped_);
+        std::swap(fallback_, other.fallback_);
+    }
+
+    const std::byte* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<std::byte> fallback_;
+};
+
+} // namespace montecarlo::io
@@ -0,0 +1,163 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "mapped_file.hpp"
+#include "writable_file.hpp"
+
+namespace montecarlo::io {
+
+// Structure-of-arrays parameter file: one double column per parameter,
+// one row per scenario or contract
+//
+//   header   64 bytes, ParamFileHeader
+//   names    per column: uint32 length, then the bytes
+//   columns  rows doubles each, every column 64-byte aligned
+//
+// Like sample files, columns are in host byte order so a mapped file is
+// used in place.
+struct ParamFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t columns;
+    std::uint32_t reserved;
+    std::uint64_t rows;
+    std::uint64_t names_offset;
+    std::uint64_t data_offset;
+    std::uint64_t column_stride;  // bytes from one column to the next
+    std::uint64_t padding;
+};
+static_assert(sizeof(ParamFileHeader) == 64);
+
+inline constexpr char kParamFileMagic[8] = {'M', 'C', 'P', 'A', 'R', 'A', 'M', 'S'};
+inline constexpr std::uint32_t kParamFileVersion = 1;
+inline constexpr std::uint32_t kParamByteOrder = 0x01020304;
+
+// Write named columns of equal length. Also used for batch outputs, which
+// are just columns such as estimate and std_error.
+inline void write_param_file(const std::string& path, const std::vector<std::string>& names,
+                             const std::vector<std::span<const double>>& columns) {
+    if (names.size() != columns.size()) throw std::invalid_argument("write_param_file: one name per column");
+    const std::uint64_t rows = columns.empty() ? 0 : columns.front().size();
+    for (std::span<const double> c : columns) {
+        if (c.size() != rows) throw std::invalid_argument("write_param_file: columns differ in length");
+    }
+    auto align = [](std::uint64_t n) { return (n + 63) / 64 * 64; };
+
+    std::vector<std::byte> names_block;
+    for (const std::string& name : names) {
+        const auto length = static_cast<std::uint32_t>(name.size());
+        const auto* p = reinterpret_cast<const std::byte*>(&length);
+        names_block.insert(names_block.end(), p, p + sizeof(length));
+        const auto* s = reinterpret_cast<const std::byte*>(name.data());
+        names_block.insert(names_block.end(), s, s + name.size());
+    }
+
+    ParamFileHeader header{};
+    std::memcpy(header.magic, kParamFileMagic, sizeof(header.magic));
+    header.version = kParamFileVersion;
+    header.byte_order = kParamByteOrder;
+    header.columns = static_cast<std::uint32_t>(columns.size());
+    header.rows = rows;
+    header.names_offset = sizeof(ParamFileHeader);
+    header.data_offset = align(header.names_offset + names_block.size());
+    header.column_stride = align(rows * sizeof(double));
+
+    WritableFile file = WritableFile::create(path);
+    file.write_at(0, std::as_bytes(std::span<const ParamFileHeader>(&header, 1)));
+    file.write_at(header.names_offset, names_block);
+    for (std::size_t c = 0; c < columns.size(); ++c) {
+        file.write_at(header.data_offset + c * header.column_stride, std::as_bytes(columns[c]));
+    }
+    // Pad the last column so every column spans a full stride
+    if (!columns.empty() && header.column_stride > rows * sizeof(double)) {
+        const std::vector<std::byte> zeros(static_cast<std::size_t>(header.column_stride - rows * sizeof(double)));
+        file.write_at(header.data_offset + (columns.size() - 1) * header.column_stride + rows * sizeof(double), zeros);
+    }
+    file.flush();
+}
+
+// One row of a parameter file: row[j] is parameter j
+class ParamRow {
+ public:
+    ParamRow(const std::span<const double>* columns, std::size_t count, std::size_t row) :
+        columns_(columns), count_(count), row_(row) {}
+
+    double operator[](std::size_t column) const { return columns_[column][row_]; }
+    std::size_t index() const { return row_; }
+    std::size_t size() const { return count_; }
+
+ private:
+    const std::span<const double>* columns_;
+    std::size_t count_;
+    std::size_t row_;
+};
+
+// Mapped parameter file; columns are spans into the mapping
+class ParamFile {
+ public:
+    static ParamFile open(const std::string& path) {
+        ParamFile file;
+        file.map_ = MappedFile::open(path);
+        const std::span<const std::byte> bytes = file.map_.bytes();
+        if (bytes.size() < sizeof(ParamFileHeader)) throw std::runtime_error("ParamFile: too short: " + path);
+        ParamFileHeader h;
+        std::memcpy(&h, bytes.data(), sizeof(h));
+        if (std::memcmp(h.magic, kParamFileMagic, sizeof(h.magic)) != 0) {
+            throw std::runtime_error("ParamFile: not a parameter file: " + path);
+        }
+        if (h.version != kParamFileVersion) throw std::runtime_error("ParamFile: unsupported version: " + path);
+        if (h.byte_order != kParamByteOrder) throw std::runtime_error("ParamFile: foreign byte order: " + path);
+        // Bound rows by the data region before multiplying, so rows * 8
+        // cannot wrap
+        if (h.data_offset % 64 != 0 || h.column_stride % 64 != 0 || h.data_offset > bytes.size() ||
+            h.names_offset < sizeof(ParamFileHeader) || h.names_offset > h.data_offset ||
+            h.rows > (bytes.size() - h.data_offset) / sizeof(double) || h.column_stride < h.rows * sizeof(double) ||
+            (h.columns > 0 && h.column_stride > 0 && h.columns > (bytes.size() - h.data_offset) / h.column_stride)) {
+            throw std::runtime_error("ParamFile: corrupt layout: " + path);
+        }
+
+        std::size_t at = static_cast<std::size_t>(h.names_offset);
+        for (std::uint32_t c = 0; c < h.columns; ++c) {
+            std::uint32_t length = 0;
+            if (at + sizeof(length) > h.data_offset) throw std::runtime_error("ParamFile: corrupt names: " + path);
+            std::memcpy(&length, bytes.data() + at, sizeof(length));
+            at += sizeof(length);
+            if (length > h.data_offset - at) throw std::runtime_error("ParamFile: corrupt names: " + path);
+            file.names_.emplace_back(reinterpret_cast<const char*>(bytes.data() + at), length);
+            at += length;
+            file.columns_.push_back(file.map_.as<double>(static_cast<std::size_t>(h.data_offset + c * h.column_stride))
+                                        .first(static_cast<std::size_t>(h.rows)));
+        }
+        file.rows_ = static_cast<std::size_t>(h.rows);
+        return file;
+    }
+
+    std::size_t rows() const { return rows_; }
+    std::size_t columns() const { return columns_.size(); }
+    const std::string& name(std::size_t column) const { return names_.at(column); }
+
+    std::span<const double> column(std::size_t column) const { return columns_.at(column); }
+
+    std::span<const double> column(const std::string& name) const {
+        for (std::size_t c = 0; c < names_.size(); ++c) {
+            if (names_[c] == name) return columns_[c];
+        }
+        throw std::out_of_range("ParamFile: no column " + name);
+    }
+
+    ParamRow row(std::size_t i) const { return {columns_.data(), columns_.size(), i}; }
+
+ private:
+    MappedFile map_;
+    std::vector<std::string> names_;
+    std::vector<std::span<const double>> columns_;
+    std::size_t rows_ = 0;
+};
+
+} // namespace montecarlo::io
@@ -0,0 +1,303 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "../core/bytes.hpp"
+#include "../core/config_hash.hpp"
+#include "../core/result.hpp"
+#include "mapped_file.hpp"
+#include "writable_file.hpp"
+
+#ifdef MCLIB_HAS_MMAP
+#include <sys/file.h>
+#endif
+
+namespace montecarlo::io {
+
+// Result cache directory layout
+//
+//   index     64-byte ResultIndexHeader, then an open-addressing table of
+//             CacheKey slots (all zeros = empty), mapped by readers
+//   lock      flock(2) target serialising writers across processes
+//   <key>.res one entry per key: Result fields and aggregator state
+//
+// Entries appear atomically (written to a temporary name, synced,
+// renamed); all entries for a key describe the same run, so a rewrite
+// (e.g. one that adds aggregator state) is harmless. Readers probe their
+// mapping of the index without locking and remap once on a miss to pick
+// up other processes' inserts.
+// The entry file is authoritative: a stale or torn index slot can only
+// cause a miss. Writers hold the lock to add a slot in place, or to
+// rebuild the index at twice the size (again by rename) past half full.
+struct ResultIndexHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t slots;  // power of two
+    std::uint64_t used;
+    std::uint64_t padding[4];
+};
+static_assert(sizeof(ResultIndexHeader) == 64);
+
+inline constexpr char kResultIndexMagic[8] = {'M', 'C', 'R', 'C', 'A', 'C', 'H', 'E'};
+inline constexpr std::uint32_t kResultIndexVersion = 1;
+
+// A cached run: the Result and, if it was stored, the aggregator state
+struct CachedResult {
+    Result result;
+    std::vector<std::byte> state;
+};
+
+// On-disk memo of Results keyed by CacheKey, shared safely between
+// threads and processes (across processes on POSIX, where writers lock).
+class ResultCache {
+ public:
+    explicit ResultCache(std::string directory, std::uint64_t initial_slots = 1024) : dir_(std::move(directory)) {
+        std::filesystem::create_directories(dir_);
+        std::uint64_t slots = 16;
+        while (slots < initial_slots) slots *= 2;
+        FileLock lock(dir_ + "/lock");
+        if (!std::filesystem::exists(index_path())) write_index(std::vector<CacheKey>(slots), 0);
+    }
+
+    const std::string& directory() const { return dir_; }
+
+    std::optional<CachedResult> find(const CacheKey& key) const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (!probe(key)) {
+            index_ = MappedFile::open(index_path());  // another process may have inserted it
+            if (!probe(key)) {
+                misses_.fetch_add(1, std::memory_order_relaxed);
+                return std::nullopt;
+            }
+        }
+        std::optional<CachedResult> entry = read_entry(key);
+        (entry ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+        return entry;
+    }
+
+    // Write the entry for `key` and make sure the index lists it
+    void store(const CacheKey& key, const Result& result, std::span<const std::byte> state = {}) {
+        ByteWriter w;
+        w.tag(kEntryTag);
+        w.write(key.hi);
+        w.write(key.lo);
+        w.write(result.estimate);
+        w.write(result.variance);
+        w.write(result.standard_error);
+        w.write(result.iterations);
+        w.write(result.elapsed_ms);
+        w.write(result.setup_ms);
+        w.write(result.merge_ms);
+        w.write(result.workers.size());
+        for (const WorkerStats& s : result.workers) {
+            w.write(s.trials);
+            w.write(s.elapsed_ms);
+            w.write(s.throughput);
+        }
+        w.write_bytes(state);
+        replace_file(entry_path(key), w.bytes());
+
+        FileLock lock(dir_ + "/lock");
+        const MappedFile index = MappedFile::open(index_path());
+        const ResultIndexHeader header = read_header(index);
+        const std::span<const CacheKey> table = slots(index, header);
+        const std::uint64_t mask = header.slots - 1;
+        std::uint64_t at = key.hi & mask;
+        while (!(table[at] == CacheKey{})) {
+            if (table[at] == key) return;
+            at = (at + 1) & mask;
+        }
+        if (2 * (header.used + 1) > header.slots) {
+            std::vector<CacheKey> grown(2 * header.slots);
+            for (const CacheKey& k : table) {
+                if (!(k == CacheKey{})) insert(grown, k);
+            }
+            insert(grown, key);
+            write_index(grown, header.used + 1);
+            return;
+        }
+        // Slot first, then the count; a reader seeing half of it just misses
+        WritableFile file = WritableFile::resume(index_path(), index.size());
+        file.write_at(sizeof(ResultIndexHeader) + at * sizeof(CacheKey),
+                      std::as_bytes(std::span<const CacheKey>(&key, 1)));
+        ResultIndexHeader updated = header;
+        updated.used += 1;
+        file.write_at(0, std::as_bytes(std::span<const ResultIndexHeader>(&updated, 1)));
+        file.sync();
+    }
+
+    // Entries in the index
+    std::uint64_t size() const {
+        const MappedFile index = MappedFile::open(index_path());
+        return read_header(index).used;
+    }
+
+    // Lookups by this object that found / did not find an entry
+    std::uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    std::uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+ private:
+    static constexpr std::uint32_t kEntryTag = fourcc("RCEN");
+
+    // Exclusive lock on a file for the object's lifetime; a no-op without
+    // POSIX, where the cache is only safe within one process
+    class FileLock {
+     public:
+        explicit FileLock(const std::string& path) {
+#ifdef MCLIB_HAS_MMAP
+            fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (fd_ < 0) throw std::runtime_error("ResultCache: cannot open lock " + path);
+            while (::flock(fd_, LOCK_EX) != 0) {
+                if (errno != EINTR) {
+                    ::close(fd_);
+                    throw std::runtime_error("ResultCache: cannot lock " + path);
+                }
+            }
+#else
+            (void)path;
+#endif
+        }
+
+        FileLock(const FileLock&) = delete;
+        FileLock& operator=(const FileLock&) = delete;
+
+        ~FileLock() {
+#ifdef MCLIB_HAS_MMAP
+            ::flock(fd_, LOCK_UN);
+            ::close(fd_);
+#endif
+        }
+
+     private:
+#ifdef MCLIB_HAS_MMAP
+        int fd_ = -1;
+#endif
+    };
+
+    std::string index_path() const { return dir_ + "/index"; }
+
+    std::string entry_path(const CacheKey& key) const {
+        char name[40];
+        std::snprintf(name, sizeof(name), "/%016llx%016llx.res", static_cast<unsigned long long>(key.hi),
+                      static_cast<unsigned long long>(key.lo));
+        return dir_ + name;
+    }
+
+    // Write `bytes` under a unique temporary name, sync, rename into place
+    static void replace_file(const std::string& path, std::span<const std::byte> bytes) {
+        static std::atomic<std::uint64_t> counter{0};
+        const std::string tmp = path + ".tmp" + std::to_string(std::random_device{}()) + "-" +
+                                std::to_string(counter.fetch_add(1, std::memory_order_relaxed));
+        try {
+            WritableFile file = WritableFile::create(tmp);
+            file.write_at(0, bytes);
+            file.sync();
+            file.close();
+            std::filesystem::rename(tmp, path);
+        } catch (...) {
+            std::error_code ignored;
+            std::filesystem::remove(tmp, ignored);
+            throw;
+        }
+    }
+
+    static ResultIndexHeader read_header(const MappedFile& index) {
+        ResultIndexHeader h;
+        if (index.size() < sizeof(h)) throw std::runtime_error("ResultCache: index too short");
+        std::memcpy(&h, index.bytes().data(), sizeof(h));
+        if (std::memcmp(h.magic, kResultIndexMagic, sizeof(h.magic)) != 0 || h.version != kResultIndexVersion ||
+            h.slots == 0 || (h.slots & (h.slots - 1)) != 0 ||
+            h.slots > (index.size() - sizeof(h)) / sizeof(CacheKey)) {
+            throw std::runtime_error("ResultCache: corrupt index");
+        }
+        return h;
+    }
+
+    static std::span<const CacheKey> slots(const MappedFile& index, const ResultIndexHeader& header) {
+        return index.as<CacheKey>(sizeof(ResultIndexHeader)).first(static_cast<std::size_t>(header.slots));
+    }
+
+    static void insert(std::vector<CacheKey>& table, const CacheKey& key) {
+        const std::uint64_t mask = table.size() - 1;
+        std::uint64_t at = key.hi & mask;
+        while (!(table[at] == CacheKey{})) at = (at + 1) & mask;
+        table[at] = key;
+    }
+
+    void write_index(const std::vector<CacheKey>& table, std::uint64_t used) const {
+        ResultIndexHeader header{};
+        std::memcpy(header.magic, kResultIndexMagic, sizeof(header.magic));
+        header.version = kResultIndexVersion;
+        header.slots = table.size();
+        header.used = used;
+        std::vector<std::byte> bytes(sizeof(header) + table.size() * sizeof(CacheKey));
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        std::memcpy(bytes.data() + sizeof(header), table.data(), table.size() * sizeof(CacheKey));
+        replace_file(index_path(), bytes);
+    }
+
+    // Is the key in this object's mapping of the index? Caller holds mutex_
+    bool probe(const CacheKey& key) const {
+        if (index_.size() == 0) return false;
+        const ResultIndexHeader header = read_header(index_);
+        const std::span<const CacheKey> table = slots(index_, header);
+        const std::uint64_t mask = header.slots - 1;
+        for (std::uint64_t at = key.hi & mask;; at = (at + 1) & mask) {
+            if (table[at] == key) return true;
+            if (table[at] == CacheKey{}) return false;
+        }
+    }
+
+    std::optional<CachedResult> read_entry(const CacheKey& key) const {
+        try {
+            const MappedFile file = MappedFile::open(entry_path(key));
+            ByteReader r(file.bytes());
+            r.expect_tag(kEntryTag, "ResultCache entry");
+            if (r.read<std::uint64_t>() != key.hi || r.read<std::uint64_t>() != key.lo) return std::nullopt;
+            CachedResult entry;
+            Result& res = entry.result;
+            r.read(res.estimate);
+            r.read(res.variance);
+            r.read(res.standard_error);
+            r.read(res.iterations);
+            r.read(res.elapsed_ms);
+            r.read(res.setup_ms);
+            r.read(res.merge_ms);
+            const auto workers = r.read<std::size_t>();
+            if (workers > r.remaining() / 24) return std::nullopt;
+            res.workers.resize(workers);
+            for (WorkerStats& s : res.workers) {
+                r.read(s.trials);
+                r.read(s.elapsed_ms);
+                r.read(s.throughput);
+            }
+            const std::span<const std::byte> state = r.read_bytes();
+            entry.state.assign(state.begin(), state.end());
+            return entry;
+        } catch (const std::runtime_error&) {
+            return std::nullopt;  // missing or damaged entry: recompute
+        }
+    }
+
+    std::string dir_;
+    mutable std::mutex mutex_;     // index_
+    mutable MappedFile index_;
+    mutable std::atomic<std::uint64_t> hits_{0};
+    mutable std::atomic<std::uint64_t> misses_{0};
+};
+
+} // namespace montecarlo::io
@@ -0,0 +1,204 @@
+#pragma once
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace montecarlo::io {
+
+// Block codecs for sample files (io/sample_file.hpp)
+enum class SampleCodec : std::uint32_t {
+    None = 0,  // raw doubles, readable in place
+    Xor = 1,   // Gorilla-style XOR of consecutive values
+};
+
+struct SampleCompression {
+    SampleCodec codec = SampleCodec::None;
+    // Mantissa bits kept per value (0..52). Below 52 the codec is lossy:
+    // values are rounded to nearest, a relative error of at most
+    // 2^-(mantissa_bits + 1) for normal numbers, which leaves trailing
+    // zero bits for the XOR step to drop. Zeros, infinities and NaNs pass
+    // unchanged; subnormals may round to zero.
+    int mantissa_bits = 52;
+};
+
+// XOR block format, a stream of 64-bit words in host byte order, bits
+// taken from the most significant end. Each value is coded against the
+// previous value and, when it is not a repeat, against the last non-zero
+// value, so runs of zero payoffs cost a bit each and non-zero payoffs of
+// similar size share their sign and exponent bits:
+//
+//   0                       same as the previous value
+//   111                     +0.0
+//   10  <bits>              XOR with the last non-zero value fits the
+//                           previous window of meaningful bits
+//   110 <lead:6> <len-1:6> <len bits>
+//                           new window: leading zeros and length
+namespace detail {
+
+class BitWriter {
+ public:
+    explicit BitWriter(std::vector<std::byte>& out) : out_(out) {}
+
+    // Append the low n bits of v (n <= 64, higher bits of v clear)
+    void put(std::uint64_t v, unsigned n) {
+        if (n == 0) return;
+        const unsigned space = 64 - used_;
+        if (n < space) {
+            acc_ = (acc_ << n) | v;
+            used_ += n;
+        } else {
+            const unsigned rest = n - space;
+            word(space == 64 ? v >> rest : (acc_ << space) | (v >> rest));
+            acc_ = rest == 0 ? 0 : v & ((std::uint64_t{1} << rest) - 1);
+            used_ = rest;
+        }
+    }
+
+    // Pad the last word with zeros
+    void finish() {
+        if (used_ > 0) word(acc_ << (64 - used_));
+        acc_ = 0;
+        used_ = 0;
+    }
+
+ private:
+    void word(std::uint64_t w) {
+        const std::size_t at = out_.size();
+        out_.resize(at + sizeof(w));
+        std::memcpy(out_.data() + at, &w, sizeof(w));
+    }
+
+    std::vector<std::byte>& out_;
+    std::uint64_t acc_ = 0;
+    unsigned used_ = 0;
+};
+
+class BitReader {
+ public:
+    explicit BitReader(std::span<const std::byte> in) : in_(in) {}
+
+    // Next n bits (n <= 64)
+    std::uint64_t get(unsigned n) {
+        if (n == 0) return 0;
+        if (n <= avail_) {
+            const std::uint64_t v = n == 64 ? acc_ : acc_ >> (64 - n);
+            acc_ = n == 64 ? 0 : acc_ << n;
+            avail_ -= n;
+            return v;
+        }
+        const unsigned have = avail_;
+        const std::uint64_t high = have == 0 ? 0 : acc_ >> (64 - have);
+        acc_ = next_word();
+        avail_ = 64;
+        const unsigned rest = n - have;
+        const std::uint64_t low = get(rest);
+        return have == 0 ? low : (high << rest) | low;
+    }
+
+    bool bit() { return get(1) != 0; }
+
+ private:
+    std::uint64_t next_word() {
+        if (in_.size() - pos_ < sizeof(std::uint64_t)) throw std::runtime_error("SampleCodec: truncated block");
+        std::uint64_t w;
+        std::memcpy(&w, in_.data() + pos_, sizeof(w));
+        pos_ += sizeof(w);
+        return w;
+    }
+
+    std::span<const std::byte> in_;
+    std::size_t pos_ = 0;
+    std::uint64_t acc_ = 0;
+    unsigned avail_ = 0;
+};
+
+// Round to nearest (ties to even) keeping `bits` mantissa bits
+inline std::uint64_t round_mantissa(std::uint64_t u, int bits) {
+    if (bits >= 52) return u;
+    if ((u & 0x7ff0000000000000ULL) == 0x7ff0000000000000ULL) return u;  // inf, NaN
+    const unsigned drop = static_cast<unsigned>(52 - (bits < 0 ? 0 : bits));
+    const std::uint64_t half = std::uint64_t{1} << (drop - 1);
+    std::uint64_t r = (u + (half - 1) + ((u >> drop) & 1)) & ~((std::uint64_t{1} << drop) - 1);
+    if ((r & 0x7ff0000000000000ULL) == 0x7ff0000000000000ULL) {
+        r = u & ~((std::uint64_t{1} << drop) - 1);  // would round up to infinity
+    }
+    return r;
+}
+
+} // namespace detail
+
+// Append the XOR encoding of `values` to `out`; the output grows by a
+// multiple of eight bytes
+inline void xor_encode(std::span<const double> values, std::vector<std::byte>& out, int mantissa_bits = 52) {
+    detail::BitWriter w(out);
+    std::uint64_t previous = 0;
+    std::uint64_t reference = 0;  // last non-zero value
+    unsigned lead = 64;           // no window yet
+    unsigned trail = 0;
+    for (double value : values) {
+        const std::uint64_t u = detail::round_mantissa(std::bit_cast<std::uint64_t>(value), mantissa_bits);
+        if (u == previous) {
+            w.put(0, 1);
+            continue;
+        }
+        previous = u;
+        if (u == 0) {
+            w.put(0b111, 3);
+            continue;
+        }
+        const std::uint64_t x = u ^ reference;
+        reference = u;
+        const auto l = static_cast<unsigned>(std::countl_zero(x));
+        const auto t = static_cast<unsigned>(std::countr_zero(x));
+        if (lead < 64 && l >= lead && t >= trail) {
+            w.put(0b10, 2);
+            w.put(x >> trail, 64 - lead - trail);
+        } else {
+            // x == 0 (back to the reference after a zero) with no window yet
+            // takes a one-bit window
+            lead = x == 0 ? 63 : l;
+            trail = x == 0 ? 0 : t;
+            const unsigned len = 64 - lead - trail;
+            w.put(0b110, 3);
+            w.put(lead, 6);
+            w.put(len - 1, 6);
+            w.put(x >> trail, len);
+        }
+    }
+    w.finish();
+}
+
+// Decode values.size() values written by xor_encode
+inline void xor_decode(std::span<const std::byte> in, std::span<double> values) {
+    detail::BitReader r(in);
+    std::uint64_t previous = 0;
+    std::uint64_t reference = 0;
+    unsigned lead = 64;
+    unsigned trail = 0;
+    for (double& value : values) {
+        if (r.bit()) {
+            if (!r.bit()) {
+                if (lead == 64) throw std::runtime_error("SampleCodec: corrupt block");
+                reference ^= r.get(64 - lead - trail) << trail;
+                previous = reference;
+            } else if (r.bit()) {
+                previous = 0;
+            } else {
+                lead = static_cast<unsigned>(r.get(6));
+                const auto len = static_cast<unsigned>(r.get(6)) + 1;
+                if (lead + len > 64) throw std::runtime_error("SampleCodec: corrupt block");
+                trail = 64 - lead - len;
+                reference ^= r.get(len) << trail;
+                previous = reference;
+            }
+        }
+        value = std::bit_cast<double>(previous);
+    }
+}
+
+} // namespace montecarlo::io
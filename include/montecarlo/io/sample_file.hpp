@@ -0,0 +1,591 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "mapped_file.hpp"
+#include "sample_codec.hpp"
+#include "writable_file.hpp"
+
+namespace montecarlo::io {
+
+// Columnar sample file
+//
+//   header   64 bytes, SampleFileHeader
+//   blocks   per block: `count` doubles, then `count` uint64 trial
+//            indices if the file has the trial-index column
+//   index    block_count SampleBlockEntry records at index_offset
+//
+// Columns are stored in host byte order so a mapped file can be read in
+// place; the header records the byte order and readers reject a mismatch.
+// Every block holds one stream's contiguous trials, so the stream id and
+// first trial index live in the block index. index_offset stays 0 until
+// the writer finishes, which marks a file that was not closed.
+//
+// A compressed file (version 2, codec != None) stores each block as a
+// uint64 payload size and the codec's payload, padded to eight bytes; the
+// trial-index column is not stored, as the reader can rebuild it from
+// first_trial. Uncompressed files are still written as version 1.
+struct SampleFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t flags;
+    std::uint32_t codec;  // SampleCodec
+    std::uint64_t block_count;
+    std::uint64_t sample_count;
+    std::uint64_t index_offset;
+    std::uint64_t padding[2];
+};
+static_assert(sizeof(SampleFileHeader) == 64);
+
+struct SampleBlockEntry {
+    std::uint64_t offset;
+    std::uint64_t count;
+    std::uint64_t stream_id;
+    std::uint64_t first_trial;
+};
+static_assert(sizeof(SampleBlockEntry) == 32);
+
+inline constexpr char kSampleFileMagic[8] = {'M', 'C', 'S', 'A', 'M', 'P', 'L', 'E'};
+inline constexpr std::uint32_t kSampleFileVersion = 2;
+inline constexpr std::uint32_t kSampleByteOrder = 0x01020304;
+inline constexpr std::uint32_t kSampleTrialIndex = 1;  // flag: trial-index column present
+
+namespace detail {
+
+// Bounded lock-free ring for exactly one producer and one consumer thread
+template<typename T>
+class SpscRing {
+ public:
+    explicit SpscRing(std::size_t capacity) :
+        slots_(std::bit_ceil(std::max<std::size_t>(capacity, 2))), mask_(slots_.size() - 1) {}
+
+    bool push(T value) {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == slots_.size()) return false;
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        value = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+ private:
+    std::vector<T> slots_;
+    std::size_t mask_;
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+} // namespace detail
+
+class SampleFileWriter;
+
+// A block of one stream's contiguous trials, travelling to the writer thread
+struct SampleBuffer {
+    std::uint64_t stream_id = 0;
+    std::uint64_t first_trial = 0;
+    std::vector<double> values;
+};
+
+// One producer's link to an asynchronous SampleFileWriter: a ring of full
+// buffers to the writer thread and a ring of emptied ones back. Only one
+// thread may submit through a channel.
+class SampleChannel {
+ public:
+    SampleChannel(SampleFileWriter& owner, std::size_t buffers) :
+        owner_(&owner), full_(buffers), free_(buffers) {
+        for (std::size_t i = 0; i < buffers; ++i) {
+            buffers_.push_back(std::make_unique<SampleBuffer>());
+            free_.push(buffers_.back().get());
+        }
+    }
+
+    // Queue `values` as a block and hand back a recycled (empty) vector in
+    // its place. Waits while every buffer of the channel is in flight,
+    // which is the backpressure when the disk falls behind.
+    void submit(std::uint64_t stream_id, std::uint64_t first_trial, std::vector<double>& values);
+
+ private:
+    friend class SampleFileWriter;
+
+    // Writer thread: return an emptied buffer and wake the producer
+    void recycle(SampleBuffer* buffer) {
+        buffer->values.clear();
+        free_.push(buffer);
+        returned_.fetch_add(1, std::memory_order_release);
+        returned_.notify_one();
+    }
+
+    SampleFileWriter* owner_;
+    std::vector<std::unique_ptr<SampleBuffer>> buffers_;
+    detail::SpscRing<SampleBuffer*> full_;
+    detail::SpscRing<SampleBuffer*> free_;
+    std::atomic<std::uint32_t> returned_{0};
+};
+
+// Appends blocks to a sample file; thread-safe, so workers can share one.
+// The index and final header are written by finish() or the destructor.
+//
+// With async_buffers > 0 a dedicated writer thread does the I/O: each
+// producer connect()s a SampleChannel and submits filled buffers through
+// it, the writer gathers whatever is queued across channels into one
+// pwritev() at the end of the file, and the emptied buffers go straight
+// back to their producers. A producer owns async_buffers buffers, so
+// memory stays bounded and producers wait when the disk cannot keep up.
+class SampleFileWriter {
+ public:
+    SampleFileWriter(std::string path, bool trial_index, std::size_t async_buffers = 0,
+                     SampleCompression compression = {}) :
+        path_(std::move(path)), flags_(trial_index ? kSampleTrialIndex : 0), async_buffers_(async_buffers),
+        compression_(compression) {
+        truncate();
+    }
+
+    // Continue a file at a known state, dropping anything written after it
+    SampleFileWriter(std::string path, std::uint32_t flags, std::vector<SampleBlockEntry> index,
+                     std::uint64_t data_end, std::size_t async_buffers = 0, SampleCompression compression = {}) :
+        path_(std::move(path)), flags_(flags), async_buffers_(async_buffers), compression_(compression),
+        index_(std::move(index)), data_end_(data_end) {
+        for (const SampleBlockEntry& e : index_) samples_ += e.count;
+        file_ = WritableFile::resume(path_, data_end_);
+        write_header(0);  // unfinished again until finish()
+        start();
+    }
+
+    SampleFileWriter(const SampleFileWriter&) = delete;
+    SampleFileWriter& operator=(const SampleFileWriter&) = delete;
+
+    ~SampleFileWriter() {
+        try {
+            finish();
+        } catch (...) {
+            // Destructors must not throw; an unfinished file is detectable
+        }
+        stop();
+    }
+
+    // Synchronous append from any thread; compression runs on the caller
+    void append(std::uint64_t stream_id, std::uint64_t first_trial, std::span<const double> values) {
+        if (values.empty()) return;
+        std::vector<std::byte> payload;
+        if (compressed()) encode(values, payload);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (finished_) throw std::logic_error("SampleFileWriter: append after finish");
+        const BlockRef block{stream_id, first_trial, values, payload};
+        write_blocks(std::span<const BlockRef>(&block, 1));
+    }
+
+    bool async() const { return async_buffers_ > 0; }
+
+    // A new producer channel; async writers only
+    std::shared_ptr<SampleChannel> connect() {
+        if (!async()) throw std::logic_error("SampleFileWriter::connect: writer is synchronous");
+        auto channel = std::make_shared<SampleChannel>(*this, async_buffers_);
+        std::lock_guard<std::mutex> lock(channels_mutex_);
+        channels_.push_back(channel);
+        return channel;
+    }
+
+    // Wait until every submitted block is in the file
+    void drain() const {
+        const std::uint64_t target = submitted_.load(std::memory_order_acquire);
+        for (std::uint64_t done = written_.load(std::memory_order_acquire); done < target;
+             done = written_.load(std::memory_order_acquire)) {
+            written_.wait(done, std::memory_order_acquire);
+        }
+    }
+
+    // Write the block index and the final header; later calls do nothing
+    void finish() {
+        stop();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (finished_) return;
+        if (failed_) throw std::runtime_error("SampleFileWriter: a background write failed on " + path_);
+        const auto* index = reinterpret_cast<const std::byte*>(index_.data());
+        file_.write_at(data_end_, std::span<const std::byte>(index, index_.size() * sizeof(SampleBlockEntry)));
+        write_header(data_end_);
+        file_.flush();
+        file_.close();
+        finished_ = true;
+    }
+
+    // Drop every block and start the file again
+    void truncate() {
+        drain();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            index_.clear();
+            samples_ = 0;
+            data_end_ = sizeof(SampleFileHeader);
+            finished_ = false;
+            failed_ = false;
+            file_ = WritableFile::create(path_);
+            write_header(0);
+        }
+        start();
+    }
+
+    // Copy another file's blocks (already written or drained) into this one,
+    // re-encoded with this file's compression
+    void append_file(const SampleFileWriter& other) {
+        other.drain();
+        const std::vector<SampleBlockEntry> index = other.index();
+        std::ifstream in(other.path_, std::ios::binary);
+        if (!in) throw std::runtime_error("SampleFileWriter: cannot read " + other.path_);
+        std::vector<double> values;
+        std::vector<std::byte> payload;
+        for (const SampleBlockEntry& e : index) {
+            values.resize(e.count);
+            in.seekg(static_cast<std::streamoff>(e.offset));
+            if (other.compressed()) {
+                std::uint64_t bytes = 0;
+                in.read(reinterpret_cast<char*>(&bytes), sizeof(bytes));
+                payload.resize(in ? bytes : 0);
+                in.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+                if (in) xor_decode(payload, values);
+            } else {
+                in.read(reinterpret_cast<char*>(values.data()),
+                        static_cast<std::streamsize>(e.count * sizeof(double)));
+            }
+            if (!in) throw std::runtime_error("SampleFileWriter: short read on " + other.path_);
+            append(e.stream_id, e.first_trial, values);
+        }
+    }
+
+    const std::string& path() const { return path_; }
+    std::uint32_t flags() const { return flags_; }
+    std::size_t async_buffers() const { return async_buffers_; }
+    SampleCompression compression() const { return compression_; }
+    bool compressed() const { return compression_.codec != SampleCodec::None; }
+
+    // Snapshot of the resumable state; drain() first for a quiescent one
+    std::vector<SampleBlockEntry> index() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return index_;
+    }
+
+    std::uint64_t data_end() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return data_end_;
+    }
+
+    // Wait for queued blocks and push them to the OS
+    void flush() {
+        drain();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!finished_) file_.flush();
+    }
+
+ private:
+    friend class SampleChannel;
+
+    // Most blocks gathered into one write
+    static constexpr std::size_t kMaxBatch = 64;
+
+    struct BlockRef {
+        std::uint64_t stream_id;
+        std::uint64_t first_trial;
+        std::span<const double> values;
+        std::span<const std::byte> payload;  // compressed files: encode()d values
+    };
+
+    // Stored form of a compressed block: payload size, then the payload
+    void encode(std::span<const double> values, std::vector<std::byte>& out) const {
+        out.resize(sizeof(std::uint64_t));
+        xor_encode(values, out, compression_.mantissa_bits);
+        const std::uint64_t bytes = out.size() - sizeof(std::uint64_t);
+        std::memcpy(out.data(), &bytes, sizeof(bytes));
+    }
+
+    void write_header(std::uint64_t index_offset) {
+        SampleFileHeader header{};
+        std::memcpy(header.magic, kSampleFileMagic, sizeof(header.magic));
+        header.version = compressed() ? kSampleFileVersion : 1;
+        header.byte_order = kSampleByteOrder;
+        header.flags = flags_;
+        header.codec = static_cast<std::uint32_t>(compression_.codec);
+        header.block_count = index_.size();
+        header.sample_count = samples_;
+        header.index_offset = index_offset;
+        file_.write_at(0, std::as_bytes(std::span<const SampleFileHeader>(&header, 1)));
+    }
+
+    // Append the blocks back to back with one positional write; caller
+    // holds mutex_
+    void write_blocks(std::span<const BlockRef> blocks) {
+        const bool trials = flags_ & kSampleTrialIndex;
+        pieces_.clear();
+        trial_scratch_.resize(blocks.size());
+        std::uint64_t offset = data_end_;
+        for (std::size_t b = 0; b < blocks.size(); ++b) {
+            const BlockRef& block = blocks[b];
+            index_.push_back({offset, block.values.size(), block.stream_id, block.first_trial});
+            samples_ += block.values.size();
+            if (compressed()) {
+                pieces_.push_back(block.payload);
+                offset += block.payload.size();
+                continue;
+            }
+            pieces_.push_back(std::as_bytes(block.values));
+            offset += block.values.size() * sizeof(double);
+            if (trials) {
+                std::vector<std::uint64_t>& column = trial_scratch_[b];
+                column.resize(block.values.size());
+                for (std::size_t i = 0; i < column.size(); ++i) column[i] = block.first_trial + i;
+                pieces_.push_back(std::as_bytes(std::span<const std::uint64_t>(column)));
+                offset += column.size() * sizeof(std::uint64_t);
+            }
+        }
+        file_.write_at(data_end_, pieces_);
+        data_end_ = offset;
+    }
+
+    void start() {
+        if (!async() || thread_.joinable()) return;
+        stopping_.store(false, std::memory_order_release);
+        thread_ = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        if (!thread_.joinable()) return;
+        stopping_.store(true, std::memory_order_release);
+        work_.fetch_add(1, std::memory_order_release);
+        work_.notify_one();
+        thread_.join();
+    }
+
+    void notify_work() {
+        work_.fetch_add(1, std::memory_order_release);
+        work_.notify_one();
+    }
+
+    // Writer thread: gather queued buffers across channels, compress them
+    // if the file is compressed, write them in one go, recycle them; sleep
+    // on work_ when every queue is empty
+    void run() {
+        std::vector<std::shared_ptr<SampleChannel>> channels;
+        std::vector<std::pair<SampleChannel*, SampleBuffer*>> taken;
+        std::vector<BlockRef> blocks;
+        std::vector<std::vector<std::byte>> payloads(compressed() ? kMaxBatch : 0);
+        for (;;) {
+            const std::uint32_t signal = work_.load(std::memory_order_acquire);
+            {
+                std::lock_guard<std::mutex> lock(channels_mutex_);
+                // Channels whose producer is gone and whose queue is empty
+                std::erase_if(channels_, [](const std::shared_ptr<SampleChannel>& c) {
+                    return c.use_count() == 1 && c->full_.empty();
+                });
+                channels = channels_;
+            }
+            taken.clear();
+            for (const auto& channel : channels) {
+                SampleBuffer* buffer = nullptr;
+                while (taken.size() < kMaxBatch && channel->full_.pop(buffer)) taken.emplace_back(channel.get(), buffer);
+            }
+            channels.clear();
+            if (taken.empty()) {
+                if (stopping_.load(std::memory_order_acquire)) return;
+                work_.wait(signal, std::memory_order_acquire);
+                continue;
+            }
+            blocks.clear();
+            for (const auto& [channel, buffer] : taken) {
+                std::span<const std::byte> payload;
+                if (compressed()) {
+                    std::vector<std::byte>& out = payloads[blocks.size()];
+                    encode(buffer->values, out);
+                    payload = out;
+                }
+                blocks.push_back({buffer->stream_id, buffer->first_trial, buffer->values, payload});
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                try {
+                    write_blocks(blocks);
+                } catch (...) {
+                    // Keep the pipeline moving; finish() reports the loss
+                    failed_ = true;
+                }
+            }
+            for (const auto& [channel, buffer] : taken) channel->recycle(buffer);
+            written_.fetch_add(taken.size(), std::memory_order_release);
+            written_.notify_all();
+        }
+    }
+
+    std::string path_;
+    std::uint32_t flags_;
+    std::size_t async_buffers_;
+    SampleCompression compression_;
+    mutable std::mutex mutex_;  // file_, index_ and the counters below
+    WritableFile file_;
+    std::vector<SampleBlockEntry> index_;
+    std::uint64_t data_end_ = sizeof(SampleFileHeader);
+    std::uint64_t samples_ = 0;
+    bool finished_ = false;
+    bool failed_ = false;
+    std::vector<std::span<const std::byte>> pieces_;
+    std::vector<std::vector<std::uint64_t>> trial_scratch_;
+
+    std::mutex channels_mutex_;
+    std::vector<std::shared_ptr<SampleChannel>> channels_;
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<std::uint32_t> work_{0};
+    std::atomic<std::uint64_t> submitted_{0};
+    mutable std::atomic<std::uint64_t> written_{0};
+};
+
+inline void SampleChannel::submit(std::uint64_t stream_id, std::uint64_t first_trial, std::vector<double>& values) {
+    if (values.empty()) return;
+    SampleBuffer* buffer = nullptr;
+    std::uint32_t seen = returned_.load(std::memory_order_acquire);
+    while (!free_.pop(buffer)) {
+        returned_.wait(seen, std::memory_order_acquire);
+        seen = returned_.load(std::memory_order_acquire);
+    }
+    buffer->stream_id = stream_id;
+    buffer->first_trial = first_trial;
+    std::swap(buffer->values, values);
+    owner_->submitted_.fetch_add(1, std::memory_order_acq_rel);
+    full_.push(buffer);
+    owner_->notify_work();
+}
+
+// One block of a mapped sample file; the spans point into the mapping
+struct SampleBlock {
+    std::uint64_t stream_id;
+    std::uint64_t first_trial;
+    std::span<const double> values;
+    std::span<const std::uint64_t> trials;  // empty without the trial-index column
+};
+
+// Zero-copy reader: the file is mapped once and every column is handed out
+// as a span into the mapping. Blocks of a compressed file are decoded one
+// at a time into caller-provided buffers instead.
+class SampleFile {
+ public:
+    static SampleFile open(const std::string& path) {
+        SampleFile file;
+        file.map_ = MappedFile::open(path);
+        const std::span<const std::byte> bytes = file.map_.bytes();
+        if (bytes.size() < sizeof(SampleFileHeader)) throw std::runtime_error("SampleFile: too short: " + path);
+        std::memcpy(&file.header_, bytes.data(), sizeof(SampleFileHeader));
+        const SampleFileHeader& h = file.header_;
+        if (std::memcmp(h.magic, kSampleFileMagic, sizeof(h.magic)) != 0) {
+            throw std::runtime_error("SampleFile: not a sample file: " + path);
+        }
+        if (h.version == 0 || h.version > kSampleFileVersion || (h.version == 1 && h.codec != 0) ||
+            h.codec > static_cast<std::uint32_t>(SampleCodec::Xor)) {
+            throw std::runtime_error("SampleFile: unsupported version: " + path);
+        }
+        if (h.byte_order != kSampleByteOrder) throw std::runtime_error("SampleFile: foreign byte order: " + path);
+        if (h.index_offset == 0) throw std::runtime_error("SampleFile: writer did not finish: " + path);
+        if (h.index_offset > bytes.size() ||
+            h.block_count > (bytes.size() - h.index_offset) / sizeof(SampleBlockEntry)) {
+            throw std::runtime_error("SampleFile: truncated index: " + path);
+        }
+        const std::size_t row = sizeof(double) + (h.flags & kSampleTrialIndex ? sizeof(std::uint64_t) : 0);
+        file.index_ = file.map_.as<SampleBlockEntry>(static_cast<std::size_t>(h.index_offset))
+                          .first(static_cast<std::size_t>(h.block_count));
+        for (const SampleBlockEntry& e : file.index_) {
+            if (e.offset % alignof(double) != 0 || e.offset > h.index_offset) {
+                throw std::runtime_error("SampleFile: corrupt block index: " + path);
+            }
+            if (file.compressed()) {
+                // Every value takes at least one bit of payload
+                const std::span<const std::byte> payload = file.payload(e);
+                if (payload.data() == nullptr || e.count > payload.size() * 8) {
+                    throw std::runtime_error("SampleFile: corrupt block index: " + path);
+                }
+            } else if (e.count > (h.index_offset - e.offset) / row) {
+                throw std::runtime_error("SampleFile: corrupt block index: " + path);
+            }
+        }
+        return file;
+    }
+
+    std::size_t blocks() const { return index_.size(); }
+    std::uint64_t count() const { return header_.sample_count; }
+    bool has_trial_index() const { return header_.flags & kSampleTrialIndex; }
+    SampleCodec codec() const { return static_cast<SampleCodec>(header_.codec); }
+    bool compressed() const { return codec() != SampleCodec::None; }
+
+    // Block i in place; uncompressed files only
+    SampleBlock block(std::size_t i) const {
+        if (compressed()) throw std::logic_error("SampleFile::block: compressed file, pass decode buffers");
+        const SampleBlockEntry& e = index_[i];
+        const auto n = static_cast<std::size_t>(e.count);
+        SampleBlock out{e.stream_id, e.first_trial, map_.as<double>(static_cast<std::size_t>(e.offset)).first(n), {}};
+        if (has_trial_index()) {
+            out.trials = map_.as<std::uint64_t>(static_cast<std::size_t>(e.offset) + n * sizeof(double)).first(n);
+        }
+        return out;
+    }
+
+    // Block i of any file: in place when uncompressed, otherwise decoded
+    // into `values` (and `trials` if the file has the trial-index column)
+    SampleBlock block(std::size_t i, std::vector<double>& values, std::vector<std::uint64_t>& trials) const {
+        if (!compressed()) return block(i);
+        const SampleBlockEntry& e = index_[i];
+        values.resize(static_cast<std::size_t>(e.count));
+        xor_decode(payload(e), values);
+        SampleBlock out{e.stream_id, e.first_trial, values, {}};
+        if (has_trial_index()) {
+            trials.resize(values.size());
+            for (std::size_t k = 0; k < trials.size(); ++k) trials[k] = e.first_trial + k;
+            out.trials = trials;
+        }
+        return out;
+    }
+
+    // Visit every block; a compressed file reuses one pair of buffers, so
+    // the spans are only valid during the call
+    template<typename F>
+    void for_each_block(F&& f) const {
+        std::vector<double> values;
+        std::vector<std::uint64_t> trials;
+        for (std::size_t i = 0; i < blocks(); ++i) f(block(i, values, trials));
+    }
+
+ private:
+    // Payload of a compressed block, or an empty span without data if the
+    // size runs past the data section
+    std::span<const std::byte> payload(const SampleBlockEntry& e) const {
+        const std::span<const std::byte> data = map_.bytes().first(static_cast<std::size_t>(header_.index_offset));
+        if (data.size() - e.offset < sizeof(std::uint64_t)) return {};
+        std::uint64_t bytes = 0;
+        std::memcpy(&bytes, data.data() + e.offset, sizeof(bytes));
+        if (bytes > data.size() - e.offset - sizeof(bytes)) return {};
+        return data.subspan(static_cast<std::size_t>(e.offset) + sizeof(bytes), static_cast<std::size_t>(bytes));
+    }
+
+    MappedFile map_;
+    SampleFileHeader header_{};
+    std::span<const SampleBlockEntry> index_;
+};
+
+} // namespace montecarlo::io
@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "mapped_file.hpp"
+
+#ifdef MCLIB_HAS_MMAP
+#include <climits>
+#include <sys/uio.h>
+#endif
+
+namespace montecarlo::io {
+
+// Positional writes to a file: pwritev(2) where available, so several
+// buffers go out in one system call at an explicit offset with no shared
+// file position; otherwise a std::fstream. Move-only.
+class WritableFile {
+ public:
+    WritableFile() = default;
+
+    // Create or truncate
+    static WritableFile create(const std::string& path) {
+        WritableFile file;
+        file.path_ = path;
+#ifdef MCLIB_HAS_MMAP
+        file.fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (file.fd_ < 0) fail("open", path);
+#else
+        file.out_.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.out_) fail("open", path);
+#endif
+        return file;
+    }
+
+    // Open an existing file cut to `size` bytes
+    static WritableFile resume(const std::string& path, std::uint64_t size) {
+        std::filesystem::resize_file(path, size);
+        WritableFile file;
+        file.path_ = path;
+#ifdef MCLIB_HAS_MMAP
+        file.fd_ = ::open(path.c_str(), O_RDWR);
+        if (file.fd_ < 0) fail("open", path);
+#else
+        file.out_.open(path, std::ios::in | std::ios::out | std::ios::binary);
+        if (!file.out_) fail("open", path);
+#endif
+        return file;
+    }
+
+    WritableFile(WritableFile&& other) noexcept { swap(other); }
+
+    WritableFile& operator=(WritableFile&& other) noexcept {
+        if (this != &other) {
+            WritableFile tmp(std::move(other));
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    WritableFile(const WritableFile&) = delete;
+    WritableFile& operator=(const WritableFile&) = delete;
+
+    ~WritableFile() { close(); }
+
+    // Write the pieces back to back starting at `offset`
+    void write_at(std::uint64_t offset, std::span<const std::span<const std::byte>> pieces) {
+#ifdef MCLIB_HAS_MMAP
+        std::vector<iovec> iov;
+        iov.reserve(pieces.size());
+        for (std::span<const std::byte> p : pieces) {
+            if (!p.empty()) iov.push_back({const_cast<std::byte*>(p.data()), p.size()});
+        }
+        std::size_t first = 0;
+        while (first < iov.size()) {
+            const int n = static_cast<int>(std::min<std::size_t>(iov.size() - first, IOV_MAX));
+            const ssize_t written = ::pwritev(fd_, iov.data() + first, n, static_cast<off_t>(offset));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                fail("pwritev", path_);
+            }
+            // Skip what went out; a short write resumes mid-buffer
+            offset += static_cast<std::uint64_t>(written);
+            std::size_t left = static_cast<std::size_t>(written);
+            while (first < iov.size() && left >= iov[first].iov_len) {
+                left -= iov[first].iov_len;
+                ++first;
+            }
+            if (left > 0) {
+                iov[first].iov_base = static_cast<std::byte*>(iov[first].iov_base) + left;
+                iov[first].iov_len -= left;
+            }
+        }
+#else
+        out_.seekp(static_cast<std::streamoff>(offset));
+        for (std::span<const std::byte> p : pieces) {
+            out_.write(reinterpret_cast<const char*>(p.data()), static_cast<std::streamsize>(p.size()));
+        }
+        if (!out_) fail("write", path_);
+#endif
+    }
+
+    void write_at(std::uint64_t offset, std::span<const std::byte> bytes) {
+        write_at(offset, std::span<const std::span<const std::byte>>(&bytes, 1));
+    }
+
+    // Hand buffered data to the OS (a no-op for pwritev)
+    void flush() {
+#ifndef MCLIB_HAS_MMAP
+        out_.flush();
+        if (!out_) fail("flush", path_);
+#endif
+    }
+
+    // Push the data through to the storage device (fsync where available)
+    void sync() {
+#ifdef MCLIB_HAS_MMAP
+        if (::fsync(fd_) != 0) fail("fsync", path_);
+#else
+        flush();
+#endif
+    }
+
+    void close() {
+#ifdef MCLIB_HAS_MMAP
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+#else
+        if (out_.is_open()) out_.close();
+#endif
+    }
+
+    bool is_open() const {
+#ifdef MCLIB_HAS_MMAP
+        return fd_ >= 0;
+#else
+        return out_.is_open();
+#endif
+    }
+
+    const std::string& path() const { return path_; }
+
+ private:
+    [[noreturn]] static void fail(const char* what, const std::string& path) {
+#ifdef MCLIB_HAS_MMAP
+        throw std::runtime_error(std::string("WritableFile: ") + what + " " + path + ": " + std::strerror(errno));
+#else
+        throw std::runtime_error(std::string("WritableFile: ") + what + " " + path);
+#endif
+    }
+
+    void swap(WritableFile& other) noexcept {
+        std::swap(path_, other.path_);
+#ifdef MCLIB_HAS_MMAP
+        std::swap(fd_, other.fd_);
+#else
+        std::swap(out_, other.out_);
+#endif
+    }
+
+    std::string path_;
+#ifdef MCLIB_HAS_MMAP
+    int fd_ = -1;
+#else
+    std::fstream out_;
+#endif
+};
+
+} // namespace montecarlo::io
@@ -2,8 +2,28 @@
 // One-stop header for the Monte Carlo bits
 #include "core/concepts.hpp"
 #include "core/result.hpp"
+#include "core/quantile.hpp"
+#include "core/log_histogram.hpp"
+#include "core/moments.hpp"
+#include "core/covariance.hpp"
+#include "core/tail.hpp"
+#include "core/tuple.hpp"
+#include "core/batch_means.hpp"
+#include "core/reproducible.hpp"
+#include "core/reservoir.hpp"
+#include "core/grouped.hpp"
+#include "core/convergence.hpp"
+#include "core/exact_quantile.hpp"
+#include "core/density.hpp"
+#include "core/sparse_histogram.hpp"
+#include "core/sample_sink.hpp"
+#include "core/report.hpp"
+#include "core/bootstrap.hpp"
+#include "core/config_hash.hpp"
 #include "core/transform.hpp"
 #include "execution/sequential.hpp"
+#include "execution/batch.hpp"
+#include "execution/checkpoint.hpp"
 #ifdef MCLIB_PARALLEL_ENABLED
 #include "execution/parallel.hpp"
 #endif
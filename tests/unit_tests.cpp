@@ -1,12 +1,20 @@
 #include "montecarlo/montecarlo.hpp"
 #include "stub_rng.hpp"
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <numbers>
 #include <random>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -117,6 +125,1872 @@ void test_welford_reset() {
     EXPECT_NEAR(agg.variance(), 0.0, 1e-12, "reset clears variance");
 }
 
+// Batch path should agree with one-at-a-time adds, including partial blocks
+void test_welford_batch_matches_scalar() {
+    std::vector<double> values(5'003);
+    auto rng = make_rng(7);
+    std::uniform_real_distribution<double> dist(-3.0, 5.0);
+    for (double& v : values) {
+        v = dist(rng);
+    }
+
+    WelfordAggregator<> scalar;
+    for (double v : values) {
+        scalar.add(v);
+    }
+    WelfordAggregator<> batched;
+    batched.add_batch(std::span<const double>(values.data(), 17));
+    batched.add_batch(std::span<const double>(values.data() + 17, values.size() - 17));
+
+    EXPECT_EQ(batched.count(), scalar.count(), "batch count");
+    EXPECT_NEAR(batched.result(), scalar.result(), 1e-12, "batch mean");
+    EXPECT_NEAR(batched.variance(), scalar.variance(), 1e-10, "batch variance");
+}
+
+// Shifted block sums must not lose the variance under a large offset
+void test_welford_batch_large_offset() {
+    std::vector<double> values;
+    for (int i = 0; i < 10'000; ++i) {
+        values.push_back(1e9 + static_cast<double>(i % 4));
+    }
+    WelfordAggregator<> agg;
+    agg.add_batch(values);
+
+    EXPECT_NEAR(agg.result(), 1e9 + 1.5, 1e-6, "offset mean");
+    EXPECT_NEAR(agg.variance(), 1.25 * 10'000.0 / 9'999.0, 1e-6, "offset variance");
+}
+
+// t-digest quantiles should track the exact order statistics
+void test_tdigest_quantiles() {
+    auto rng = make_rng(11);
+    std::exponential_distribution<double> dist(1.0);
+    std::vector<double> values(200'000);
+    for (double& v : values) {
+        v = dist(rng);
+    }
+
+    TDigestAggregator digest(200.0);
+    digest.add_batch(values);
+    std::sort(values.begin(), values.end());
+
+    // Compare in rank space, which is what the digest bounds
+    for (double q : {0.5, 0.99, 0.999}) {
+        auto pos = std::lower_bound(values.begin(), values.end(), digest.quantile(q));
+        double rank = static_cast<double>(pos - values.begin()) / static_cast<double>(values.size());
+        EXPECT_NEAR(rank, q, q < 0.999 ? 1e-3 : 2e-4, "quantile " << q);
+    }
+    EXPECT_EQ(digest.count(), values.size(), "digest count");
+    EXPECT_NEAR(digest.cdf(digest.quantile(0.99)), 0.99, 1e-3, "cdf inverts quantile");
+    EXPECT_TRUE(digest.centroids().size() <= 400, "bounded centroid count");
+}
+
+// Parallel runs merge per-thread digests into one
+void test_tdigest_parallel_merge() {
+#ifdef MCLIB_PARALLEL_ENABLED
+    auto engine = make_engine<Uniform01Model, execution::Parallel, TDigestAggregator>(
+        Uniform01Model{}, execution::Parallel{4}, 99);
+    TDigestAggregator digest(100.0);
+    auto result = engine.run(100'000, digest);
+
+    EXPECT_EQ(digest.count(), 100'000u, "merged count");
+    EXPECT_NEAR(digest.compression(), 100.0, 1e-12, "configuration survives the run");
+    EXPECT_NEAR(result.estimate, 0.5, 0.01, "median of uniform");
+    EXPECT_NEAR(digest.quantile(0.99), 0.99, 0.002, "p99 of uniform");
+
+    // Once flushed, const queries only read and can run concurrently
+    digest.add(0.25);
+    digest.flush();
+    const double p99 = digest.quantile(0.99);
+    const double below = digest.cdf(0.25);
+    std::atomic<int> agree{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&] {
+            if (digest.quantile(0.99) == p99 && digest.cdf(0.25) == below) ++agree;
+        });
+    }
+    for (auto& reader : readers) reader.join();
+    EXPECT_EQ(agree.load(), 4, "concurrent queries after flush()");
+#else
+    std::cout << "[skip] tdigest parallel merge (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+}
+
+// Log-bucketed histogram needs no range and keeps relative precision
+void test_log_histogram_quantiles() {
+    auto rng = make_rng(21);
+    std::lognormal_distribution<double> dist(0.0, 4.0);
+    std::vector<double> values(100'000);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        // Spans many decades, with a block of exact zeros and some losses
+        values[i] = i % 10 == 0 ? 0.0 : (i % 7 == 0 ? -dist(rng) : dist(rng));
+    }
+
+    LogHistogramAggregator hist(7);
+    hist.add_batch(values);
+    std::sort(values.begin(), values.end());
+
+    EXPECT_EQ(hist.count(), values.size(), "log histogram count");
+    for (double q : {0.01, 0.2, 0.5, 0.99, 0.999}) {
+        std::size_t rank = static_cast<std::size_t>(std::ceil(q * static_cast<double>(values.size()))) - 1;
+        double exact = values[rank];
+        EXPECT_NEAR(hist.quantile(q), exact, std::abs(exact) * hist.relative_precision() + 1e-300,
+            "log histogram quantile " << q);
+    }
+    EXPECT_NEAR(hist.quantile(0.0), values.front(), 0.0, "min is exact");
+    EXPECT_NEAR(hist.quantile(1.0), values.back(), 0.0, "max is exact");
+}
+
+// Merged halves should equal one histogram over everything
+void test_log_histogram_merge() {
+    LogHistogramAggregator a;
+    LogHistogramAggregator b;
+    LogHistogramAggregator all;
+    for (int i = 1; i <= 1000; ++i) {
+        double v = std::pow(1.1, i % 200) * (i % 3 == 0 ? -1.0 : 1.0);
+        (i < 400 ? a : b).add(v);
+        all.add(v);
+    }
+    a.merge(b);
+
+    EXPECT_EQ(a.count(), all.count(), "merged count");
+    EXPECT_NEAR(a.result(), all.result(), 1e-9 * std::abs(all.result()), "merged mean");
+    for (double q : {0.1, 0.5, 0.9}) {
+        EXPECT_NEAR(a.quantile(q), all.quantile(q), 0.0, "merged quantile " << q);
+    }
+}
+
+// Histograms merge bin-wise instead of replaying per-thread means
+void test_histogram_merge() {
+    HistogramAggregator<> a(10, 0.0, 1.0);
+    HistogramAggregator<> b(10, 0.0, 1.0);
+    for (int i = 0; i < 100; ++i) {
+        a.add(0.05 + 0.1 * (i % 10));
+        b.add(0.95);
+    }
+    b.add(2.0);  // out of range: counted, not binned
+    a.merge(b);
+
+    EXPECT_EQ(a.count(), 201u, "merged count");
+    EXPECT_EQ(a.histogram()[0], 10u, "first bin");
+    EXPECT_EQ(a.histogram()[9], 110u, "last bin");
+
+    bool threw = false;
+    try {
+        a.merge(HistogramAggregator<>(5, 0.0, 1.0));
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw, "mismatched layouts are rejected");
+}
+
+// Private and shared-bin histograms agree with a sequential run
+void test_histogram_parallel_variants() {
+#ifdef MCLIB_PARALLEL_ENABLED
+    constexpr std::uint64_t n = 40'000;
+    auto seq = make_engine<Uniform01Model, execution::Sequential, HistogramAggregator<>>(
+        Uniform01Model{}, execution::Sequential{}, 5);
+    HistogramAggregator<> seq_hist(8, 0.0, 1.0);
+    seq.run(n, seq_hist);
+
+    auto par = make_engine<Uniform01Model, execution::Parallel, HistogramAggregator<>>(
+        Uniform01Model{}, execution::Parallel{4}, 5);
+    HistogramAggregator<> par_hist(8, 0.0, 1.0);
+    par.run(n, par_hist);
+
+    auto shared = make_engine<Uniform01Model, execution::Parallel, SharedHistogramAggregator<>>(
+        Uniform01Model{}, execution::Parallel{4}, 5);
+    SharedHistogramAggregator<> shared_hist(8, 0.0, 1.0);
+    shared.run(n, shared_hist);
+
+    EXPECT_EQ(par_hist.count(), n, "private-bin count");
+    EXPECT_EQ(shared_hist.count(), n, "shared-bin count");
+    std::uint64_t par_total = 0;
+    std::uint64_t shared_total = 0;
+    auto shared_bins = shared_hist.histogram();
+    for (std::size_t i = 0; i < 8; ++i) {
+        par_total += par_hist.histogram()[i];
+        shared_total += shared_bins[i];
+        EXPECT_EQ(shared_bins[i], par_hist.histogram()[i], "same seeds give same bin " << i);
+        EXPECT_NEAR(static_cast<double>(par_hist.histogram()[i]),
+            static_cast<double>(seq_hist.histogram()[i]), 0.05 * n / 8.0, "bin " << i);
+    }
+    EXPECT_EQ(par_total, n, "every uniform sample lands in a bin");
+    EXPECT_EQ(shared_total, n, "every shared sample lands in a bin");
+#else
+    std::cout << "[skip] histogram parallel variants (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+}
+
+// Higher moments against a two-pass computation, scalar and batched
+void test_moments_against_two_pass() {
+    auto rng = make_rng(31);
+    std::gamma_distribution<double> dist(2.0, 3.0);
+    std::vector<double> values(20'011);
+    for (double& v : values) {
+        v = 100.0 + dist(rng);
+    }
+
+    double mean = 0.0;
+    for (double v : values) mean += v;
+    mean /= static_cast<double>(values.size());
+    double m2 = 0.0, m3 = 0.0, m4 = 0.0;
+    for (double v : values) {
+        double d = v - mean;
+        m2 += d * d;
+        m3 += d * d * d;
+        m4 += d * d * d * d;
+    }
+    double n = static_cast<double>(values.size());
+    double skew = std::sqrt(n) * m3 / std::pow(m2, 1.5);
+    double kurt = n * m4 / (m2 * m2);
+
+    MomentsAggregator scalar;
+    for (double v : values) scalar.add(v);
+    MomentsAggregator batched;
+    batched.add_batch(values);
+    MomentsAggregator halves;
+    MomentsAggregator second;
+    second.begin_stream({0, 1, 7'000, values.size() - 7'000, values.size()});
+    halves.add_batch(std::span<const double>(values.data(), 7'000));
+    second.add_batch(std::span<const double>(values.data() + 7'000, values.size() - 7'000));
+    halves.merge(second);
+
+    for (const MomentsAggregator* agg : {&scalar, &batched, &halves}) {
+        EXPECT_NEAR(agg->result(), mean, 1e-9, "moments mean");
+        EXPECT_NEAR(agg->variance(), m2 / (n - 1.0), 1e-8, "moments variance");
+        EXPECT_NEAR(agg->skewness(), skew, 1e-8, "moments skewness");
+        EXPECT_NEAR(agg->kurtosis(), kurt, 1e-7, "moments kurtosis");
+    }
+    auto [lo, hi] = std::minmax_element(values.begin(), values.end());
+    EXPECT_NEAR(batched.min(), *lo, 0.0, "min value");
+    EXPECT_EQ(batched.argmin(), static_cast<std::uint64_t>(lo - values.begin()), "argmin");
+    EXPECT_EQ(halves.argmax(), static_cast<std::uint64_t>(hi - values.begin()), "argmax");
+}
+
+// Extremum indices are global trial indices under Parallel
+void test_moments_parallel_indices() {
+#ifdef MCLIB_PARALLEL_ENABLED
+    // Thread t draws seed+t, seed+t+1, ...; with seed 0 and two workers the
+    // run is 0,1,2,3,0 | 1,2,3,0,1
+    auto model = [](IncrementingRng& rng) {
+        return static_cast<double>(rng() % 4);
+    };
+    auto engine = make_engine<decltype(model), execution::Parallel, MomentsAggregator,
+        transform::Identity, IncrementingFactory>(model, execution::Parallel{2}, 0);
+    MomentsAggregator agg;
+    engine.run(10, agg);
+
+    EXPECT_NEAR(agg.max(), 3.0, 0.0, "parallel max");
+    EXPECT_EQ(agg.argmax(), 3u, "first trial reaching the max");
+    EXPECT_EQ(agg.argmin(), 0u, "first trial reaching the min");
+    EXPECT_NEAR(agg.result(), 1.3, 1e-12, "parallel mean");
+#else
+    std::cout << "[skip] moments parallel indices (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+}
+
+// Three correlated outputs per trial
+struct CorrelatedTripleModel {
+    template <typename RNG>
+    std::array<double, 3> operator()(RNG& rng) const {
+        std::normal_distribution<double> dist(0.0, 1.0);
+        double z1 = dist(rng);
+        double z2 = dist(rng);
+        return {10.0 + z1, 0.5 * z1 + z2, -2.0 * z2};
+    }
+};
+
+// Blocked covariance updates against a two-pass computation
+void test_covariance_against_two_pass() {
+    auto rng = make_rng(41);
+    CorrelatedTripleModel model;
+    std::vector<std::array<double, 3>> rows(1'000);
+    for (auto& row : rows) {
+        row = model(rng);
+    }
+
+    CovarianceAggregator agg(3, 64);
+    CovarianceAggregator tail(3, 16);
+    for (std::size_t k = 0; k < rows.size(); ++k) {
+        (k < 601 ? agg : tail).add(rows[k]);
+    }
+    agg.merge(tail);
+
+    double mean[3] = {};
+    for (const auto& row : rows) {
+        for (int i = 0; i < 3; ++i) mean[i] += row[i] / static_cast<double>(rows.size());
+    }
+    EXPECT_EQ(agg.count(), rows.size(), "covariance count");
+    for (std::size_t i = 0; i < 3; ++i) {
+        EXPECT_NEAR(agg.mean(i), mean[i], 1e-12, "component mean " << i);
+        for (std::size_t j = 0; j < 3; ++j) {
+            double c = 0.0;
+            for (const auto& row : rows) c += (row[i] - mean[i]) * (row[j] - mean[j]);
+            c /= static_cast<double>(rows.size() - 1);
+            EXPECT_NEAR(agg.covariance(i, j), c, 1e-10, "covariance " << i << "," << j);
+        }
+    }
+}
+
+// Vector outputs flow through the parallel engine unchanged
+void test_covariance_parallel_engine() {
+#ifdef MCLIB_PARALLEL_ENABLED
+    auto engine = make_engine<CorrelatedTripleModel, execution::Parallel, CovarianceAggregator>(
+        CorrelatedTripleModel{}, execution::Parallel{3}, 17);
+    CovarianceAggregator agg(3);
+    auto result = engine.run(60'001, agg);
+
+    EXPECT_EQ(result.iterations, 60'001u, "iterations");
+    EXPECT_EQ(agg.count(), 60'001u, "merged count");
+    EXPECT_NEAR(agg.mean(0), 10.0, 0.02, "mean of first output");
+    EXPECT_NEAR(agg.covariance(0, 1), 0.5, 0.02, "cov(x0, x1)");
+    EXPECT_NEAR(agg.covariance(1, 2), -2.0, 0.05, "cov(x1, x2)");
+    EXPECT_NEAR(agg.covariance(0, 2), 0.0, 0.03, "cov(x0, x2)");
+#else
+    std::cout << "[skip] covariance parallel engine (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+}
+
+// Heap-based VaR/ES must equal the sort-based values exactly
+void test_tail_matches_sort() {
+    auto rng = make_rng(51);
+    std::student_t_distribution<double> dist(3.0);
+    std::vector<double> values(12'345);
+    for (double& v : values) {
+        v = dist(rng);
+    }
+    const double alpha = 0.995;
+    const std::size_t k = static_cast<std::size_t>(std::ceil((1.0 - alpha) * values.size()));
+
+    TailAggregator losses(alpha, TailAggregator::Tail::upper, values.size());
+    losses.add_batch(values);
+    TailAggregator pnl(alpha, TailAggregator::Tail::lower, values.size());
+    for (double v : values) pnl.add(v);
+
+    std::vector<double> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    double es_upper = 0.0;
+    double es_lower = 0.0;
+    for (std::size_t i = 0; i < k; ++i) {
+        es_upper += sorted[sorted.size() - 1 - i] / static_cast<double>(k);
+        es_lower += sorted[i] / static_cast<double>(k);
+    }
+
+    EXPECT_EQ(losses.tail_size(), static_cast<std::uint64_t>(k), "tail size");
+    EXPECT_EQ(losses.retained(), k, "O(k) memory");
+    EXPECT_NEAR(losses.value_at_risk(), sorted[sorted.size() - k], 0.0, "upper VaR");
+    EXPECT_NEAR(losses.expected_shortfall(), es_upper, 1e-12, "upper ES");
+    EXPECT_NEAR(pnl.value_at_risk(), sorted[k - 1], 0.0, "lower VaR");
+    EXPECT_NEAR(pnl.expected_shortfall(), es_lower, 1e-12, "lower ES");
+
+    // Two-pass scheme: a threshold below VaR keeps the tail exact
+    auto thresholded = TailAggregator::beyond(sorted[sorted.size() - 2 * k], alpha);
+    thresholded.add_batch(values);
+    EXPECT_TRUE(thresholded.exact(), "conservative threshold is exact");
+    EXPECT_NEAR(thresholded.value_at_risk(), sorted[sorted.size() - k], 0.0, "threshold VaR");
+    auto too_high = TailAggregator::beyond(sorted[sorted.size() - k / 2], alpha);
+    too_high.add_batch(values);
+    EXPECT_TRUE(!too_high.exact(), "threshold beyond VaR is flagged");
+}
+
+// Per-worker heaps sized from the run length merge to the global tail
+void test_tail_parallel_merge() {
+#ifdef MCLIB_PARALLEL_ENABLED
+    constexpr std::uint64_t n = 30'001;
+    auto seq = make_engine<Uniform01Model, execution::Sequential, TailAggregator>(
+        Uniform01Model{}, execution::Sequential{}, 3);
+    TailAggregator seq_tail(0.99);
+    seq.run(n, seq_tail);
+    EXPECT_EQ(seq_tail.retained(), 301u, "heap sized from the run");
+    EXPECT_NEAR(seq_tail.value_at_risk(), 0.99, 0.005, "sequential VaR of uniform");
+
+    // Two workers on seeds 3 and 4; replay them to get the exact answer
+    auto par = make_engine<Uniform01Model, execution::Parallel, TailAggregator>(
+        Uniform01Model{}, execution::Parallel{2}, 3);
+    TailAggregator par_tail(0.99);
+    par.run(n, par_tail);
+    std::vector<double> all;
+    for (std::uint64_t t = 0; t < 2; ++t) {
+        auto rng = DefaultRngFactory{}(3 + t);
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        for (std::uint64_t i = 0; i < n / 2 + (t < n % 2 ? 1 : 0); ++i) all.push_back(dist(rng));
+    }
+    std::sort(all.begin(), all.end());
+    EXPECT_EQ(par_tail.count(), n, "merged count");
+    EXPECT_NEAR(par_tail.value_at_risk(), all[all.size() - 301], 0.0, "merged VaR is exact");
+
+    // A reused aggregator, or one sized for fewer trials, grows to the run
+    auto par4 = make_engine<Uniform01Model, execution::Parallel, TailAggregator>(
+        Uniform01Model{}, execution::Parallel{4}, 5);
+    for (TailAggregator reused : {TailAggregator(0.99), TailAggregator(0.99, TailAggregator::Tail::upper, 1'000)}) {
+        par4.run(1'000, reused);
+        par4.run(100'000, reused);
+        EXPECT_EQ(reused.retained(), 1'000u, "heap sized for the larger run");
+        EXPECT_TRUE(reused.exact(), "reused aggregator stays exact");
+        EXPECT_NEAR(reused.value_at_risk(), 0.99, 0.003, "reused VaR of uniform");
+    }
+#else
+    std::cout << "[skip] tail parallel merge (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+
+    // Without expected_trials or a stream, a standalone instance keeps all
+    TailAggregator unsized(0.9);
+    for (int i = 1; i <= 100; ++i) unsized.add(i);
+    EXPECT_TRUE(unsized.exact(), "unsized standalone is exact");
+    EXPECT_NEAR(unsized.value_at_risk(), 91.0, 0.0, "unsized standalone VaR");
+    unsized.reset();
+    EXPECT_EQ(unsized.retained(), 0u, "reset empties the heap");
+}
+
+// One pass feeds every member; sub-results match dedicated runs
+void test_tuple_aggregator() {
+    using Stats = TupleAggregator<WelfordAggregator<>, TDigestAggregator, HistogramAggregator<>>;
+    auto engine = make_engine<Uniform01Model, execution::Sequential, Stats>(
+        Uniform01Model{}, execution::Sequential{}, 8);
+    auto r = engine.run_aggregate(20'000, Stats({}, TDigestAggregator(100.0), HistogramAggregator<>(4, 0.0, 1.0)));
+
+    auto mean_only = make_engine<Uniform01Model, execution::Sequential, WelfordAggregator<>>(
+        Uniform01Model{}, execution::Sequential{}, 8).run(20'000);
+    EXPECT_NEAR(r.estimate, mean_only.estimate, 1e-12, "first member drives the estimate");
+    EXPECT_NEAR(r.variance, mean_only.variance, 1e-12, "first member drives the variance");
+    EXPECT_EQ(r.aggregator.count(), 20'000u, "tuple count");
+    EXPECT_EQ(r.get<1>().count(), 20'000u, "digest saw every trial");
+    EXPECT_NEAR(r.get<TDigestAggregator>().quantile(0.5), 0.5, 0.02, "median sub-result");
+    EXPECT_EQ(r.get<2>().count(), 20'000u, "histogram saw every trial");
+    EXPECT_NEAR(static_cast<double>(r.get<2>().histogram()[0]), 5'000.0, 300.0, "histogram sub-result");
+}
+
+// Member-wise merge under Parallel
+void test_tuple_aggregator_parallel() {
+#ifdef MCLIB_PARALLEL_ENABLED
+    using Stats = TupleAggregator<MomentsAggregator, TailAggregator>;
+    auto engine = make_engine<Uniform01Model, execution::Parallel, Stats>(
+        Uniform01Model{}, execution::Parallel{4}, 12);
+    auto r = engine.run_aggregate(40'000, Stats({}, TailAggregator(0.9)));
+
+    EXPECT_EQ(r.get<0>().count(), 40'000u, "moments merged");
+    EXPECT_NEAR(r.estimate, 0.5, 0.01, "parallel mean");
+    EXPECT_EQ(r.get<1>().retained(), 4'000u, "tail heaps merged to k");
+    EXPECT_NEAR(r.get<1>().value_at_risk(), 0.9, 0.01, "parallel VaR");
+#else
+    std::cout << "[skip] tuple aggregator parallel (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+}
+
+// AR(1) chain x_t = phi x_{t-1} + e_t has tau = (1 + phi) / (1 - phi)
+std::vector<double> ar1_chain(std::uint64_t seed, double phi, std::size_t n) {
+    auto rng = make_rng(seed);
+    std::normal_distribution<double> dist(0.0, 1.0);
+    std::vector<double> chain(n);
+    double x = 0.0;
+    for (double& v : chain) {
+        x = phi * x + dist(rng);
+        v = 5.0 + x;
+    }
+    return chain;
+}
+
+// Batch means and the autocorrelation time see through the correlation
+void test_batch_means_ar1() {
+    const double phi = 0.8;
+    const double tau = (1.0 + phi) / (1.0 - phi);
+    auto chain = ar1_chain(61, phi, 400'000);
+
+    BatchMeansAggregator agg(64);
+    agg.add_batch(chain);
+
+    EXPECT_EQ(agg.count(), chain.size(), "batch means count");
+    EXPECT_NEAR(agg.result(), 5.0, 0.05, "chain mean");
+    EXPECT_NEAR(agg.autocorrelation(1), phi, 0.01, "lag-1 autocorrelation");
+    EXPECT_NEAR(agg.autocorrelation(3), phi * phi * phi, 0.02, "lag-3 autocorrelation");
+    EXPECT_NEAR(agg.integrated_autocorrelation_time(), tau, 0.1 * tau, "autocorrelation time");
+    double ratio = agg.std_error() / agg.naive_std_error();
+    EXPECT_NEAR(ratio, std::sqrt(tau), 0.25 * std::sqrt(tau), "batch-means inflation of the std error");
+    EXPECT_NEAR(agg.effective_sample_size(), chain.size() / tau, 0.5 * chain.size() / tau, "effective sample size");
+    EXPECT_TRUE(agg.batch_size() >= 16, "a batch size was chosen");
+}
+
+// Independent chains pool without straddling batches
+void test_batch_means_merge_chains() {
+    const double phi = 0.5;
+    auto a_chain = ar1_chain(71, phi, 100'000);
+    auto b_chain = ar1_chain(72, phi, 100'000);
+    for (double& v : b_chain) v += 0.01;  // slightly different level
+
+    BatchMeansAggregator a(16);
+    BatchMeansAggregator b(16);
+    a.add_batch(a_chain);
+    b.add_batch(b_chain);
+    a.merge(b);
+
+    EXPECT_EQ(a.count(), 200'000u, "pooled count");
+    EXPECT_NEAR(a.autocorrelation(1), phi, 0.02, "pooled lag-1 autocorrelation");
+    EXPECT_NEAR(a.integrated_autocorrelation_time(), 3.0, 0.3, "pooled autocorrelation time");
+
+    BatchMeansAggregator empty(16);
+    empty.merge(a);
+    EXPECT_EQ(empty.count(), a.count(), "merging into an empty aggregator");
+    EXPECT_NEAR(empty.std_error(), a.std_error(), 1e-15, "merged std error carries over");
+}
+
+// Any summation order or merge tree gives the same bits
+void test_reproducible_order_independence() {
+    auto rng = make_rng(81);
+    std::lognormal_distribution<double> dist(0.0, 3.0);
+    std::vector<double> values(50'000);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        values[i] = (i % 3 == 0 ? -1.0 : 1.0) * dist(rng);
+    }
+
+    ReproducibleAggregator forward;
+    forward.add_batch(values);
+
+    std::vector<double> shuffled = values;
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+    ReproducibleAggregator reversed;
+    for (auto it = shuffled.rbegin(); it != shuffled.rend(); ++it) reversed.add(*it);
+    EXPECT_TRUE(forward.result() == reversed.result(), "mean independent of order");
+    EXPECT_TRUE(forward.variance() == reversed.variance(), "variance independent of order");
+
+    // Uneven partitions merged in different orders, as with 1..7 workers
+    for (std::size_t parts = 1; parts <= 7; ++parts) {
+        std::vector<ReproducibleAggregator> partial(parts);
+        for (std::size_t i = 0; i < shuffled.size(); ++i) {
+            partial[(i * i) % parts].add(shuffled[i]);
+        }
+        ReproducibleAggregator left;
+        ReproducibleAggregator right;
+        for (std::size_t p = 0; p < parts; ++p) {
+            left.merge(partial[p]);
+            right.merge(partial[parts - 1 - p]);
+        }
+        EXPECT_EQ(left.count(), values.size(), "merged count");
+        EXPECT_TRUE(left.result() == forward.result(), "mean independent of merge tree, parts=" << parts);
+        EXPECT_TRUE(right.variance() == forward.variance(), "variance independent of merge tree, parts=" << parts);
+        EXPECT_TRUE(left.sum() == right.sum(), "sum independent of merge order");
+    }
+}
+
+// Exact sums survive cancellation that defeats naive accumulation
+void test_reproducible_exactness() {
+    ReproducibleAggregator agg;
+    for (double v : {1e100, 1.0, -1e100, 1e-300, -1e-300, 0x1p-1074, -0x1p-1074}) agg.add(v);
+    EXPECT_TRUE(agg.sum() == 1.0, "cancelling sum is exact");
+
+    // Large offset: the double-double variance keeps full precision
+    ReproducibleAggregator offset;
+    for (int i = 0; i < 1000; ++i) offset.add(1e9 + (i % 2 == 0 ? 0.5 : -0.5));
+    EXPECT_NEAR(offset.result(), 1e9, 1e-6, "offset mean");
+    EXPECT_NEAR(offset.variance(), 1000.0 * 0.25 / 999.0, 1e-12, "offset variance");
+
+    // Agrees with Welford on ordinary data
+    auto values = ar1_chain(82, 0.0, 10'000);
+    ReproducibleAggregator rep;
+    WelfordAggregator<> welford;
+    for (double v : values) {
+        rep.add(v);
+        welford.add(v);
+    }
+    EXPECT_NEAR(rep.result(), welford.result(), 1e-12, "mean matches Welford");
+    EXPECT_NEAR(rep.variance(), welford.variance(), 1e-10, "variance matches Welford");
+
+    ReproducibleAggregator inf;
+    inf.add(1.0);
+    inf.add(std::numeric_limits<double>::infinity());
+    EXPECT_TRUE(std::isinf(inf.sum()), "infinity propagates");
+    inf.reset();
+    EXPECT_TRUE(inf.sum() == 0.0 && inf.count() == 0, "reset clears state");
+}
+
+// Every value is equally likely to be kept, also after a merge
+void test_reservoir_uniformity() {
+    constexpr int n = 100;
+    constexpr std::size_t k = 10;
+    constexpr int reps = 20'000;
+    std::vector<int> direct(n, 0);
+    std::vector<int> merged(n, 0);
+    std::vector<double> values(n);
+    for (int i = 0; i < n; ++i) values[i] = i;
+
+    for (int r = 0; r < reps; ++r) {
+        ReservoirAggregator one(k, r);
+        one.add_batch(values);
+        for (double v : one.samples()) ++direct[static_cast<int>(v)];
+
+        // Uneven split: 70 values in one worker, 30 in the other
+        ReservoirAggregator a(k, 2 * r + 1);
+        ReservoirAggregator b(k, 2 * r + 2);
+        a.add_batch(std::span<const double>(values).first(70));
+        for (int i = 70; i < n; ++i) b.add(values[i]);
+        a.merge(b);
+        for (double v : a.samples()) ++merged[static_cast<int>(v)];
+    }
+    const double expected = static_cast<double>(reps) * k / n;
+    for (int i = 0; i < n; ++i) {
+        EXPECT_NEAR(direct[i], expected, 0.1 * expected, "direct inclusion of " << i);
+        EXPECT_NEAR(merged[i], expected, 0.1 * expected, "merged inclusion of " << i);
+    }
+
+    // k = 1 weighted sample picks value i with probability w_i / sum(w)
+    std::vector<int> picks(4, 0);
+    for (int r = 0; r < reps; ++r) {
+        WeightedReservoirAggregator first(1, 2 * r);
+        WeightedReservoirAggregator second(1, 2 * r + 1);
+        first.add(0.0, 1.0);
+        first.add(1.0, 2.0);
+        second.add(2.0, 3.0);
+        second.add({3.0, 4.0});
+        second.add(9.0, 0.0);
+        first.merge(second);
+        ++picks[static_cast<int>(first.samples().at(0))];
+    }
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_NEAR(picks[i] / static_cast<double>(reps), (i + 1) / 10.0, 0.015, "weighted pick " << i);
+    }
+}
+
+// Engine runs reproduce their reservoir from the run seed
+void test_reservoir_engine_reproducible() {
+    auto sample = [](auto policy, std::uint64_t seed) {
+        auto engine = make_engine<Uniform01Model, decltype(policy), ReservoirAggregator>(
+            Uniform01Model{}, policy, seed);
+        return engine.run_aggregate(50'000, ReservoirAggregator(256)).aggregator;
+    };
+    auto seq = sample(execution::Sequential{}, 5);
+    EXPECT_EQ(seq.count(), 50'000u, "reservoir saw every trial");
+    EXPECT_EQ(seq.samples().size(), 256u, "reservoir is full");
+    EXPECT_TRUE(seq.samples() == sample(execution::Sequential{}, 5).samples(), "sequential reproducible");
+    EXPECT_TRUE(seq.samples() != sample(execution::Sequential{}, 6).samples(), "seed changes the sample");
+    EXPECT_NEAR(seq.result(), 0.5, 0.06, "sample mean");
+#ifdef MCLIB_PARALLEL_ENABLED
+    auto par = sample(execution::Parallel{3}, 5);
+    EXPECT_EQ(par.count(), 50'000u, "merged reservoir count");
+    EXPECT_EQ(par.samples().size(), 256u, "merged reservoir is full");
+    EXPECT_TRUE(par.samples() == sample(execution::Parallel{3}, 5).samples(), "parallel reproducible");
+    EXPECT_NEAR(par.result(), 0.5, 0.06, "merged sample mean");
+#else
+    std::cout << "[skip] reservoir parallel (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+}
+
+// Sector k pays k + U(0, 1); sectors 0-3 are dense, the rest hashed
+struct SectorModel {
+    std::pair<int, double> operator()(std::mt19937_64& rng) const {
+        std::uniform_int_distribution<int> sector(0, 9);
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        int k = sector(rng);
+        return {k, k + u(rng)};
+    }
+};
+
+// One run yields per-key statistics for dense and hashed keys alike
+void test_grouped_aggregator() {
+    using Grouped = GroupedAggregator<WelfordAggregator<>, int>;
+    auto engine = make_engine<SectorModel, execution::Sequential, Grouped>(SectorModel{}, {}, 31);
+    auto r = engine.run_aggregate(50'000, Grouped(4));
+    const Grouped& g = r.aggregator;
+
+    EXPECT_EQ(g.count(), 50'000u, "grouped count");
+    EXPECT_EQ(g.groups(), 10u, "every sector seen");
+    std::uint64_t total = 0;
+    int visited = 0;
+    g.for_each([&](int key, const WelfordAggregator<>& w) {
+        if (visited < 4) EXPECT_EQ(key, visited, "dense keys visited first, in order");
+        ++visited;
+        EXPECT_NEAR(w.result(), key + 0.5, 0.02, "sector mean " << key);
+        total += w.count();
+    });
+    EXPECT_EQ(total, 50'000u, "groups partition the trials");
+    EXPECT_TRUE(g.find(42) == nullptr && g.find(-1) == nullptr, "unknown keys");
+
+    // Non-integral keys, inner aggregators cloned from a configured prototype
+    GroupedAggregator<HistogramAggregator<>, std::string> names(0, HistogramAggregator<>(4, 0.0, 1.0));
+    names.add(std::string("alpha"), 0.1);
+    names.add(std::pair<std::string, double>{"beta", 0.9});
+    names.add(std::string("alpha"), 0.3);
+    EXPECT_EQ(names.at("alpha").histogram()[0], 1u, "first alpha bin");
+    EXPECT_EQ(names.at("alpha").histogram()[1], 1u, "second alpha bin");
+    EXPECT_EQ(names.at("beta").histogram()[3], 1u, "beta bin");
+    bool threw = false;
+    try {
+        names.at("gamma");
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw, "at() rejects unknown keys");
+}
+
+// Group-wise merge of per-worker maps, through table growth
+void test_grouped_merge() {
+    GroupedAggregator<WelfordAggregator<>, std::uint64_t> all(8);
+    GroupedAggregator<WelfordAggregator<>, std::uint64_t> left(8);
+    GroupedAggregator<WelfordAggregator<>, std::uint64_t> right(8);
+    for (std::uint64_t i = 0; i < 20'000; ++i) {
+        const std::uint64_t key = (i * 7919) % 1000;
+        const double value = static_cast<double>(i % 13);
+        all.add(key, value);
+        (i < 12'000 ? left : right).add(key, value);
+    }
+    left.merge(right);
+    EXPECT_EQ(left.groups(), 1000u, "merged key set");
+    EXPECT_EQ(left.count(), all.count(), "merged count");
+    all.for_each([&](std::uint64_t key, const WelfordAggregator<>& w) {
+        const WelfordAggregator<>* m = left.find(key);
+        EXPECT_TRUE(m != nullptr && m->count() == w.count(), "group count " << key);
+        EXPECT_NEAR(m->result(), w.result(), 1e-12, "group mean " << key);
+    });
+#ifdef MCLIB_PARALLEL_ENABLED
+    using Grouped = GroupedAggregator<WelfordAggregator<>, int>;
+    auto par = make_engine<SectorModel, execution::Parallel, Grouped>(SectorModel{}, execution::Parallel{3}, 31);
+    auto r = par.run_aggregate(30'000, Grouped(4));
+    EXPECT_EQ(r.aggregator.count(), 30'000u, "parallel grouped count");
+    EXPECT_NEAR(r.aggregator.at(7).result(), 7.5, 0.03, "parallel hashed group mean");
+    EXPECT_NEAR(r.aggregator.at(2).result(), 2.5, 0.03, "parallel dense group mean");
+
+    // Inner aggregators see the worker's stream: with a single key the
+    // group's extremum indices are global trial indices, as for a plain
+    // MomentsAggregator (run 0,1,2,3,0 | 1,2,3,0,1)
+    for (int key : {1, 9}) {
+        auto model = [key](IncrementingRng& rng) {
+            return std::pair<int, double>{key, static_cast<double>(rng() % 4)};
+        };
+        using Moments = GroupedAggregator<MomentsAggregator, int>;
+        auto moments = make_engine<decltype(model), execution::Parallel, Moments,
+            transform::Identity, IncrementingFactory>(model, execution::Parallel{2}, 0);
+        Moments agg(4);
+        moments.run(10, agg);
+        EXPECT_EQ(agg.at(key).argmax(), 3u, "grouped argmax, key " << key);
+        EXPECT_EQ(agg.at(key).argmin(), 0u, "grouped argmin, key " << key);
+    }
+#else
+    std::cout << "[skip] grouped parallel (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+}
+
+// Each trace point matches a run over the same prefix of trials
+void test_convergence_trace() {
+    auto values = ar1_chain(91, 0.0, 10'000);
+    ConvergenceTraceAggregator scalar(100, 2.0);
+    ConvergenceTraceAggregator batched(100, 2.0);
+    for (double v : values) scalar.add(v);
+    batched.add_batch(values);
+
+    auto trace = batched.trace();
+    const std::vector<std::uint64_t> ns{100, 200, 400, 800, 1600, 3200, 6400, 10'000};
+    EXPECT_EQ(trace.size(), ns.size(), "checkpoints plus the final point");
+    EXPECT_EQ(scalar.trace().size(), trace.size(), "scalar and batch paths agree");
+    for (std::size_t i = 0; i < trace.size() && i < ns.size(); ++i) {
+        WelfordAggregator<> prefix;
+        for (std::uint64_t j = 0; j < ns[i]; ++j) prefix.add(values[j]);
+        EXPECT_EQ(trace[i].n, ns[i], "checkpoint " << i);
+        EXPECT_NEAR(trace[i].mean, prefix.result(), 1e-12, "prefix mean at " << ns[i]);
+        EXPECT_NEAR(trace[i].std_error, prefix.std_error(), 1e-12, "prefix std error at " << ns[i]);
+        EXPECT_NEAR(scalar.trace()[i].mean, prefix.result(), 1e-12, "scalar prefix mean at " << ns[i]);
+    }
+    EXPECT_NEAR(batched.result(), trace.back().mean, 0.0, "final point is the estimate");
+}
+
+// Worker traces merged in trial order give the trace of the whole sequence
+void test_convergence_trace_merge() {
+    auto values = ar1_chain(92, 0.0, 9'000);
+    ConvergenceTraceAggregator whole(100, 3.0);
+    whole.add_batch(values);
+
+    ConvergenceTraceAggregator merged(100, 3.0);
+    const std::uint64_t bounds[] = {0, 250, 4'000, 9'000};
+    for (int w = 0; w < 3; ++w) {
+        ConvergenceTraceAggregator part(100, 3.0);
+        part.begin_stream({1, static_cast<std::uint64_t>(w), bounds[w], bounds[w + 1] - bounds[w], 9'000});
+        part.add_batch(std::span<const double>(values).subspan(bounds[w], bounds[w + 1] - bounds[w]));
+        merged.merge(part);
+    }
+    auto expected = whole.trace();
+    auto got = merged.trace();
+    EXPECT_EQ(got.size(), expected.size(), "merged trace length");
+    for (std::size_t i = 0; i < got.size() && i < expected.size(); ++i) {
+        EXPECT_EQ(got[i].n, expected[i].n, "merged checkpoint " << i);
+        EXPECT_NEAR(got[i].mean, expected[i].mean, 1e-12, "merged mean at " << got[i].n);
+        EXPECT_NEAR(got[i].std_error, expected[i].std_error, 1e-12, "merged std error at " << got[i].n);
+    }
+#ifdef MCLIB_PARALLEL_ENABLED
+    auto engine = make_engine<Uniform01Model, execution::Parallel, ConvergenceTraceAggregator>(
+        Uniform01Model{}, execution::Parallel{4}, 17);
+    auto r = engine.run_aggregate(100'000, ConvergenceTraceAggregator(1'000, 10.0));
+    auto curve = r.aggregator.trace();
+    EXPECT_EQ(curve.size(), 3u, "1k, 10k and 100k points");
+    EXPECT_EQ(curve.back().n, 100'000u, "curve ends at the run size");
+    EXPECT_NEAR(curve.back().mean, r.estimate, 0.0, "curve ends at the estimate");
+    EXPECT_NEAR(curve.front().mean, 0.5, 0.03, "early estimate");
+#else
+    std::cout << "[skip] convergence trace parallel (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+}
+
+// Every built-in aggregator satisfies the merge/serialise protocol
+static_assert(MergeableAggregator<WelfordAggregator<>>);
+static_assert(MergeableAggregator<HistogramAggregator<>>);
+static_assert(MergeableAggregator<SharedHistogramAggregator<>>);
+static_assert(MergeableAggregator<TDigestAggregator>);
+static_assert(MergeableAggregator<LogHistogramAggregator>);
+static_assert(MergeableAggregator<MomentsAggregator>);
+static_assert(MergeableAggregator<CovarianceAggregator>);
+static_assert(MergeableAggregator<TailAggregator>);
+static_assert(MergeableAggregator<TupleAggregator<WelfordAggregator<>, TailAggregator>>);
+static_assert(MergeableAggregator<BatchMeansAggregator>);
+static_assert(MergeableAggregator<ReproducibleAggregator>);
+static_assert(MergeableAggregator<ReservoirAggregator>);
+static_assert(MergeableAggregator<WeightedReservoirAggregator>);
+static_assert(MergeableAggregator<GroupedAggregator<WelfordAggregator<>, std::string>>);
+static_assert(MergeableAggregator<ConvergenceTraceAggregator>);
+static_assert(MergeableAggregator<ExactQuantileAggregator>);
+static_assert(MergeableAggregator<DensityAggregator>);
+static_assert(MergeableAggregator<SparseHistogramAggregator>);
+static_assert(MergeableAggregator<SampleSinkAggregator>);
+
+// Restored state answers queries and keeps accumulating exactly as the
+// original does
+void test_serialize_round_trip() {
+    auto values = ar1_chain(101, 0.3, 5'000);
+    auto check = [&](auto agg, auto query, const char* name) {
+        using A = decltype(agg);
+        auto feed_values = [](A& a, std::span<const double> xs) {
+            if constexpr (BatchAggregator<A>) {
+                a.add_batch(xs);
+            } else {
+                for (double x : xs) a.add(x);
+            }
+        };
+        feed_values(agg, std::span<const double>(values).first(3'001));
+        A restored = from_bytes<A>(to_bytes(agg));
+        EXPECT_NEAR(query(restored), query(agg), 0.0, name << " restored");
+        auto rest = std::span<const double>(values).subspan(3'001);
+        feed_values(agg, rest);
+        feed_values(restored, rest);
+        EXPECT_EQ(restored.count(), agg.count(), name << " count");
+        EXPECT_NEAR(query(restored), query(agg), 1e-12 * (1.0 + std::abs(query(agg))), name << " continued");
+    };
+    check(WelfordAggregator<>{}, [](const auto& a) { return a.variance(); }, "welford");
+    check(HistogramAggregator<>(20, 3.0, 7.0), [](const auto& a) { return static_cast<double>(a.histogram()[9]); }, "histogram");
+    check(SharedHistogramAggregator<>(20, 3.0, 7.0), [](const auto& a) { return static_cast<double>(a.histogram()[9]); }, "shared histogram");
+    check(TDigestAggregator(100), [](const auto& a) { return a.quantile(0.9); }, "tdigest");
+    check(LogHistogramAggregator{}, [](const auto& a) { return a.quantile(0.1); }, "log histogram");
+    check(MomentsAggregator{}, [](const auto& a) { return a.kurtosis() + static_cast<double>(a.argmax()); }, "moments");
+    check(TailAggregator(0.95, TailAggregator::Tail::lower, 5'000), [](const auto& a) { return a.expected_shortfall(); }, "tail");
+    check(TupleAggregator<WelfordAggregator<>, MomentsAggregator>{}, [](const auto& a) { return a.template get<1>().skewness(); }, "tuple");
+    check(BatchMeansAggregator(8, 4, 16), [](const auto& a) { return a.std_error() + a.autocorrelation(2); }, "batch means");
+    check(ReproducibleAggregator{}, [](const auto& a) { return a.variance(); }, "reproducible");
+    check(ReservoirAggregator(64, 3), [](const auto& a) { return a.result(); }, "reservoir");
+    check(ConvergenceTraceAggregator(100), [](const auto& a) { return a.trace()[4].std_error; }, "convergence");
+
+    CovarianceAggregator cov(3, 16);
+    WeightedReservoirAggregator weighted(16, 4);
+    GroupedAggregator<TDigestAggregator, std::string> grouped(0, TDigestAggregator(50));
+    GroupedAggregator<WelfordAggregator<>, int> dense(4);
+    for (std::size_t i = 0; i + 2 < values.size(); ++i) {
+        cov.add(std::array<double, 3>{values[i], values[i + 1], values[i + 2]});
+        weighted.add(values[i], 1.0 + (i % 3));
+        grouped.add(i % 2 == 0 ? std::string("even") : std::string("odd"), values[i]);
+        dense.add(static_cast<int>(i % 6), values[i]);
+    }
+    auto cov2 = from_bytes<CovarianceAggregator>(to_bytes(cov));
+    EXPECT_NEAR(cov2.covariance(0, 2), cov.covariance(0, 2), 0.0, "covariance restored");
+    auto weighted2 = from_bytes<WeightedReservoirAggregator>(to_bytes(weighted));
+    EXPECT_TRUE(weighted2.samples() == weighted.samples(), "weighted reservoir restored");
+    weighted.add(1e6, 1e9);
+    weighted2.add(1e6, 1e9);
+    EXPECT_TRUE(weighted2.samples() == weighted.samples(), "weighted reservoir continues the same stream");
+    auto grouped2 = from_bytes<GroupedAggregator<TDigestAggregator, std::string>>(to_bytes(grouped));
+    EXPECT_NEAR(grouped2.at("odd").quantile(0.5), grouped.at("odd").quantile(0.5), 0.0, "string-keyed groups restored");
+    auto dense2 = from_bytes<GroupedAggregator<WelfordAggregator<>, int>>(to_bytes(dense));
+    EXPECT_EQ(dense2.groups(), 6u, "dense and hashed groups restored");
+    EXPECT_NEAR(dense2.at(5).result(), dense.at(5).result(), 0.0, "hashed group restored");
+}
+
+// Partial results combine through bytes as they do through merge()
+void test_serialize_merge_and_errors() {
+    auto values = ar1_chain(102, 0.0, 8'000);
+    TupleAggregator<WelfordAggregator<>, TDigestAggregator, ReproducibleAggregator> whole;
+    whole.add_batch(values);
+
+    // Three "processes" ship their partial states as bytes
+    std::vector<std::vector<std::byte>> shipped;
+    for (std::size_t p = 0; p < 3; ++p) {
+        TupleAggregator<WelfordAggregator<>, TDigestAggregator, ReproducibleAggregator> part;
+        for (std::size_t i = p; i < values.size(); i += 3) part.add(values[i]);
+        shipped.push_back(to_bytes(part));
+    }
+    using Parts = TupleAggregator<WelfordAggregator<>, TDigestAggregator, ReproducibleAggregator>;
+    Parts combined;
+    for (const auto& bytes : shipped) combined.merge(from_bytes<Parts>(bytes));
+    EXPECT_EQ(combined.count(), whole.count(), "combined count");
+    EXPECT_NEAR(combined.get<0>().variance(), whole.get<0>().variance(), 1e-12, "combined variance");
+    EXPECT_NEAR(combined.get<1>().quantile(0.5), whole.get<1>().quantile(0.5), 0.02, "combined median");
+    EXPECT_TRUE(combined.get<2>().result() == whole.get<2>().result(), "combined reproducible mean is bit-identical");
+
+    auto expect_throw = [](auto fn, const char* what) {
+        bool threw = false;
+        try {
+            fn();
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        EXPECT_TRUE(threw, what);
+    };
+    auto bytes = to_bytes(whole.get<0>());
+    expect_throw([&] { from_bytes<MomentsAggregator>(bytes); }, "wrong aggregator type is rejected");
+    expect_throw([&] {
+        from_bytes<WelfordAggregator<>>(std::span<const std::byte>(bytes).first(bytes.size() - 1));
+    }, "truncated input is rejected");
+    bytes.push_back(std::byte{0});
+    expect_throw([&] { from_bytes<WelfordAggregator<>>(bytes); }, "trailing bytes are rejected");
+
+    // Density grids that the constructor would never build
+    auto density_bytes = [](double min, double max, std::size_t points) {
+        ByteWriter w;
+        w.tag(fourcc("KDEN"));
+        w.write(min);
+        w.write(max);
+        w.write(std::vector<double>(points, 0.0));
+        w.write(std::vector<std::uint64_t>(points, 0));
+        for (int i = 0; i < 3; ++i) w.write(std::uint64_t{0});
+        WelfordAggregator<>{}.serialize(w);
+        return w.take();
+    };
+    EXPECT_EQ(from_bytes<DensityAggregator>(density_bytes(0.0, 1.0, 5)).grid().size(), 5u, "valid density grid restores");
+    expect_throw([&] { from_bytes<DensityAggregator>(density_bytes(0.0, 1.0, 0)); }, "empty density grid is rejected");
+    expect_throw([&] { from_bytes<DensityAggregator>(density_bytes(0.0, 1.0, 1)); }, "one-point density grid is rejected");
+    expect_throw([&] { from_bytes<DensityAggregator>(density_bytes(1.0, 1.0, 5)); }, "empty density range is rejected");
+    expect_throw([&] {
+        from_bytes<DensityAggregator>(density_bytes(std::numeric_limits<double>::quiet_NaN(), 1.0, 5));
+    }, "NaN density bound is rejected");
+    expect_throw([&] {
+        from_bytes<DensityAggregator>(density_bytes(0.0, std::numeric_limits<double>::infinity(), 5));
+    }, "infinite density bound is rejected");
+
+    // Configuration fields are range-checked before anything is sized from
+    // them; `at` is the field's offset after the four-byte tag
+    auto patched = []<typename A>(const A& agg, std::size_t at, auto value) {
+        auto out = to_bytes(agg);
+        const auto word = std::bit_cast<std::uint64_t>(value);
+        for (int i = 0; i < 8; ++i) out[4 + at + i] = static_cast<std::byte>(word >> (8 * i));
+        return out;
+    };
+    constexpr std::uint64_t huge = std::uint64_t{1} << 58;
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+    expect_throw([&] { from_bytes<ReservoirAggregator>(patched(ReservoirAggregator(16), 0, huge)); },
+                 "huge reservoir k is rejected");
+    expect_throw([&] { from_bytes<WeightedReservoirAggregator>(patched(WeightedReservoirAggregator(16), 0, huge)); },
+                 "huge weighted reservoir k is rejected");
+    expect_throw([&] { from_bytes<CovarianceAggregator>(patched(CovarianceAggregator(3, 8), 8, huge)); },
+                 "huge covariance block is rejected");
+    expect_throw([&] { from_bytes<TDigestAggregator>(patched(TDigestAggregator(100.0), 0, nan)); },
+                 "NaN t-digest compression is rejected");
+    expect_throw([&] { from_bytes<TDigestAggregator>(patched(TDigestAggregator(100.0), 0, 1e300)); },
+                 "huge t-digest compression is rejected");
+    expect_throw([&] { from_bytes<TailAggregator>(patched(TailAggregator(0.99), 0, nan)); },
+                 "NaN tail alpha is rejected");
+    expect_throw([&] { from_bytes<ConvergenceTraceAggregator>(patched(ConvergenceTraceAggregator(), 8, inf)); },
+                 "infinite convergence growth is rejected");
+    expect_throw([&] { from_bytes<HistogramAggregator<>>(patched(HistogramAggregator<>(10), 0, -inf)); },
+                 "infinite histogram bound is rejected");
+    expect_throw([&] { from_bytes<SparseHistogramAggregator>(patched(SparseHistogramAggregator(), 8, huge)); },
+                 "huge sparse histogram window is rejected");
+    expect_throw([&] { from_bytes<LogHistogramAggregator>(patched(LogHistogramAggregator(), 8, huge)); },
+                 "log histogram buckets past the index range are rejected");
+    using Groups = GroupedAggregator<WelfordAggregator<>, int>;
+    const std::size_t prototype_size = to_bytes(WelfordAggregator<>{}).size();
+    expect_throw([&] { from_bytes<Groups>(patched(Groups(4), prototype_size, huge)); },
+                 "huge dense key range is rejected");
+    const auto groups = from_bytes<Groups>(patched(Groups(4), prototype_size, std::uint64_t{1000}));
+    EXPECT_TRUE(groups.find(999) == nullptr, "modest dense key range restores");
+}
+
+// Type-7 quantile from a full sort, the reference for exact mode
+double sorted_quantile(std::vector<double> values, double q) {
+    std::sort(values.begin(), values.end());
+    const double h = q * static_cast<double>(values.size() - 1);
+    const auto lo = static_cast<std::size_t>(h);
+    const std::size_t hi = std::min(lo + 1, values.size() - 1);
+    return values[lo] + (h - static_cast<double>(lo)) * (values[hi] - values[lo]);
+}
+
+// Multi-selection across merged chunked buffers equals sorting
+void test_exact_quantiles() {
+    auto rng = make_rng(111);
+    std::lognormal_distribution<double> dist(0.0, 1.5);
+    std::vector<double> values(200'000);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        // Heavy ties in part of the data
+        values[i] = i % 5 == 0 ? std::round(dist(rng)) : dist(rng);
+    }
+    const std::vector<double> qs{0.0, 0.001, 0.25, 0.5, 0.9, 0.99, 0.999, 1.0};
+
+    for (std::size_t threads : {1u, 4u}) {
+        ExactQuantileAggregator a(threads, {}, 7'000);
+        ExactQuantileAggregator b(threads, {}, 7'000);
+        a.add_batch(std::span<const double>(values).first(120'000));
+        for (std::size_t i = 120'000; i < values.size(); ++i) b.add(values[i]);
+        a.merge(b);
+        EXPECT_EQ(a.count(), values.size(), "exact count");
+        auto got = a.quantiles(qs);
+        for (std::size_t i = 0; i < qs.size(); ++i) {
+            EXPECT_NEAR(got[i], sorted_quantile(values, qs[i]), 0.0, "exact quantile " << qs[i] << " threads=" << threads);
+        }
+        // Buffers shared by merge() are not appended to afterwards
+        b.add(1e9);
+        EXPECT_EQ(a.count(), values.size(), "merged buffers unchanged by later adds");
+        EXPECT_NEAR(a.quantile(1.0), sorted_quantile(values, 1.0), 0.0, "merged max unchanged");
+    }
+
+    ExactQuantileAggregator small;
+    small.add(3.0);
+    EXPECT_NEAR(small.quantile(0.7), 3.0, 0.0, "single value");
+    EXPECT_NEAR(ExactQuantileAggregator{}.quantile(0.5), 0.0, 0.0, "empty aggregator");
+}
+
+// Spilled chunks live in unlinked mapped files and give the same answers
+void test_exact_quantiles_spill() {
+    const std::string dir = std::filesystem::temp_directory_path().string();
+    auto values = ar1_chain(112, 0.0, 50'000);
+    ExactQuantileAggregator spilled(2, dir, 4'096);
+    spilled.add_batch(values);
+    EXPECT_TRUE(spilled.spilled_chunks() >= 12, "full chunks were spilled");
+    for (double q : {0.01, 0.5, 0.975}) {
+        EXPECT_NEAR(spilled.quantile(q), sorted_quantile(values, q), 0.0, "spilled quantile " << q);
+    }
+    auto restored = from_bytes<ExactQuantileAggregator>(to_bytes(spilled));
+    EXPECT_NEAR(restored.quantile(0.3), spilled.quantile(0.3), 0.0, "restored exact quantile");
+
+    // OTM-like payoffs: 90% zeros and a capped atom at 1; ranks in and at
+    // the edges of either run of ties are answered from the counts
+    std::mt19937_64 payoff_rng(113);
+    std::uniform_real_distribution<double> u01(0.0, 1.0);
+    std::vector<double> payoffs(200'000);
+    for (double& v : payoffs) {
+        const double u = u01(payoff_rng);
+        v = u < 0.9 ? 0.0 : std::min((u - 0.9) * 20.0, 1.0);
+    }
+    ExactQuantileAggregator zeros(2, dir, 16'384);
+    zeros.add_batch(payoffs);
+    EXPECT_TRUE(zeros.spilled_chunks() >= 12, "zero-heavy chunks were spilled");
+    for (double q : {0.0, 0.3, 0.8999, 0.9, 0.90001, 0.93, 0.9499, 0.96, 0.999, 1.0}) {
+        EXPECT_NEAR(zeros.quantile(q), sorted_quantile(payoffs, q), 0.0, "zero-heavy quantile " << q);
+    }
+#ifdef MCLIB_PARALLEL_ENABLED
+    auto engine = make_engine<Uniform01Model, execution::Parallel, ExactQuantileAggregator>(
+        Uniform01Model{}, execution::Parallel{3}, 9);
+    auto r = engine.run_aggregate(90'000, ExactQuantileAggregator(3, dir, 10'000));
+    EXPECT_EQ(r.aggregator.count(), 90'000u, "parallel exact count");
+    EXPECT_NEAR(r.estimate, 0.5, 0.01, "parallel exact median");
+    EXPECT_NEAR(r.aggregator.quantile(0.99), 0.99, 0.005, "parallel exact p99");
+#else
+    std::cout << "[skip] exact quantiles parallel (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+}
+
+// FFT KDE matches direct summation over the binned weights and tracks the
+// true density; the grid ECDF is exact
+void test_density_aggregator() {
+    auto rng = make_rng(113);
+    std::normal_distribution<double> dist(0.0, 1.0);
+    std::vector<double> values(200'000);
+    for (double& v : values) v = dist(rng);
+    values[0] = 7.0;  // off the grid
+    values[1] = -5.0;  // on the first grid point
+
+    DensityAggregator a(801, -5.0, 5.0);
+    DensityAggregator b(801, -5.0, 5.0);
+    a.add_batch(std::span<const double>(values).first(150'000));
+    for (std::size_t i = 150'000; i < values.size(); ++i) b.add(values[i]);
+    a.merge(b);
+    EXPECT_EQ(a.count(), values.size(), "density count");
+
+    const double bw = a.bandwidth();
+    EXPECT_NEAR(bw, 0.9 * std::pow(200'000.0, -0.2), 0.005, "Silverman bandwidth");
+    const auto density = a.density(bw);
+    const auto grid = a.grid();
+    const auto& w = a.weights();
+    const double h = grid[1] - grid[0];
+    const double support = std::ceil(4.0 * bw / h);  // kernel truncation used by density()
+    double mass = 0.0;
+    for (std::size_t j = 0; j < grid.size(); ++j) {
+        mass += density[j] * h;
+        if (j % 40 == 0) {
+            double direct = 0.0;
+            for (std::size_t i = 0; i < w.size(); ++i) {
+                const double z = (grid[j] - grid[i]) / bw;
+                if (std::abs(static_cast<double>(i) - static_cast<double>(j)) <= support) direct += w[i] * std::exp(-0.5 * z * z);
+            }
+            direct /= static_cast<double>(a.count()) * bw * std::sqrt(2.0 * std::numbers::pi);
+            EXPECT_NEAR(density[j], direct, 1e-12, "FFT equals direct convolution at " << grid[j]);
+            const double truth = std::exp(-0.5 * grid[j] * grid[j]) / std::sqrt(2.0 * std::numbers::pi);
+            EXPECT_NEAR(density[j], truth, 0.01, "KDE near normal pdf at " << grid[j]);
+        }
+    }
+    EXPECT_NEAR(mass, 1.0 - 1.0 / 200'000.0, 2e-3, "density mass inside the grid");
+
+    const auto cdf = a.ecdf();
+    std::vector<double> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    for (std::size_t j : {0u, 123u, 400u, 650u, 800u}) {
+        const auto below = std::upper_bound(sorted.begin(), sorted.end(), grid[j]) - sorted.begin();
+        EXPECT_NEAR(cdf[j], static_cast<double>(below) / static_cast<double>(values.size()), 1e-12,
+            "ECDF at " << grid[j]);
+    }
+
+    auto restored = from_bytes<DensityAggregator>(to_bytes(a));
+    EXPECT_NEAR(restored.density(bw)[400], density[400], 0.0, "restored density");
+    bool threw = false;
+    try {
+        a.merge(DensityAggregator(801, -4.0, 5.0));
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw, "mismatched grids are rejected");
+    EXPECT_NEAR(DensityAggregator{}.density()[10], 0.0, 0.0, "empty density");
+}
+
+// Counts stay exact while the window follows the mass; merges of
+// differently placed windows agree with one pass over everything
+void test_sparse_histogram() {
+    auto rng = make_rng(114);
+    std::poisson_distribution<std::int64_t> bulk(5'000.0);
+    std::geometric_distribution<std::int64_t> tail(1e-5);
+    std::vector<std::int64_t> values(300'000);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        values[i] = i % 50 == 0 ? 5'000 + tail(rng) : bulk(rng);
+    }
+    values[0] = -2'000'000;  // a bad first value places the window far away
+
+    SparseHistogramAggregator a(256, 1 << 16);
+    SparseHistogramAggregator b(256, 1 << 16);
+    a.add_batch(std::span<const std::int64_t>(values).first(200'000));
+    for (std::size_t i = 200'000; i < values.size(); ++i) b.add(values[i]);
+    EXPECT_TRUE(a.window_size() > 256, "window grew");
+    EXPECT_TRUE(a.window_begin() > 0 && a.window_begin() < 5'000, "window moved to the bulk");
+    EXPECT_TRUE(a.tail_size() < 5'000, "bulk left the tail");
+    a.merge(b);
+    EXPECT_EQ(a.count(), values.size(), "sparse count");
+
+    std::vector<std::int64_t> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    std::uint64_t total = 0;
+    double sum = 0.0;
+    bool exact = true;
+    std::int64_t previous = std::numeric_limits<std::int64_t>::min();
+    a.for_each([&](std::int64_t key, std::uint64_t n) {
+        const auto range = std::equal_range(sorted.begin(), sorted.end(), key);
+        exact = exact && key > previous && static_cast<std::uint64_t>(range.second - range.first) == n;
+        previous = key;
+        total += n;
+        sum += static_cast<double>(key) * static_cast<double>(n);
+    });
+    EXPECT_TRUE(exact, "per-key counts exact and ascending");
+    EXPECT_EQ(total, values.size(), "counts sum to n");
+    EXPECT_NEAR(a.result(), sum / static_cast<double>(values.size()), 1e-9, "sparse mean");
+    EXPECT_EQ(a.count_of(-2'000'000), 1u, "outlier kept");
+    EXPECT_EQ(a.count_of(123), 0u, "unseen key");
+    for (double q : {0.0, 0.5, 0.99, 1.0}) {
+        const auto k = static_cast<std::size_t>(std::ceil(q * static_cast<double>(values.size())));
+        EXPECT_EQ(a.quantile(q), sorted[k == 0 ? 0 : k - 1], "sparse quantile " << q);
+    }
+
+    auto restored = from_bytes<SparseHistogramAggregator>(to_bytes(a));
+    EXPECT_TRUE(restored.counts() == a.counts(), "restored counts");
+    restored.add(7);
+    EXPECT_EQ(restored.count_of(7), a.count_of(7) + 1, "restored keeps counting");
+
+    // Keys at both ends of the int64 range; doubles beyond it are clamped
+    constexpr std::int64_t kMin = std::numeric_limits<std::int64_t>::min();
+    constexpr std::int64_t kMax = std::numeric_limits<std::int64_t>::max();
+    SparseHistogramAggregator ends(16, 1 << 10);
+    for (std::int64_t i = 0; i < 2'000; ++i) ends.add(kMax - i % 8);  // window pinned to the top
+    for (std::int64_t i = 0; i < 300; ++i) ends.add(kMax - 8 - i);     // stretches it downwards
+    for (std::int64_t i = 0; i < 300; ++i) ends.add(kMin + i);
+    const std::vector<double> huge = {1e300, -1e300, std::numeric_limits<double>::infinity(),
+                                      -std::numeric_limits<double>::infinity(), 9223372036854775808.0};
+    ends.add_batch(huge);
+    ends.add(-1e300);
+    EXPECT_EQ(ends.count(), 2'606u, "extreme count");
+    EXPECT_EQ(ends.count_of(kMax), 253u, "clamped to max");
+    EXPECT_EQ(ends.count_of(kMin), 4u, "clamped to min");
+    EXPECT_EQ(ends.count_of(kMax - 100), 1u, "key near max");
+    EXPECT_TRUE(ends.window_size() > 16, "window adapted at the range ends");
+    bool ascending = true;
+    std::uint64_t seen = 0;
+    previous = kMin;
+    ends.for_each([&](std::int64_t key, std::uint64_t n) {
+        ascending = ascending && (seen == 0 || key > previous);
+        previous = key;
+        seen += n;
+    });
+    EXPECT_TRUE(ascending && seen == ends.count(), "extreme keys ascending");
+
+    // Integer models take the integer batch path
+    auto die = [](auto& rng) { return std::uniform_int_distribution<int>(1, 6)(rng); };
+    auto engine = make_engine<decltype(die), execution::Sequential, SparseHistogramAggregator>(
+        die, execution::Sequential{}, 5);
+    auto r = engine.run_aggregate(60'000, SparseHistogramAggregator(16));
+    EXPECT_EQ(r.aggregator.distinct(), 6u, "six faces");
+    EXPECT_NEAR(r.estimate, 3.5, 0.03, "die mean");
+#ifdef MCLIB_PARALLEL_ENABLED
+    auto parallel = make_engine<decltype(die), execution::Parallel, SparseHistogramAggregator>(
+        die, execution::Parallel{3}, 5);
+    auto p = parallel.run_aggregate(60'000, SparseHistogramAggregator(16));
+    EXPECT_EQ(p.aggregator.count(), 60'000u, "parallel sparse count");
+    EXPECT_EQ(p.aggregator.tail_size(), 0u, "faces in the window");
+#else
+    std::cout << "[skip] sparse histogram parallel (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+}
+
+// Every trial lands in the file once, in blocks that carry their stream and
+// trial range; the mapped reader sees the same values the sink averaged
+void test_sample_sink() {
+    const std::string path = (std::filesystem::temp_directory_path() / "mclib-test-samples.bin").string();
+    auto check_file = [&](const SampleSinkAggregator& sink, std::uint64_t n, const char* label) {
+        auto file = io::SampleFile::open(path);
+        EXPECT_EQ(file.count(), n, label << ": sample count");
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges;
+        WelfordAggregator<> moments;
+        bool trials_ok = true;
+        file.for_each_block([&](const io::SampleBlock& block) {
+            ranges.emplace_back(block.first_trial, block.values.size());
+            moments.add_batch(block.values);
+            for (std::size_t i = 0; i < block.trials.size(); ++i) {
+                trials_ok = trials_ok && block.trials[i] == block.first_trial + i;
+            }
+        });
+        std::sort(ranges.begin(), ranges.end());
+        std::uint64_t next = 0;
+        for (const auto& [first, size] : ranges) {
+            EXPECT_EQ(first, next, label << ": blocks tile the trial range");
+            next = first + size;
+        }
+        EXPECT_EQ(next, n, label << ": all trials present");
+        EXPECT_TRUE(trials_ok, label << ": trial-index column");
+        EXPECT_NEAR(moments.result(), sink.result(), 1e-12, label << ": file mean matches sink");
+    };
+
+    {
+        auto engine = make_engine<Uniform01Model, execution::Sequential, SampleSinkAggregator>(
+            Uniform01Model{}, execution::Sequential{}, 21);
+        auto r = engine.run_aggregate(50'000, SampleSinkAggregator(path, true, 4'096));
+        EXPECT_NEAR(r.estimate, 0.5, 0.01, "sink estimate");
+        r.aggregator.close();
+        auto file = io::SampleFile::open(path);
+        EXPECT_TRUE(file.has_trial_index(), "trial-index flag");
+        EXPECT_EQ(file.blocks(), 13u, "12 full blocks plus the remainder");
+        check_file(r.aggregator, 50'000, "sequential");
+    }
+#ifdef MCLIB_PARALLEL_ENABLED
+    // Synchronous appends, then the background writer with two buffers
+    // per worker so producers hit backpressure
+    for (std::size_t async_buffers : {0u, 2u}) {
+        auto engine = make_engine<Uniform01Model, execution::Parallel, SampleSinkAggregator>(
+            Uniform01Model{}, execution::Parallel{3}, 21);
+        auto r = engine.run_aggregate(40'001, SampleSinkAggregator(path, false, 1'000, async_buffers));
+        r.aggregator.close();
+        auto file = io::SampleFile::open(path);
+        EXPECT_TRUE(!file.has_trial_index(), "no trial-index column");
+        std::vector<std::uint64_t> streams;
+        file.for_each_block([&](const io::SampleBlock& block) { streams.push_back(block.stream_id); });
+        std::sort(streams.begin(), streams.end());
+        streams.erase(std::unique(streams.begin(), streams.end()), streams.end());
+        EXPECT_EQ(streams.size(), 3u, "one stream id per worker");
+        check_file(r.aggregator, 40'001, async_buffers > 0 ? "parallel async" : "parallel");
+    }
+#else
+    std::cout << "[skip] sample sink parallel (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+
+    // A restored sink continues the file where the snapshot left it
+    std::vector<std::byte> snapshot;
+    {
+        SampleSinkAggregator sink(path, true, 4'096, 3);
+        sink.add_batch(ar1_chain(22, 0.0, 10'000));
+        snapshot = to_bytes(sink);
+        bool threw = false;
+        try {
+            io::SampleFile::open(path);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        EXPECT_TRUE(threw, "unfinished file rejected");
+        sink.add_batch(ar1_chain(23, 0.0, 3'000));  // dropped by the restore
+    }
+    auto restored = from_bytes<SampleSinkAggregator>(snapshot);
+    restored.add_batch(ar1_chain(24, 0.0, 5'000));
+    restored.close();
+    check_file(restored, 15'000, "restored");
+    std::filesystem::remove(path);
+}
+
+// Black-Scholes call under geometric Brownian motion, built per row
+struct GbmCall {
+    double s0, k, r, sigma, t;
+
+    template <typename RNG>
+    double operator()(RNG& rng) const {
+        std::normal_distribution<double> dist(0.0, 1.0);
+        const double st = s0 * std::exp((r - 0.5 * sigma * sigma) * t + sigma * std::sqrt(t) * dist(rng));
+        return std::exp(-r * t) * std::max(st - k, 0.0);
+    }
+
+    double analytical() const {
+        const double d1 = (std::log(s0 / k) + (r + 0.5 * sigma * sigma) * t) / (sigma * std::sqrt(t));
+        const double d2 = d1 - sigma * std::sqrt(t);
+        auto cdf = [](double x) { return 0.5 * (1.0 + std::erf(x / std::sqrt(2.0))); };
+        return s0 * cdf(d1) - k * std::exp(-r * t) * cdf(d2);
+    }
+};
+
+// Every contract in a mapped parameter file is priced independently of the
+// thread count; results round-trip through an output file
+void test_batch_driver() {
+    const auto dir = std::filesystem::temp_directory_path();
+    const std::string params_path = (dir / "mclib-test-params.bin").string();
+    const std::string out_path = (dir / "mclib-test-prices.bin").string();
+    constexpr std::size_t contracts = 300;
+    std::vector<double> s0(contracts), k(contracts), r(contracts), sigma(contracts), t(contracts);
+    for (std::size_t i = 0; i < contracts; ++i) {
+        s0[i] = 80.0 + static_cast<double>(i % 41);
+        k[i] = 100.0;
+        r[i] = 0.01 * static_cast<double>(i % 6);
+        sigma[i] = 0.1 + 0.05 * static_cast<double>(i % 7);
+        t[i] = 0.25 + 0.25 * static_cast<double>(i % 8);
+    }
+    io::write_param_file(params_path, {"S0", "K", "r", "sigma", "T"}, {s0, k, r, sigma, t});
+    const auto params = io::ParamFile::open(params_path);
+    EXPECT_EQ(params.rows(), contracts, "parameter rows");
+    EXPECT_EQ(params.columns(), 5u, "parameter columns");
+    EXPECT_NEAR(params.column("sigma")[13], sigma[13], 0.0, "column by name");
+    EXPECT_EQ(params.name(3), std::string("sigma"), "column name");
+
+    auto make_model = [](const io::ParamRow& p) { return GbmCall{p[0], p[1], p[2], p[3], p[4]}; };
+    std::vector<double> price(contracts), error(contracts), again(contracts);
+    execution::Batch batch(3, 7);
+    batch.run(params, make_model, 20'000, {price, error}, 99);
+    bool within = true;
+    for (std::size_t i = 0; i < contracts; ++i) {
+        const double truth = make_model(params.row(i)).analytical();
+        // Deep out-of-the-money contracts may see no payoff at all
+        within = within && std::abs(price[i] - truth) < 5.0 * error[i] + 1e-3;
+    }
+    EXPECT_TRUE(within, "every contract within 5 std errors of Black-Scholes");
+
+    // Same seed, different pool and chunking: identical prices
+    execution::Batch single(1, 64);
+    single.run(params, make_model, 20'000, {again, {}}, 99);
+    EXPECT_TRUE(again == price, "batch results independent of scheduling");
+    batch.run(params, make_model, 20'000, {again, {}}, 99);
+    EXPECT_TRUE(again == price, "pool reused across runs");
+
+    io::write_param_file(out_path, {"estimate", "std_error"}, {price, error});
+    const auto out = io::ParamFile::open(out_path);
+    EXPECT_NEAR(out.column("estimate")[299], price[299], 0.0, "output file estimate");
+    EXPECT_NEAR(out.column(1)[5], error[5], 0.0, "output file std error");
+
+    bool threw = false;
+    try {
+        batch.run(params, [](const io::ParamRow& p) {
+            if (p.index() == 150) throw std::runtime_error("bad contract");
+            return GbmCall{p[0], p[1], p[2], p[3], p[4]};
+        }, 10, {again, {}});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw, "worker exception reaches the caller");
+    threw = false;
+    try {
+        io::ParamFile::open(out_path + ".missing");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw, "missing parameter file");
+
+    // Header fields patched in a copy of a valid file are caught before any
+    // column span is formed
+    const std::string bad_path = (dir / "mclib-test-corrupt.bin").string();
+    auto corrupt = [&](std::size_t offset, std::uint64_t value, const char* what) {
+        std::filesystem::copy_file(out_path, bad_path, std::filesystem::copy_options::overwrite_existing);
+        auto file = io::WritableFile::resume(bad_path, std::filesystem::file_size(bad_path));
+        file.write_at(offset, std::as_bytes(std::span<const std::uint64_t>(&value, 1)));
+        file.flush();
+        bool rejected = false;
+        try {
+            io::ParamFile::open(bad_path);
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        EXPECT_TRUE(rejected, what);
+    };
+    corrupt(offsetof(io::ParamFileHeader, rows), (std::uint64_t{1} << 61) + 1, "row count that wraps rows * 8");
+    corrupt(offsetof(io::ParamFileHeader, rows), contracts + 100, "row count past the stride");
+    corrupt(offsetof(io::ParamFileHeader, names_offset), std::uint64_t{1} << 40, "names past the data");
+    corrupt(offsetof(io::ParamFileHeader, column_stride), 0, "zero stride");
+    std::filesystem::remove(bad_path);
+    std::filesystem::remove(params_path);
+    std::filesystem::remove(out_path);
+}
+
+// Uniform draws that throw on a chosen call, standing in for a pre-empted
+// node; with no counter it never fails
+struct PreemptedModel {
+    std::atomic<std::uint64_t>* calls = nullptr;
+    std::uint64_t fail_at = 0;
+
+    template<typename RNG>
+    double operator()(RNG& rng) const {
+        if (calls != nullptr && calls->fetch_add(1) + 1 == fail_at) throw std::runtime_error("pre-empted");
+        return std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    }
+};
+
+// Exact quantiles keep every sample, so each snapshot costs O(trials so
+// far); counts how many snapshots a run takes
+struct CountedQuantiles : ExactQuantileAggregator {
+    inline static std::atomic<std::uint64_t> snapshots{0};
+
+    void serialize(ByteWriter& w) const {
+        ++snapshots;
+        ExactQuantileAggregator::serialize(w);
+    }
+
+    static CountedQuantiles deserialize(ByteReader& r) { return {ExactQuantileAggregator::deserialize(r)}; }
+};
+
+void test_checkpoint_resume() {
+    const std::string path = (std::filesystem::temp_directory_path() / "mclib-test-checkpoint.bin").string();
+    const execution::CheckpointOptions opts{path, 1'000};
+    constexpr std::uint64_t n = 100'003;
+
+    auto engine = make_engine(PreemptedModel{}, execution::Sequential{}, 7);
+    const Result reference = engine.run(n);
+    Result r = engine.run(n, opts);
+    EXPECT_TRUE(r.estimate == reference.estimate && r.variance == reference.variance,
+                "checkpointed run matches run()");
+    EXPECT_TRUE(io::Checkpoint::load(path).finished(), "final checkpoint is complete");
+
+    std::atomic<std::uint64_t> calls{0};
+    auto flaky = make_engine(PreemptedModel{&calls, 60'000}, execution::Sequential{}, 7);
+    bool threw = false;
+    try {
+        flaky.run(n, opts);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw, "interrupted run throws");
+    const io::Checkpoint saved = io::Checkpoint::load(path);
+    EXPECT_TRUE(saved.completed() > 0 && saved.completed() < 60'000 && saved.completed() % 1'024 == 0,
+                "checkpoint holds whole slices before the failure");
+    EXPECT_EQ(saved.aggregate<WelfordAggregator<>>().count(), saved.completed(), "checkpoint aggregate");
+
+    r = engine.resume(opts);
+    EXPECT_TRUE(r.estimate == reference.estimate && r.variance == reference.variance &&
+                r.standard_error == reference.standard_error, "resumed run matches uninterrupted run");
+    EXPECT_EQ(r.iterations, n, "resumed iterations");
+
+#ifdef MCLIB_PARALLEL_ENABLED
+    auto par = make_engine<PreemptedModel, execution::Parallel, MomentsAggregator>(PreemptedModel{},
+        execution::Parallel{3}, 11);
+    const Result par_reference = par.run(n);
+    calls = 0;
+    auto par_flaky = make_engine<PreemptedModel, execution::Parallel, MomentsAggregator>(
+        PreemptedModel{&calls, 50'000}, execution::Parallel{3}, 11);
+    threw = false;
+    try {
+        par_flaky.run(n, opts);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw, "interrupted parallel run throws");
+    EXPECT_EQ(io::Checkpoint::load(path).workers.size(), 3u, "one checkpoint entry per worker");
+    r = par.resume(opts);
+    EXPECT_TRUE(r.estimate == par_reference.estimate && r.variance == par_reference.variance,
+                "resumed parallel run matches uninterrupted run");
+
+    threw = false;
+    try {
+        engine.resume(opts);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw, "worker count must match the checkpoint");
+#else
+    std::cout << "[skip] parallel checkpoint (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+
+    // Slices stretch with the snapshot size: with a fixed 1,024-trial slice
+    // this run would take ~200 O(N) snapshots
+    constexpr std::uint64_t growing_n = 200'000;
+    auto growing = make_engine<Uniform01Model, execution::Sequential, CountedQuantiles>(
+        Uniform01Model{}, execution::Sequential{}, 13);
+    const Result growing_reference = growing.run(growing_n);
+    CountedQuantiles::snapshots = 0;
+    r = growing.run(growing_n, opts);
+    EXPECT_TRUE(CountedQuantiles::snapshots < 20, "growing state snapshots " << CountedQuantiles::snapshots.load());
+    EXPECT_TRUE(r.estimate == growing_reference.estimate, "stretched slices leave the result unchanged");
+    EXPECT_EQ(io::Checkpoint::load(path).aggregate<CountedQuantiles>().count(), growing_n, "final growing checkpoint");
+    std::filesystem::remove(path);
+}
+
+void test_result_export() {
+    auto engine = make_engine(Uniform01Model{}, execution::Sequential{}, 5);
+    Result r = engine.run(10'000);
+    EXPECT_EQ(r.workers.size(), 1u, "sequential reports one worker");
+    EXPECT_EQ(r.workers[0].trials, 10'000u, "worker trial count");
+    EXPECT_TRUE(r.workers[0].elapsed_ms <= r.elapsed_ms && r.setup_ms >= 0.0, "worker time within the run");
+
+    const std::string json = to_json(r);
+    EXPECT_TRUE(json.front() == '{' && json.back() == '}' && json.find('\n') == std::string::npos, "one-line JSON");
+    EXPECT_TRUE(json.find("\"iterations\":10000,") != std::string::npos, "JSON iterations");
+    EXPECT_TRUE(json.find("\"workers\":[{\"trials\":10000,") != std::string::npos, "JSON workers");
+    // Shortest round-trip form reads back exactly
+    const std::size_t at = json.find("\"estimate\":") + 11;
+    EXPECT_TRUE(std::stod(json.substr(at, json.find(',', at) - at)) == r.estimate, "JSON estimate round-trips");
+
+    Result odd;
+    odd.variance = std::numeric_limits<double>::quiet_NaN();
+    EXPECT_TRUE(to_json(odd).find("\"variance\":null") != std::string::npos, "non-finite values are null");
+    EXPECT_EQ(to_json(odd), std::string("{\"estimate\":0,\"variance\":null,\"standard_error\":0,\"iterations\":0,"
+        "\"elapsed_ms\":0,\"setup_ms\":0,\"merge_ms\":0,\"workers\":[]}"), "empty result JSON");
+
+    const std::string header = csv_header();
+    const std::string row = to_csv(r);
+    EXPECT_EQ(std::count(header.begin(), header.end(), ','), std::count(row.begin(), row.end(), ','),
+              "CSV row matches header");
+    EXPECT_TRUE(row.ends_with(",1\n"), "CSV worker count");
+    EXPECT_TRUE(worker_csv(r).starts_with("0,10000,"), "worker CSV row");
+
+#ifdef MCLIB_PARALLEL_ENABLED
+    auto par = make_engine(Uniform01Model{}, execution::Parallel{3}, 5);
+    r = par.run(10'001);
+    std::uint64_t total = 0;
+    for (const WorkerStats& w : r.workers) total += w.trials;
+    EXPECT_EQ(r.workers.size(), 3u, "parallel reports every worker");
+    EXPECT_EQ(total, 10'001u, "worker trials sum to the run");
+    EXPECT_TRUE(r.merge_ms >= 0.0 && r.setup_ms + r.merge_ms <= r.elapsed_ms, "setup and merge within the run");
+    const std::string workers = worker_csv(r);
+    EXPECT_EQ(std::count(workers.begin(), workers.end(), '\n'), 3, "one CSV row per worker");
+#else
+    std::cout << "[skip] parallel worker stats (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+}
+
+// Sum statistic without remove(), so BCa cannot jackknife it
+struct SumOnly {
+    std::span<const double> x;
+    std::atomic<std::size_t>* adds = nullptr;
+    double sum = 0.0;
+    void reset() { sum = 0.0; }
+    void add(std::size_t i) {
+        sum += x[i];
+        if (adds != nullptr) ++*adds;
+    }
+    double value() const { return sum; }
+};
+
+void test_bootstrap() {
+    // Right-skewed payoffs: a normal interval is symmetric, BCa is not
+    auto rng = make_rng(81);
+    std::lognormal_distribution<double> lognormal(0.0, 1.0);
+    std::vector<double> x(2'000);
+    for (double& v : x) v = lognormal(rng);
+    WelfordAggregator<> w;
+    w.add_batch(x);
+
+    bootstrap::Options opts;
+    opts.threads = 3;
+    const ConfidenceInterval bca = bootstrap::mean_interval(x, opts);
+    EXPECT_TRUE(bca.lower < w.result() && w.result() < bca.upper, "BCa interval covers the sample mean");
+    EXPECT_TRUE(bca.upper - w.result() > w.result() - bca.lower, "BCa interval leans towards the long tail");
+    EXPECT_NEAR(bca.confidence_level, 0.95, 0.0, "interval level");
+    opts.threads = 1;
+    const ConfidenceInterval single = bootstrap::mean_interval(x, opts);
+    EXPECT_TRUE(single.lower == bca.lower && single.upper == bca.upper, "interval independent of thread count");
+
+    opts.method = bootstrap::Method::Percentile;
+    const ConfidenceInterval pct = bootstrap::mean_interval(x, opts);
+    const double normal_width = 2.0 * 1.959964 * w.std_error();
+    EXPECT_NEAR((pct.upper - pct.lower) / normal_width, 1.0, 0.1, "percentile width near the normal width");
+
+    // Coverage of the true mean exp(1/2) on small skewed samples
+    int covered = 0;
+    bootstrap::Options small;
+    small.resamples = 500;
+    small.threads = 1;
+    std::vector<double> y(40);
+    for (int rep = 0; rep < 200; ++rep) {
+        for (double& v : y) v = lognormal(rng);
+        small.seed = static_cast<std::uint64_t>(rep);
+        const ConfidenceInterval ci = bootstrap::mean_interval(y, small);
+        covered += ci.lower <= std::exp(0.5) && std::exp(0.5) <= ci.upper;
+    }
+    EXPECT_TRUE(covered >= 170 && covered <= 198, "BCa coverage near 95%");
+
+    // Ratio estimator: sum(2x + noise) / sum(x)
+    std::normal_distribution<double> noise(0.0, 0.5);
+    std::vector<double> num(x.size());
+    for (std::size_t i = 0; i < x.size(); ++i) num[i] = 2.0 * x[i] + noise(rng);
+    const ConfidenceInterval ratio = bootstrap::ratio_interval(num, x);
+    EXPECT_TRUE(ratio.lower < 2.0 && 2.0 < ratio.upper && ratio.upper - ratio.lower < 0.1, "ratio interval");
+
+    // Autocorrelated chain: resampling single values understates the
+    // spread by about sqrt((1 + phi) / (1 - phi)) = 3
+    const std::vector<double> chain = ar1_chain(91, 0.8, 20'000);
+    bootstrap::Options iid;
+    iid.resamples = 1'000;
+    const ConfidenceInterval naive = bootstrap::mean_interval(chain, iid);
+    bootstrap::Options blocks = iid;
+    blocks.block = 200;
+    const ConfidenceInterval blocked = bootstrap::mean_interval(chain, blocks);
+    const double ratio_width = (blocked.upper - blocked.lower) / (naive.upper - naive.lower);
+    EXPECT_TRUE(ratio_width > 2.2 && ratio_width < 4.0, "block bootstrap widens the interval");
+    EXPECT_TRUE(blocked.lower < 5.0 && 5.0 < blocked.upper, "block interval covers the chain mean");
+    const std::vector<double> means = bootstrap::batch_means(chain, 200);
+    EXPECT_EQ(means.size(), 100u, "batch count");
+    const ConfidenceInterval batched = bootstrap::mean_interval(means, iid);
+    EXPECT_NEAR((batched.upper - batched.lower) / (blocked.upper - blocked.lower), 1.0, 0.35,
+                "batch means agree with the block bootstrap");
+
+    bool threw = false;
+    std::atomic<std::size_t> adds{0};
+    try {
+        bootstrap::interval(x.size(), SumOnly{x, &adds}, bootstrap::Options{});
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw, "BCa needs remove()");
+    EXPECT_EQ(adds.load(), 0u, "BCa rejected before any resampling");
+    bootstrap::Options percentile;
+    percentile.method = bootstrap::Method::Percentile;
+    const ConfidenceInterval sum = bootstrap::interval(x.size(), SumOnly{x}, percentile);
+    EXPECT_TRUE(sum.lower < w.result() * 2'000.0 && w.result() * 2'000.0 < sum.upper, "percentile without remove()");
+}
+
+// Uniform draws on [0, scale); hashes its parameter so the cache can tell
+// configurations apart
+struct ScaledUniformModel {
+    double scale = 1.0;
+
+    template<typename RNG>
+    double operator()(RNG& rng) const {
+        return std::uniform_real_distribution<double>(0.0, scale)(rng);
+    }
+
+    std::uint64_t config_hash() const { return ConfigHasher{}.add("ScaledUniformModel").add(scale).value(); }
+};
+
+// Only models with config_hash() can run through the cache; a stateless
+// model keyed by its type would keep its key across code changes
+template<typename Engine>
+concept CachedRunnable = requires(const Engine& e, io::ResultCache& cache) { e.run(std::uint64_t{1}, cache); };
+static_assert(CachedRunnable<decltype(make_engine(ScaledUniformModel{}, execution::Sequential{}, 1))>);
+static_assert(!CachedRunnable<decltype(make_engine(Uniform01Model{}, execution::Sequential{}, 1))>);
+
+void test_result_cache() {
+    const auto dir = std::filesystem::temp_directory_path() / "mclib-test-result-cache";
+    std::filesystem::remove_all(dir);
+    io::ResultCache cache(dir.string(), 16);
+
+    auto engine = make_engine(ScaledUniformModel{2.0}, execution::Sequential{}, 3);
+    const Result first = engine.run(20'000, cache);
+    EXPECT_EQ(cache.misses(), 1u, "first run misses");
+    const Result again = engine.run(20'000, cache);
+    EXPECT_EQ(cache.hits(), 1u, "second run hits");
+    EXPECT_TRUE(again.estimate == first.estimate && again.variance == first.variance &&
+                again.elapsed_ms == first.elapsed_ms && again.workers.size() == first.workers.size(),
+                "hit returns the stored result");
+
+    const WelfordAggregator<> empty;
+    const CacheKey key = engine.cache_key(20'000, empty);
+    EXPECT_TRUE(key == engine.cache_key(20'000, empty), "key is deterministic");
+    EXPECT_TRUE(!(key == engine.cache_key(20'001, empty)), "iterations change the key");
+    EXPECT_TRUE(!(key == make_engine(ScaledUniformModel{2.0}, execution::Sequential{}, 4).cache_key(20'000, empty)),
+                "seed changes the key");
+    EXPECT_TRUE(!(key == make_engine(ScaledUniformModel{3.0}, execution::Sequential{}, 3).cache_key(20'000, empty)),
+                "model parameters change the key");
+
+    // Aggregator state round-trips through the entry
+    WelfordAggregator<> agg;
+    const Result with_state = engine.run(20'000, agg, cache);
+    EXPECT_EQ(agg.count(), 20'000u, "aggregator filled on first stateful run");
+    WelfordAggregator<> restored;
+    const std::uint64_t hits = cache.hits();
+    const Result cached = engine.run(20'000, restored, cache);
+    EXPECT_EQ(cache.hits(), hits + 1, "stateful run hits");
+    EXPECT_TRUE(cached.estimate == with_state.estimate, "stateful hit result");
+    EXPECT_TRUE(restored.count() == agg.count() && restored.result() == agg.result() &&
+                restored.variance() == agg.variance(), "aggregator restored from the cache");
+
+    // Growth past half the initial 16 slots, seen by a second handle
+    for (std::uint64_t n = 1; n <= 40; ++n) engine.run(n * 100, cache);
+    io::ResultCache other(dir.string());
+    EXPECT_EQ(other.size(), 41u, "index lists every entry");
+    bool all_found = other.find(key).has_value();
+    for (std::uint64_t n = 1; n <= 40; ++n) all_found = all_found && other.find(engine.cache_key(n * 100, empty));
+    EXPECT_TRUE(all_found, "entries survive index growth");
+    EXPECT_TRUE(!other.find(CacheKey{1, 2}), "unknown key misses");
+
+    // A lost entry file is recomputed rather than trusted
+    std::filesystem::remove_all(dir);
+    io::ResultCache fresh(dir.string());
+    fresh.store(key, first);
+    for (const auto& file : std::filesystem::directory_iterator(dir)) {
+        if (file.path().extension() == ".res") std::filesystem::remove(file.path());
+    }
+    EXPECT_TRUE(!fresh.find(key), "missing entry is a miss");
+
+#ifdef MCLIB_PARALLEL_ENABLED
+    EXPECT_TRUE(!(key == make_engine(ScaledUniformModel{2.0}, execution::Parallel{2}, 3).cache_key(20'000, empty)),
+                "thread count changes the key");
+
+    // Concurrent writers, each with its own handle as separate processes would
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&dir, t] {
+            io::ResultCache mine(dir.string());
+            auto e = make_engine(ScaledUniformModel{1.0 + t}, execution::Sequential{}, 3);
+            for (std::uint64_t n = 1; n <= 25; ++n) e.run(n * 10, mine);
+        });
+    }
+    for (auto& w : writers) w.join();
+    EXPECT_EQ(fresh.size(), 101u, "concurrent inserts are all indexed");
+    std::uint64_t found = 0;
+    for (int t = 0; t < 4; ++t) {
+        auto e = make_engine(ScaledUniformModel{1.0 + t}, execution::Sequential{}, 3);
+        for (std::uint64_t n = 1; n <= 25; ++n) found += fresh.find(e.cache_key(n * 10, empty)) ? 1 : 0;
+    }
+    EXPECT_EQ(found, 100u, "concurrent entries are readable");
+#else
+    std::cout << "[skip] concurrent result cache (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+    std::filesystem::remove_all(dir);
+}
+
+// OTM call payoffs: mostly exact zeros with a few positive values
+std::vector<double> otm_payoffs(std::uint64_t seed, std::size_t n) {
+    std::mt19937_64 rng(seed);
+    const GbmCall call{100.0, 120.0, 0.03, 0.2, 1.0};
+    std::vector<double> out(n);
+    for (double& v : out) v = call(rng);
+    return out;
+}
+
+// Lossless blocks decode bit for bit, lossy ones within their bound, and
+// the sink writes and reads compressed files like plain ones
+void test_sample_compression() {
+    std::vector<double> values = otm_payoffs(31, 50'000);
+    values[1] = -0.0;
+    values[2] = std::numeric_limits<double>::infinity();
+    values[3] = std::numeric_limits<double>::quiet_NaN();
+    values[4] = std::numeric_limits<double>::max();
+    values[5] = std::numeric_limits<double>::denorm_min();
+    values[6] = values[7] = 42.0;
+
+    std::vector<std::byte> bytes;
+    io::xor_encode(values, bytes);
+    EXPECT_EQ(bytes.size() % 8, 0u, "whole words");
+    EXPECT_TRUE(bytes.size() * 2 < values.size() * sizeof(double), "OTM payoffs compress more than 2x");
+    std::vector<double> decoded(values.size());
+    io::xor_decode(bytes, decoded);
+    bool exact = true;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        exact = exact && std::bit_cast<std::uint64_t>(decoded[i]) == std::bit_cast<std::uint64_t>(values[i]);
+    }
+    EXPECT_TRUE(exact, "lossless round trip");
+
+    std::vector<std::byte> lossy;
+    io::xor_encode(values, lossy, 20);
+    EXPECT_TRUE(lossy.size() < bytes.size(), "rounding helps");
+    io::xor_decode(lossy, decoded);
+    bool bounded = true;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        if (std::isnan(values[i])) {
+            bounded = bounded && std::isnan(decoded[i]);
+        } else if (std::isnormal(values[i])) {
+            bounded = bounded && std::abs(decoded[i] - values[i]) <= std::ldexp(std::abs(values[i]), -21);
+        } else if (i != 5) {
+            bounded = bounded && decoded[i] == values[i];
+        }
+    }
+    EXPECT_TRUE(bounded, "lossy error within 2^-(bits+1)");
+
+    bool threw = false;
+    try {
+        io::xor_decode(std::span<const std::byte>(bytes).first(bytes.size() / 2), decoded);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw, "truncated block rejected");
+
+    const std::string path = (std::filesystem::temp_directory_path() / "mclib-test-compressed.bin").string();
+    const io::SampleCompression xor_codec{io::SampleCodec::Xor};
+    {
+        SampleSinkAggregator sink(path, true, 4'096, 0, xor_codec);
+        sink.add_batch(values);
+        sink.close();
+        auto file = io::SampleFile::open(path);
+        EXPECT_TRUE(file.compressed(), "codec recorded");
+        EXPECT_EQ(file.count(), values.size(), "compressed sample count");
+        EXPECT_TRUE(std::filesystem::file_size(path) * 2 < values.size() * sizeof(double),
+                    "file under half the raw sample column");
+        threw = false;
+        try {
+            file.block(0);
+        } catch (const std::logic_error&) {
+            threw = true;
+        }
+        EXPECT_TRUE(threw, "in-place access needs an uncompressed file");
+        std::vector<double> read;
+        bool trials_ok = true;
+        file.for_each_block([&](const io::SampleBlock& block) {
+            for (std::size_t i = 0; i < block.values.size(); ++i) {
+                trials_ok = trials_ok && block.trials.size() == block.values.size() &&
+                            block.trials[i] == block.first_trial + i;
+            }
+            read.insert(read.end(), block.values.begin(), block.values.end());
+        });
+        EXPECT_TRUE(read.size() == values.size() &&
+                    std::memcmp(read.data(), values.data(), values.size() * sizeof(double)) == 0,
+                    "sink file decodes to the samples");
+        EXPECT_TRUE(trials_ok, "trial indices rebuilt");
+    }
+
+#ifdef MCLIB_PARALLEL_ENABLED
+    {
+        auto engine = make_engine<Uniform01Model, execution::Parallel, SampleSinkAggregator>(
+            Uniform01Model{}, execution::Parallel{3}, 21);
+        auto r = engine.run_aggregate(40'001, SampleSinkAggregator(path, false, 1'000, 2, {io::SampleCodec::Xor, 30}));
+        r.aggregator.close();
+        auto file = io::SampleFile::open(path);
+        WelfordAggregator<> moments;
+        file.for_each_block([&](const io::SampleBlock& block) { moments.add_batch(block.values); });
+        EXPECT_EQ(moments.count(), 40'001u, "async compressed count");
+        EXPECT_NEAR(moments.result(), r.aggregator.result(), 1e-9, "lossy file mean");
+    }
+#else
+    std::cout << "[skip] compressed sample sink parallel (MCLIB_PARALLEL_ENABLED=OFF)\n";
+#endif
+
+    // Compression survives a snapshot and restore
+    std::vector<std::byte> snapshot;
+    {
+        SampleSinkAggregator sink(path, false, 4'096, 0, xor_codec);
+        sink.add_batch(std::span<const double>(values).first(10'000));
+        snapshot = to_bytes(sink);
+    }
+    auto restored = from_bytes<SampleSinkAggregator>(snapshot);
+    restored.add_batch(std::span<const double>(values).subspan(10'000));
+    restored.close();
+    auto file = io::SampleFile::open(path);
+    EXPECT_TRUE(file.compressed() && file.count() == values.size(), "restored sink keeps compressing");
+    std::filesystem::remove(path);
+}
+
 // Same seed should produce identical sequences
 void test_rng_reproducibility() {
     constexpr std::uint64_t seed = 42;
@@ -249,6 +2123,45 @@ int main() {
     std::vector<TestCase> tests = {
         {"welford_basic_stats", test_welford_basic_stats},
         {"welford_reset", test_welford_reset},
+        {"welford_batch_matches_scalar", test_welford_batch_matches_scalar},
+        {"welford_batch_large_offset", test_welford_batch_large_offset},
+        {"tdigest_quantiles", test_tdigest_quantiles},
+        {"tdigest_parallel_merge", test_tdigest_parallel_merge},
+        {"log_histogram_quantiles", test_log_histogram_quantiles},
+        {"log_histogram_merge", test_log_histogram_merge},
+        {"histogram_merge", test_histogram_merge},
+        {"histogram_parallel_variants", test_histogram_parallel_variants},
+        {"moments_against_two_pass", test_moments_against_two_pass},
+        {"moments_parallel_indices", test_moments_parallel_indices},
+        {"covariance_against_two_pass", test_covariance_against_two_pass},
+        {"covariance_parallel_engine", test_covariance_parallel_engine},
+        {"tail_matches_sort", test_tail_matches_sort},
+        {"tail_parallel_merge", test_tail_parallel_merge},
+        {"tuple_aggregator", test_tuple_aggregator},
+        {"tuple_aggregator_parallel", test_tuple_aggregator_parallel},
+        {"batch_means_ar1", test_batch_means_ar1},
+        {"batch_means_merge_chains", test_batch_means_merge_chains},
+        {"reproducible_order_independence", test_reproducible_order_independence},
+        {"reproducible_exactness", test_reproducible_exactness},
+        {"reservoir_uniformity", test_reservoir_uniformity},
+        {"reservoir_engine_reproducible", test_reservoir_engine_reproducible},
+        {"grouped_aggregator", test_grouped_aggregator},
+        {"grouped_merge", test_grouped_merge},
+        {"convergence_trace", test_convergence_trace},
+        {"convergence_trace_merge", test_convergence_trace_merge},
+        {"serialize_round_trip", test_serialize_round_trip},
+        {"serialize_merge_and_errors", test_serialize_merge_and_errors},
+        {"exact_quantiles", test_exact_quantiles},
+        {"exact_quantiles_spill", test_exact_quantiles_spill},
+        {"density_aggregator", test_density_aggregator},
+        {"sparse_histogram", test_sparse_histogram},
+        {"sample_sink", test_sample_sink},
+        {"batch_driver", test_batch_driver},
+        {"checkpoint_resume", test_checkpoint_resume},
+        {"result_export", test_result_export},
+        {"bootstrap", test_bootstrap},
+        {"result_cache", test_result_cache},
+        {"sample_compression", test_sample_compression},
         {"rng_reproducibility", test_rng_reproducibility},
         {"rng_stream_independence", test_rng_stream_independence},
         {"rng_uniform_sanity", test_rng_uniform_sanity},